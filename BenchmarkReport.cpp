@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarkreport.cpp
+// ============
+// collect the frame statistics of a benchmark run and compare runs
+//
+//	Every metric in the results grows when the rendering gets worse, so
+//	a comparison only has to look for values above the baseline.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BenchmarkReport.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// declaration of global variables and defines
+namespace
+{
+	// the metrics that are compared against a baseline
+	const char* const g_ComparedMetrics[] =
+	{
+		"frame_ms_p50",
+		"frame_ms_p95",
+		"frame_ms_p99",
+		"draws_per_frame",
+		"uniform_uploads_per_frame",
+		"peak_rss_kb"
+	};
+	const int g_ComparedMetricCount = 6;
+
+	/***********************************************************
+	 *  EscapeJSON()
+	 *
+	 *  This helper function is used for escaping the quotes and
+	 *  backslashes of a string written into JSON.
+	 ***********************************************************/
+	std::string EscapeJSON(const std::string& text)
+	{
+		std::string escaped;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if ((text[i] == '"') || (text[i] == '\\'))
+			{
+				escaped += '\\';
+			}
+			escaped += text[i];
+		}
+
+		return(escaped);
+	}
+
+	/***********************************************************
+	 *  ReadNumber()
+	 *
+	 *  This helper function is used for reading the number of a
+	 *  key in the flat JSON text of a results file.
+	 ***********************************************************/
+	bool ReadNumber(const std::string& json, const char* key, double& value)
+	{
+		std::string quotedKey = std::string("\"") + key + "\"";
+		size_t position = json.find(quotedKey);
+		if (position == std::string::npos)
+		{
+			return(false);
+		}
+
+		position = json.find(':', position + quotedKey.size());
+		if (position == std::string::npos)
+		{
+			return(false);
+		}
+
+		const char* pStart = json.c_str() + position + 1;
+		char* pEnd = NULL;
+		value = strtod(pStart, &pEnd);
+
+		return(pEnd != pStart);
+	}
+
+	/***********************************************************
+	 *  ReadFile()
+	 *
+	 *  This helper function is used for reading a whole results
+	 *  file into a string.
+	 ***********************************************************/
+	bool ReadFile(const char* filename, std::string& text)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cout << "Could not open the benchmark results:" << filename << std::endl;
+			return(false);
+		}
+
+		std::stringstream contents;
+		contents << file.rdbuf();
+		text = contents.str();
+
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  BenchmarkReport()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BenchmarkReport::BenchmarkReport()
+{
+	m_totalDrawCalls = 0.0;
+	m_totalUniformUploads = 0.0;
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used for adding the time and the OpenGL
+ *  call counts of one frame.
+ ***********************************************************/
+void BenchmarkReport::AddFrame(double frameMilliseconds, unsigned int drawCalls, unsigned int uniformUploads)
+{
+	m_frameTimes.push_back(frameMilliseconds);
+	m_totalDrawCalls += drawCalls;
+	m_totalUniformUploads += uniformUploads;
+}
+
+/***********************************************************
+ *  GetFramePercentile()
+ *
+ *  This method is used for getting the frame time that the
+ *  passed in percentage of the frames took at most, using
+ *  the nearest frame.
+ ***********************************************************/
+double BenchmarkReport::GetFramePercentile(double percentile) const
+{
+	if (m_frameTimes.empty())
+	{
+		return(0.0);
+	}
+
+	std::vector<double> sorted(m_frameTimes);
+	std::sort(sorted.begin(), sorted.end());
+
+	size_t index = (size_t)(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+
+	return(sorted[std::min(index, sorted.size() - 1)]);
+}
+
+/***********************************************************
+ *  WriteJSON()
+ *
+ *  This method is used for writing the results of the run
+ *  into a flat JSON object.
+ ***********************************************************/
+bool BenchmarkReport::WriteJSON(
+	const char* filename,
+	const std::string& pathName,
+	double timestep,
+	const std::string& renderer) const
+{
+	std::ofstream jsonFile(filename);
+	if (!jsonFile.is_open())
+	{
+		std::cout << "Could not write the benchmark results:" << filename << std::endl;
+		return(false);
+	}
+
+	double frameCount = m_frameTimes.empty() ? 1.0 : (double)m_frameTimes.size();
+	double totalTime = 0.0;
+	for (size_t i = 0; i < m_frameTimes.size(); i++)
+	{
+		totalTime += m_frameTimes[i];
+	}
+
+	jsonFile << std::fixed << std::setprecision(4);
+	jsonFile << "{" << std::endl;
+	jsonFile << "  \"path\": \"" << EscapeJSON(pathName) << "\"," << std::endl;
+	jsonFile << "  \"renderer\": \"" << EscapeJSON(renderer) << "\"," << std::endl;
+	jsonFile << "  \"frames\": " << m_frameTimes.size() << "," << std::endl;
+	jsonFile << "  \"timestep\": " << timestep << "," << std::endl;
+	jsonFile << "  \"frame_ms_avg\": " << (totalTime / frameCount) << "," << std::endl;
+	jsonFile << "  \"frame_ms_p50\": " << GetFramePercentile(50.0) << "," << std::endl;
+	jsonFile << "  \"frame_ms_p95\": " << GetFramePercentile(95.0) << "," << std::endl;
+	jsonFile << "  \"frame_ms_p99\": " << GetFramePercentile(99.0) << "," << std::endl;
+	jsonFile << "  \"draws_per_frame\": " << (m_totalDrawCalls / frameCount) << "," << std::endl;
+	jsonFile << "  \"uniform_uploads_per_frame\": " << (m_totalUniformUploads / frameCount) << "," << std::endl;
+	jsonFile << "  \"peak_rss_kb\": " << GetPeakMemoryKB() << std::endl;
+	jsonFile << "}" << std::endl;
+
+	return(jsonFile.good());
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the results of the run.
+ ***********************************************************/
+void BenchmarkReport::Print() const
+{
+	double frameCount = m_frameTimes.empty() ? 1.0 : (double)m_frameTimes.size();
+
+	std::cout << "Benchmark of " << m_frameTimes.size() << " frames - frame time p50:"
+		<< GetFramePercentile(50.0) << "ms p95:" << GetFramePercentile(95.0)
+		<< "ms p99:" << GetFramePercentile(99.0) << "ms" << std::endl;
+	std::cout << "Draws per frame:" << (m_totalDrawCalls / frameCount)
+		<< " uniform uploads per frame:" << (m_totalUniformUploads / frameCount)
+		<< " peak memory:" << GetPeakMemoryKB() << "KB" << std::endl;
+}
+
+/***********************************************************
+ *  GetPeakMemoryKB()
+ *
+ *  This method is used for getting the most resident memory
+ *  that the process has used so far.
+ ***********************************************************/
+size_t BenchmarkReport::GetPeakMemoryKB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE)
+	{
+		return(0);
+	}
+	return(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return(0);
+	}
+#ifdef __APPLE__
+	// macOS gives the size in bytes instead of kilobytes
+	return((size_t)usage.ru_maxrss / 1024);
+#else
+	return((size_t)usage.ru_maxrss);
+#endif
+#endif
+}
+
+/***********************************************************
+ *  CompareFiles()
+ *
+ *  This method is used for checking the results of a run
+ *  against a baseline. A metric regresses when it is larger
+ *  than the baseline by more than the tolerance, which is a
+ *  fraction of the baseline value.
+ ***********************************************************/
+int BenchmarkReport::CompareFiles(const char* baselineFile, const char* resultFile, double tolerance)
+{
+	std::string baseline;
+	std::string result;
+	int regressions = 0;
+
+	if ((ReadFile(baselineFile, baseline) == false) || (ReadFile(resultFile, result) == false))
+	{
+		return(-1);
+	}
+
+	double baselineFrames = 0.0;
+	double resultFrames = 0.0;
+	if (ReadNumber(baseline, "frames", baselineFrames) && ReadNumber(result, "frames", resultFrames) &&
+		(baselineFrames != resultFrames))
+	{
+		std::cout << "The runs have different frame counts, " << baselineFrames
+			<< " and " << resultFrames << ", so they may not compare well" << std::endl;
+	}
+
+	for (int i = 0; i < g_ComparedMetricCount; i++)
+	{
+		double baselineValue = 0.0;
+		double resultValue = 0.0;
+
+		if ((ReadNumber(baseline, g_ComparedMetrics[i], baselineValue) == false) ||
+			(ReadNumber(result, g_ComparedMetrics[i], resultValue) == false))
+		{
+			std::cout << "  " << g_ComparedMetrics[i] << " - missing" << std::endl;
+			continue;
+		}
+
+		double change = (baselineValue != 0.0) ? (resultValue - baselineValue) / baselineValue : 0.0;
+		bool bRegressed = (resultValue > baselineValue * (1.0 + tolerance));
+		if (bRegressed)
+		{
+			regressions++;
+		}
+
+		std::cout << "  " << g_ComparedMetrics[i] << " - baseline:" << baselineValue
+			<< " result:" << resultValue << " change:" << (change * 100.0) << "%"
+			<< (bRegressed ? " REGRESSION" : "") << std::endl;
+	}
+
+	std::cout << regressions << " regressions beyond " << (tolerance * 100.0) << "%" << std::endl;
+
+	return(regressions);
+}
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarkreport.h
+// ============
+// collect the frame statistics of a benchmark run and compare runs
+//
+//	The results are written as a flat JSON object of numbers, so that
+//	scripts can read them and a later run can be checked against a stored
+//	baseline without a JSON library.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  BenchmarkReport
+ *
+ *  This class keeps the time and the OpenGL call counts of
+ *  every benchmark frame, and writes their percentiles and
+ *  averages with the peak memory use of the process.
+ ***********************************************************/
+class BenchmarkReport
+{
+public:
+	// constructor
+	BenchmarkReport();
+
+	// add the measurements of one frame
+	void AddFrame(double frameMilliseconds, unsigned int drawCalls, unsigned int uniformUploads);
+
+	// write the results into a JSON file, along with the run
+	// settings that a baseline must match
+	bool WriteJSON(
+		const char* filename,
+		const std::string& pathName,
+		double timestep,
+		const std::string& renderer) const;
+	// print the results
+	void Print() const;
+
+	// get the peak resident memory of the process in kilobytes,
+	// or 0 where it cannot be read
+	static size_t GetPeakMemoryKB();
+
+	// compare the results in a file with a baseline file, print
+	// every metric and return the number that grew by more than
+	// the tolerance - returns -1 when a file cannot be read
+	static int CompareFiles(const char* baselineFile, const char* resultFile, double tolerance);
+
+private:
+	std::vector<double> m_frameTimes;
+	double m_totalDrawCalls;
+	double m_totalUniformUploads;
+
+	// get a percentile of the frame times in milliseconds
+	double GetFramePercentile(double percentile) const;
+};
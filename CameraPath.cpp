@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// record and replay timed camera moves through the 3D scene
+//
+//	The poses are blended linearly, with the front direction normalized
+//	after blending, which is close enough for poses recorded every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// declaration of global variables and defines
+namespace
+{
+	// number of poses on the built in orbit
+	const int g_OrbitKeyframes = 72;
+
+	/***********************************************************
+	 *  IsEarlier()
+	 *
+	 *  This helper function is used for comparing a time with
+	 *  the time of a pose, to search the poses in time order.
+	 ***********************************************************/
+	bool IsEarlier(float time, const CameraPath::KEYFRAME& keyframe)
+	{
+		return(time < keyframe.time);
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the poses of a path from
+ *  a text file.
+ ***********************************************************/
+bool CameraPath::Load(const char* filename)
+{
+	std::ifstream pathFile(filename);
+	std::string line;
+	int lineNumber = 0;
+
+	if (!pathFile.is_open())
+	{
+		std::cout << "Could not open the camera path file:" << filename << std::endl;
+		return(false);
+	}
+
+	m_keyframes.clear();
+	while (std::getline(pathFile, line))
+	{
+		lineNumber++;
+
+		size_t first = line.find_first_not_of(" \t\r");
+		if ((first == std::string::npos) || (line[first] == '#'))
+		{
+			continue;
+		}
+
+		KEYFRAME keyframe;
+		std::istringstream values(line);
+		if (!(values >> keyframe.time
+			>> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+			>> keyframe.front.x >> keyframe.front.y >> keyframe.front.z))
+		{
+			std::cout << "Camera path pose " << lineNumber << " needs seven numbers:" << filename << std::endl;
+			return(false);
+		}
+		AddKeyframe(keyframe.time, keyframe.position, keyframe.front);
+	}
+
+	if (m_keyframes.empty())
+	{
+		std::cout << "The camera path has no poses:" << filename << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used for writing the poses of the path into
+ *  a text file.
+ ***********************************************************/
+bool CameraPath::Save(const char* filename) const
+{
+	std::ofstream pathFile(filename);
+
+	if (!pathFile.is_open())
+	{
+		std::cout << "Could not write the camera path file:" << filename << std::endl;
+		return(false);
+	}
+
+	pathFile << "# time position.x position.y position.z front.x front.y front.z" << std::endl;
+	for (size_t i = 0; i < m_keyframes.size(); i++)
+	{
+		const KEYFRAME& keyframe = m_keyframes[i];
+		pathFile << keyframe.time << " "
+			<< keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " "
+			<< keyframe.front.x << " " << keyframe.front.y << " " << keyframe.front.z << std::endl;
+	}
+
+	return(pathFile.good());
+}
+
+/***********************************************************
+ *  AddKeyframe()
+ *
+ *  This method is used for adding a pose at the end of the
+ *  path.
+ ***********************************************************/
+void CameraPath::AddKeyframe(float time, const glm::vec3& position, const glm::vec3& front)
+{
+	if (!m_keyframes.empty() && (time <= m_keyframes.back().time))
+	{
+		return;
+	}
+
+	KEYFRAME keyframe;
+	keyframe.time = time;
+	keyframe.position = position;
+	keyframe.front = front;
+	m_keyframes.push_back(keyframe);
+}
+
+/***********************************************************
+ *  MakeOrbit()
+ *
+ *  This method is used for replacing the path with a circle
+ *  around a point, so that a benchmark can run without any
+ *  recorded path.
+ ***********************************************************/
+void CameraPath::MakeOrbit(const glm::vec3& center, float radius, float height, float seconds)
+{
+	m_keyframes.clear();
+
+	// the last pose is back at the first, so the path repeats
+	// without a jump
+	for (int i = 0; i <= g_OrbitKeyframes; i++)
+	{
+		float angle = glm::two_pi<float>() * i / g_OrbitKeyframes;
+		glm::vec3 position = center + glm::vec3(radius * sinf(angle), height, radius * cosf(angle));
+		AddKeyframe(seconds * i / g_OrbitKeyframes, position, center - position);
+	}
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  This method is used for getting the camera pose at a time
+ *  of the path, blended from the poses on either side.
+ ***********************************************************/
+void CameraPath::Sample(float time, glm::vec3& position, glm::vec3& front) const
+{
+	if (m_keyframes.empty())
+	{
+		return;
+	}
+
+	float duration = GetDuration();
+	if (duration > 0.0f)
+	{
+		time = fmodf(time, duration);
+	}
+
+	std::vector<KEYFRAME>::const_iterator next =
+		std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, IsEarlier);
+	if (next == m_keyframes.begin())
+	{
+		position = next->position;
+		front = next->front;
+		return;
+	}
+	if (next == m_keyframes.end())
+	{
+		position = m_keyframes.back().position;
+		front = m_keyframes.back().front;
+		return;
+	}
+
+	const KEYFRAME& previous = *(next - 1);
+	float blend = (time - previous.time) / (next->time - previous.time);
+	position = glm::mix(previous.position, next->position, blend);
+	front = glm::normalize(glm::mix(previous.front, next->front, blend));
+}
+
+/***********************************************************
+ *  GetDuration()
+ *
+ *  This method is used for getting the time of the last pose
+ *  of the path.
+ ***********************************************************/
+float CameraPath::GetDuration() const
+{
+	if (m_keyframes.empty())
+	{
+		return(0.0f);
+	}
+
+	return(m_keyframes.back().time);
+}
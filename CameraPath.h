@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// record and replay timed camera moves through the 3D scene
+//
+//	A path is a list of timed camera poses, either recorded from the
+//	display window or written by hand. Sampling it at fixed time steps
+//	gives the same camera in every run, whatever the frame rate was when
+//	the path was recorded.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class holds camera poses at increasing times, and
+ *  gives the pose between them at any time of the path. The
+ *  path repeats after its last pose.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// one camera pose, and the time in seconds that the camera
+	// passes it
+	struct KEYFRAME
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 front;
+	};
+
+	// constructor
+	CameraPath();
+
+	// read a path from a text file with one pose of seven numbers
+	// on every line - the time, the position and then the front
+	// direction - where lines starting with # are skipped
+	bool Load(const char* filename);
+	// write the path in the format that Load() reads
+	bool Save(const char* filename) const;
+
+	// add a pose after the last one - poses that are not later
+	// than the last one are skipped
+	void AddKeyframe(float time, const glm::vec3& position, const glm::vec3& front);
+	// replace the path with one circle around a point, looking at
+	// it from a height above it
+	void MakeOrbit(const glm::vec3& center, float radius, float height, float seconds);
+
+	// get the camera pose at a time of the path
+	void Sample(float time, glm::vec3& position, glm::vec3& front) const;
+
+	// get the time of the last pose, and the number of poses
+	float GetDuration() const;
+	int GetKeyframeCount() const { return (int)m_keyframes.size(); }
+
+private:
+	std::vector<KEYFRAME> m_keyframes;
+};
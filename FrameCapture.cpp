@@ -0,0 +1,545 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// read rendered frames back without stalling and write them to image files
+//
+//	glReadPixels into a bound pixel buffer object only queues the copy, so
+//	the rendering thread never waits for the GPU unless the whole ring is
+//	still being read back. The PNG files use stored deflate blocks, which
+//	keeps the writer thread as fast as writing the raw pixels.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables and defines
+namespace
+{
+	// most frames waiting for the writer thread before a capture
+	// waits for it to catch up
+	const size_t g_MaxQueuedFrames = 8;
+	// time waited for a fence at a time, in nanoseconds
+	const GLuint64 g_FenceWaitNs = 1000000;
+
+	// size of the uncompressed TGA image header
+	const int g_TGAHeaderSize = 18;
+	// largest block of stored deflate data
+	const size_t g_MaxStoredBlock = 65535;
+	// modulus and largest run of bytes between the reductions of
+	// the Adler-32 checksum
+	const unsigned int g_AdlerModulus = 65521;
+	const size_t g_AdlerRun = 5552;
+
+	// lookup table of the CRC-32 used by the PNG chunks
+	struct CRC_TABLE
+	{
+		unsigned int values[256];
+
+		CRC_TABLE()
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				values[n] = c;
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  UpdateCrc()
+	 *
+	 *  This helper function is used for adding bytes to a PNG
+	 *  chunk CRC-32 that was started with 0xFFFFFFFF.
+	 ***********************************************************/
+	unsigned int UpdateCrc(unsigned int crc, const unsigned char* pData, size_t length)
+	{
+		static const CRC_TABLE table;
+
+		for (size_t i = 0; i < length; i++)
+		{
+			crc = table.values[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+		}
+
+		return(crc);
+	}
+
+	/***********************************************************
+	 *  AppendBigEndian()
+	 *
+	 *  This helper function is used for appending a 32-bit value
+	 *  with the most significant byte first.
+	 ***********************************************************/
+	void AppendBigEndian(std::vector<unsigned char>& data, unsigned int value)
+	{
+		data.push_back((unsigned char)(value >> 24));
+		data.push_back((unsigned char)(value >> 16));
+		data.push_back((unsigned char)(value >> 8));
+		data.push_back((unsigned char)value);
+	}
+
+	/***********************************************************
+	 *  AppendChunk()
+	 *
+	 *  This helper function is used for appending a PNG chunk
+	 *  with its length, type and CRC.
+	 ***********************************************************/
+	void AppendChunk(
+		std::vector<unsigned char>& file,
+		const char* type,
+		const std::vector<unsigned char>& data)
+	{
+		AppendBigEndian(file, (unsigned int)data.size());
+		size_t typeStart = file.size();
+		file.insert(file.end(), type, type + 4);
+		file.insert(file.end(), data.begin(), data.end());
+
+		unsigned int crc = UpdateCrc(0xFFFFFFFFu, &file[typeStart], file.size() - typeStart);
+		AppendBigEndian(file, crc ^ 0xFFFFFFFFu);
+	}
+
+	/***********************************************************
+	 *  EncodePNG()
+	 *
+	 *  This helper function is used for encoding RGBA pixels
+	 *  with the bottom row first into a PNG file image.
+	 ***********************************************************/
+	void EncodePNG(
+		const std::vector<unsigned char>& pixels,
+		int width,
+		int height,
+		std::vector<unsigned char>& file)
+	{
+		const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		size_t rowSize = (size_t)width * 4;
+		std::vector<unsigned char> rows;
+		std::vector<unsigned char> header;
+		std::vector<unsigned char> stream;
+
+		// every PNG row starts with its filter type, which is none,
+		// and the first row is the top of the image
+		rows.reserve((rowSize + 1) * height);
+		for (int y = height - 1; y >= 0; y--)
+		{
+			rows.push_back(0);
+			rows.insert(rows.end(), pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize);
+		}
+
+		// the zlib stream holds the rows in stored deflate blocks
+		stream.reserve(rows.size() + (rows.size() / g_MaxStoredBlock + 1) * 5 + 6);
+		stream.push_back(0x78);
+		stream.push_back(0x01);
+		for (size_t offset = 0; (offset < rows.size()) || (offset == 0); offset += g_MaxStoredBlock)
+		{
+			size_t blockSize = rows.size() - offset;
+			if (blockSize > g_MaxStoredBlock)
+			{
+				blockSize = g_MaxStoredBlock;
+			}
+
+			stream.push_back((offset + blockSize >= rows.size()) ? 1 : 0);
+			stream.push_back((unsigned char)(blockSize & 0xFF));
+			stream.push_back((unsigned char)(blockSize >> 8));
+			stream.push_back((unsigned char)(~blockSize & 0xFF));
+			stream.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+			stream.insert(stream.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+		}
+
+		unsigned int adlerA = 1;
+		unsigned int adlerB = 0;
+		for (size_t offset = 0; offset < rows.size(); offset += g_AdlerRun)
+		{
+			size_t runEnd = (offset + g_AdlerRun < rows.size()) ? offset + g_AdlerRun : rows.size();
+			for (size_t i = offset; i < runEnd; i++)
+			{
+				adlerA += rows[i];
+				adlerB += adlerA;
+			}
+			adlerA %= g_AdlerModulus;
+			adlerB %= g_AdlerModulus;
+		}
+		AppendBigEndian(stream, (adlerB << 16) | adlerA);
+
+		// 8 bits per channel, RGBA, no interlacing
+		AppendBigEndian(header, (unsigned int)width);
+		AppendBigEndian(header, (unsigned int)height);
+		header.push_back(8);
+		header.push_back(6);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+
+		file.clear();
+		file.insert(file.end(), signature, signature + 8);
+		AppendChunk(file, "IHDR", header);
+		AppendChunk(file, "IDAT", stream);
+		AppendChunk(file, "IEND", std::vector<unsigned char>());
+	}
+}
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture(
+	int width,
+	int height,
+	const std::string& outputFolder,
+	IMAGE_FORMAT format,
+	int ringSize)
+{
+	m_width = width;
+	m_height = height;
+	m_outputFolder = outputFolder;
+	m_format = format;
+	m_readFormat = (format == IMAGE_PNG) ? GL_RGBA : GL_BGRA;
+	m_nextSlot = 0;
+	m_capturedFrames = 0;
+	m_stallCount = 0;
+	m_bStopping = false;
+
+	if (ringSize < 2)
+	{
+		ringSize = 2;
+	}
+
+	GLsizeiptr frameSize = (GLsizeiptr)width * height * 4;
+	m_slots.resize(ringSize);
+	for (int i = 0; i < ringSize; i++)
+	{
+		glGenBuffers(1, &m_slots[i].pixelBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[i].pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+		m_slots[i].fence = 0;
+		m_slots[i].frameNumber = -1;
+		m_slots[i].width = width;
+		m_slots[i].height = height;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_writer = std::thread(&FrameCapture::WriteFrames, this);
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	Finish();
+
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		glDeleteBuffers(1, &m_slots[i].pixelBuffer);
+	}
+	m_slots.clear();
+
+	for (size_t i = 0; i < m_freePixels.size(); i++)
+	{
+		delete m_freePixels[i];
+	}
+	m_freePixels.clear();
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This method is used for starting the readback of the
+ *  frame in the read framebuffer into the next pixel buffer
+ *  object. The frame that used the same buffer before is
+ *  collected first, which only waits when the GPU has not
+ *  finished copying it yet.
+ ***********************************************************/
+void FrameCapture::CaptureFrame()
+{
+	READBACK_SLOT& slot = m_slots[m_nextSlot];
+
+	if (CollectSlot(slot, false) == false)
+	{
+		m_stallCount++;
+		CollectSlot(slot, true);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, m_width, m_height, m_readFormat, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frameNumber = m_capturedFrames++;
+	slot.width = m_width;
+	slot.height = m_height;
+
+	m_nextSlot = (m_nextSlot + 1) % (int)m_slots.size();
+
+	// hand on the oldest frames that are already read back, which
+	// are usually two frames behind with a ring of three
+	for (size_t i = 0; i + 1 < m_slots.size(); i++)
+	{
+		READBACK_SLOT& olderSlot = m_slots[(m_nextSlot + i) % m_slots.size()];
+		if (CollectSlot(olderSlot, false) == false)
+		{
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for changing the size of the frames
+ *  that are read back. The frames still being read back
+ *  keep their size, so they are collected before the pixel
+ *  buffer objects are allocated again.
+ ***********************************************************/
+void FrameCapture::Resize(int width, int height)
+{
+	if ((width <= 0) || (height <= 0) || ((width == m_width) && (height == m_height)))
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		CollectSlot(m_slots[(m_nextSlot + i) % m_slots.size()], true);
+	}
+
+	m_width = width;
+	m_height = height;
+
+	GLsizeiptr frameSize = (GLsizeiptr)width * height * 4;
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[i].pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+		m_slots[i].width = width;
+		m_slots[i].height = height;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for collecting every frame that is
+ *  still being read back, and for waiting until the writer
+ *  thread has written all of them. No frames can be captured
+ *  afterwards.
+ ***********************************************************/
+void FrameCapture::Finish()
+{
+	if (!m_writer.joinable())
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		CollectSlot(m_slots[(m_nextSlot + i) % m_slots.size()], true);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_jobReady.notify_all();
+	m_writer.join();
+}
+
+/***********************************************************
+ *  FormatFromName()
+ *
+ *  This method is used for getting the image format that
+ *  has the passed in file extension name.
+ ***********************************************************/
+FrameCapture::IMAGE_FORMAT FrameCapture::FormatFromName(const std::string& name)
+{
+	if ((name == "png") || (name == "PNG"))
+	{
+		return(IMAGE_PNG);
+	}
+
+	return(IMAGE_TGA);
+}
+
+/***********************************************************
+ *  CollectSlot()
+ *
+ *  This method is used for mapping the pixel buffer object
+ *  of a finished readback and copying its pixels out for the
+ *  writer thread. Returns false when the readback has not
+ *  finished and the fence is not waited for.
+ ***********************************************************/
+bool FrameCapture::CollectSlot(READBACK_SLOT& slot, bool bWait)
+{
+	if (0 == slot.fence)
+	{
+		return(true);
+	}
+
+	GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while ((result == GL_TIMEOUT_EXPIRED) && bWait)
+	{
+		result = glClientWaitSync(slot.fence, 0, g_FenceWaitNs);
+	}
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		return(false);
+	}
+	if (result == GL_WAIT_FAILED)
+	{
+		std::cout << "Waiting for the readback of frame " << slot.frameNumber << " failed" << std::endl;
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+
+	size_t frameSize = (size_t)slot.width * slot.height * 4;
+	std::vector<unsigned char>* pPixels = NULL;
+
+	{
+		// a writer thread that falls behind holds up the capture,
+		// so that the queued frames never use up the memory
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_jobs.size() >= g_MaxQueuedFrames)
+		{
+			m_jobDone.wait(lock);
+		}
+		if (!m_freePixels.empty())
+		{
+			pPixels = m_freePixels.back();
+			m_freePixels.pop_back();
+		}
+	}
+	if (NULL == pPixels)
+	{
+		pPixels = new std::vector<unsigned char>(frameSize);
+	}
+	// the kept arrays can be from frames of another size
+	pPixels->resize(frameSize);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+	const void* pMapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frameSize, GL_MAP_READ_BIT);
+	if (NULL != pMapped)
+	{
+		memcpy(pPixels->data(), pMapped, frameSize);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	WRITE_JOB job;
+	job.frameNumber = slot.frameNumber;
+	job.width = slot.width;
+	job.height = slot.height;
+	job.pPixels = pPixels;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_jobReady.notify_one();
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteFrames()
+ *
+ *  This method is used for writing the queued frames on the
+ *  writer thread until it is stopped. The frames queued
+ *  before stopping are all written.
+ ***********************************************************/
+void FrameCapture::WriteFrames()
+{
+	while (true)
+	{
+		WRITE_JOB job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ((m_jobs.empty()) && (m_bStopping == false))
+			{
+				m_jobReady.wait(lock);
+			}
+			if (m_jobs.empty())
+			{
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		WriteImage(job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freePixels.push_back(job.pPixels);
+		}
+		m_jobDone.notify_one();
+	}
+}
+
+/***********************************************************
+ *  WriteImage()
+ *
+ *  This method is used for writing the pixels of one frame
+ *  into a numbered image file in the output folder. The
+ *  alpha of the frame is made opaque, since the blended
+ *  drawing leaves it below one.
+ ***********************************************************/
+bool FrameCapture::WriteImage(const WRITE_JOB& job) const
+{
+	std::vector<unsigned char>& pixels = *job.pPixels;
+	char frameName[32];
+	snprintf(frameName, sizeof(frameName), "/frame_%05d.%s", job.frameNumber, (m_format == IMAGE_PNG) ? "png" : "tga");
+	std::string filename = m_outputFolder + frameName;
+
+	for (size_t i = 3; i < pixels.size(); i += 4)
+	{
+		pixels[i] = 255;
+	}
+
+	FILE* pFile = fopen(filename.c_str(), "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not write the frame image:" << filename << std::endl;
+		return(false);
+	}
+
+	bool bWritten = false;
+	if (m_format == IMAGE_PNG)
+	{
+		std::vector<unsigned char> file;
+		EncodePNG(pixels, job.width, job.height, file);
+		bWritten = (fwrite(file.data(), 1, file.size(), pFile) == file.size());
+	}
+	else
+	{
+		// uncompressed true color with 8 bits of alpha and the
+		// first row at the bottom, as OpenGL reads it back
+		unsigned char header[g_TGAHeaderSize] = { 0 };
+		header[2] = 2;
+		header[12] = (unsigned char)(job.width & 0xFF);
+		header[13] = (unsigned char)(job.width >> 8);
+		header[14] = (unsigned char)(job.height & 0xFF);
+		header[15] = (unsigned char)(job.height >> 8);
+		header[16] = 32;
+		header[17] = 8;
+		bWritten = (fwrite(header, 1, sizeof(header), pFile) == sizeof(header)) &&
+			(fwrite(pixels.data(), 1, pixels.size(), pFile) == pixels.size());
+	}
+	fclose(pFile);
+
+	if (!bWritten)
+	{
+		std::cout << "Could not write the frame image:" << filename << std::endl;
+	}
+
+	return(bWritten);
+}
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// read rendered frames back without stalling and write them to image files
+//
+//	Every captured frame is read into the next pixel buffer object of a
+//	small ring, and a fence marks when the copy has finished on the GPU.
+//	The pixels are only mapped once the fence has passed, a few frames
+//	later, and a writer thread encodes them to files while the next frames
+//	are rendered.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  This class captures the frames drawn into the bound read
+ *  framebuffer and writes them as numbered image files into
+ *  an output folder. Only the rendering thread calls into
+ *  OpenGL, and the files are written in the background.
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	// image file formats - TGA files hold the raw pixels as they
+	// are read back, and PNG files hold them without compression
+	enum IMAGE_FORMAT
+	{
+		IMAGE_TGA = 0,
+		IMAGE_PNG
+	};
+
+	// constructor - the ring size is the number of frames that
+	// can be read back at the same time
+	FrameCapture(
+		int width,
+		int height,
+		const std::string& outputFolder,
+		IMAGE_FORMAT format,
+		int ringSize = 3);
+	// destructor - finishes the capture
+	~FrameCapture();
+
+	// start reading back the frame in the read framebuffer, and
+	// hand the older frames that finished to the writer thread
+	void CaptureFrame();
+	// change the size of the captured frames to a new size of
+	// the framebuffer - the frames being read back are collected
+	// first, and a size of 0 keeps the last size
+	void Resize(int width, int height);
+	// wait for every captured frame to be read back and written
+	void Finish();
+
+	// get the number of captured frames, and the number of times
+	// a capture had to wait for an older frame to be read back
+	int GetCapturedFrameCount() const { return m_capturedFrames; }
+	int GetStallCount() const { return m_stallCount; }
+
+	// get the image format from its file extension name - any
+	// name other than png gives TGA files
+	static IMAGE_FORMAT FormatFromName(const std::string& name);
+
+private:
+	// one pixel buffer object of the ring, and the fence and the
+	// frame number of the readback into it
+	struct READBACK_SLOT
+	{
+		GLuint pixelBuffer;
+		GLsync fence;
+		int frameNumber;
+		int width;
+		int height;
+	};
+
+	// a frame read back and waiting for the writer thread
+	struct WRITE_JOB
+	{
+		int frameNumber;
+		int width;
+		int height;
+		std::vector<unsigned char>* pPixels;
+	};
+
+	int m_width;
+	int m_height;
+	std::string m_outputFolder;
+	IMAGE_FORMAT m_format;
+	// pixel format read back, which is the order that the image
+	// format stores the color channels in
+	GLenum m_readFormat;
+
+	// pixel buffer objects used in turn, and the next one to use
+	std::vector<READBACK_SLOT> m_slots;
+	int m_nextSlot;
+	int m_capturedFrames;
+	int m_stallCount;
+
+	// image writer thread
+	std::thread m_writer;
+	// guards the job queue, the free pixel arrays and the stop
+	// flag
+	std::mutex m_mutex;
+	// signalled when a job is queued or the writer must stop
+	std::condition_variable m_jobReady;
+	// signalled when the writer has finished a job
+	std::condition_variable m_jobDone;
+	// frames waiting for the writer thread
+	std::deque<WRITE_JOB> m_jobs;
+	// pixel arrays that the writer has finished with, kept for
+	// the next frames
+	std::vector<std::vector<unsigned char>*> m_freePixels;
+	// true when the writer must stop after the queued jobs
+	bool m_bStopping;
+
+	// map a finished readback and queue its pixels for writing,
+	// waiting for the fence when told to
+	bool CollectSlot(READBACK_SLOT& slot, bool bWait);
+	// write the queued frames until stopping
+	void WriteFrames();
+	// write the pixels of one frame into an image file
+	bool WriteImage(const WRITE_JOB& job) const;
+};
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepipeline.cpp
+// ============
+// prepare the next frame on an update thread while this one is drawn
+//
+//	The slot exchange follows a triple buffer: the update thread swaps its
+//	finished slot into the shared one, and the rendering thread swaps its
+//	read slot for the shared one only when the fresh bit is set. Either
+//	thread always owns a slot that the other one cannot touch.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FramePipeline.h"
+
+// declaration of global variables and defines
+namespace
+{
+	// bit set in the shared slot while it holds a snapshot that
+	// the rendering thread has not taken, above the slot index
+	const int g_FreshSnapshotBit = 4;
+	const int g_SlotIndexMask = 3;
+}
+
+/***********************************************************
+ *  FramePipeline()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FramePipeline::FramePipeline(SceneManager* pSceneManager)
+{
+	m_pSceneManager = pSceneManager;
+	m_writeSlot = 0;
+	m_sharedSlot = 1;
+	m_readSlot = 2;
+	m_requestedFrames = 0;
+	m_requestView = glm::mat4(1.0f);
+	m_requestProjection = glm::mat4(1.0f);
+	m_requestPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_bRequestPending = false;
+	m_bStopping = false;
+
+	m_updateThread = std::thread(&FramePipeline::UpdateFrames, this);
+}
+
+/***********************************************************
+ *  ~FramePipeline()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FramePipeline::~FramePipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_requestReady.notify_all();
+
+	m_updateThread.join();
+	m_pSceneManager = NULL;
+}
+
+/***********************************************************
+ *  RequestFrame()
+ *
+ *  This method is used for handing the camera view of the
+ *  next frame to the update thread, which starts preparing
+ *  its snapshot right away.
+ ***********************************************************/
+void FramePipeline::RequestFrame(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& position)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requestView = view;
+		m_requestProjection = projection;
+		m_requestPosition = position;
+		m_bRequestPending = true;
+	}
+	m_requestReady.notify_one();
+
+	m_requestedFrames++;
+}
+
+/***********************************************************
+ *  WaitFrame()
+ *
+ *  This method is used for taking the snapshot of the
+ *  requested frame, waiting for the update thread only when
+ *  it has not handed the snapshot over yet.
+ ***********************************************************/
+SceneManager::FRAME_SNAPSHOT* FramePipeline::WaitFrame()
+{
+	if (m_requestedFrames == 0)
+	{
+		return(NULL);
+	}
+
+	if (TakeSnapshot() == false)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ((m_sharedSlot.load() & g_FreshSnapshotBit) == 0)
+			{
+				m_snapshotReady.wait(lock);
+			}
+		}
+		TakeSnapshot();
+	}
+	m_requestedFrames--;
+
+	return(&m_snapshots[m_readSlot]);
+}
+
+/***********************************************************
+ *  TakeSnapshot()
+ *
+ *  This method is used for swapping the read slot for the
+ *  handed over slot when the update thread has put a new
+ *  snapshot in it.
+ ***********************************************************/
+bool FramePipeline::TakeSnapshot()
+{
+	if ((m_sharedSlot.load() & g_FreshSnapshotBit) == 0)
+	{
+		return(false);
+	}
+
+	m_readSlot = m_sharedSlot.exchange(m_readSlot) & g_SlotIndexMask;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateFrames()
+ *
+ *  This method is used by the update thread for preparing a
+ *  snapshot for every requested frame until the pipeline is
+ *  destroyed.
+ ***********************************************************/
+void FramePipeline::UpdateFrames()
+{
+	while (true)
+	{
+		SceneManager::FRAME_SNAPSHOT& snapshot = m_snapshots[m_writeSlot];
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ((m_bRequestPending == false) && (m_bStopping == false))
+			{
+				m_requestReady.wait(lock);
+			}
+			if (m_bStopping)
+			{
+				return;
+			}
+			snapshot.view = m_requestView;
+			snapshot.projection = m_requestProjection;
+			snapshot.cameraPosition = m_requestPosition;
+			m_bRequestPending = false;
+		}
+
+		m_pSceneManager->PrepareFrame(snapshot);
+
+		// hand the snapshot over and take back the slot that the
+		// rendering thread let go of, or the older snapshot that
+		// it never took
+		m_writeSlot = m_sharedSlot.exchange(m_writeSlot | g_FreshSnapshotBit) & g_SlotIndexMask;
+
+		// taking the lock makes sure that a waiting rendering
+		// thread is either asleep already or sees the fresh bit
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+		}
+		m_snapshotReady.notify_one();
+	}
+}
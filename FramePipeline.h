@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepipeline.h
+// ============
+// prepare the next frame on an update thread while this one is drawn
+//
+//	The rendering thread keeps the window input and every OpenGL call.
+//	It hands the camera view of the next frame to the update thread, which
+//	culls and sorts the scene packets for it while the rendering thread
+//	submits the current frame and waits for the buffer swap. The prepared
+//	snapshots pass between the threads through three slots that are
+//	swapped with one atomic exchange, so neither thread locks a snapshot.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  FramePipeline
+ *
+ *  This class runs the update thread of the frame loop. Every
+ *  call of RequestFrame() makes one frame snapshot, which the
+ *  next call of WaitFrame() takes. The scene must only be
+ *  changed between WaitFrame() and the next RequestFrame(),
+ *  while the update thread has nothing to prepare.
+ ***********************************************************/
+class FramePipeline
+{
+public:
+	// constructor - starts the update thread
+	FramePipeline(SceneManager* pSceneManager);
+	// destructor - stops the update thread after the frame that
+	// it is preparing
+	~FramePipeline();
+
+	// queue the camera view of the next frame to prepare
+	void RequestFrame(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& position);
+	// wait for the snapshot of the requested frame and take it -
+	// it stays valid until the next call, and NULL is returned
+	// when no frame was requested
+	SceneManager::FRAME_SNAPSHOT* WaitFrame();
+
+private:
+	// scene that the snapshots are prepared from
+	SceneManager* m_pSceneManager;
+	// snapshot slots - one written by the update thread, one read
+	// by the rendering thread, and one handed between them
+	SceneManager::FRAME_SNAPSHOT m_snapshots[3];
+	// slot written by the update thread, used only by it
+	int m_writeSlot;
+	// slot read by the rendering thread, used only by it
+	int m_readSlot;
+	// slot handed between the threads, with the fresh bit set
+	// while it holds a snapshot that was not taken yet
+	std::atomic<int> m_sharedSlot;
+	// frames requested and not taken yet, used only by the
+	// rendering thread
+	int m_requestedFrames;
+
+	// update thread
+	std::thread m_updateThread;
+	// guards the requested view and the stop flag, and the sleep
+	// of both threads
+	std::mutex m_mutex;
+	// signalled when a frame is requested or the thread must stop
+	std::condition_variable m_requestReady;
+	// signalled when a snapshot is handed over
+	std::condition_variable m_snapshotReady;
+	// camera view of the requested frame
+	glm::mat4 m_requestView;
+	glm::mat4 m_requestProjection;
+	glm::vec3 m_requestPosition;
+	// true while a requested frame was not started yet
+	bool m_bRequestPending;
+	// true when the update thread must stop
+	bool m_bStopping;
+
+	// take the handed over slot when it holds a new snapshot -
+	// returns false when there is none
+	bool TakeSnapshot();
+	// prepare the requested frames until stopping
+	void UpdateFrames();
+};
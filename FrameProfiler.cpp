@@ -0,0 +1,466 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.cpp
+// ============
+// time the named zones of every frame on the CPU and on the GPU
+//
+//	Timestamp queries are used for the GPU instead of elapsed time
+//	queries, since only one elapsed time query can run at a time and the
+//	zones nest. Every frame keeps its own query pool, and two frames are
+//	used in turn.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// declaration of global variables and defines
+namespace
+{
+	// number of frames that the zone statistics are taken over
+	const int g_HistoryFrames = 240;
+	// most zones kept for the trace file, after which the trace
+	// stops growing
+	const size_t g_MaxTraceEvents = 500000;
+	// number of frames whose queries are in flight at once
+	const int g_FrameRecords = 2;
+	// queries added to a frame pool when it runs out
+	const size_t g_QueryPoolGrowth = 64;
+	// name of the zone around each whole frame
+	const char* const g_FrameZoneName = "Frame";
+
+	// one run of a zone in a frame, with its CPU times in
+	// microseconds and the index of its first query
+	struct ZONE_RECORD
+	{
+		int zone;
+		double cpuStart;
+		double cpuEnd;
+		size_t queryIndex;
+	};
+
+	// the zones and queries of one frame, and the CPU and GPU
+	// times taken together when the frame began
+	struct FRAME_RECORD
+	{
+		std::vector<ZONE_RECORD> zones;
+		std::vector<GLuint> queries;
+		size_t usedQueries;
+		double cpuCalibration;
+		GLint64 gpuCalibration;
+		bool bPending;
+	};
+
+	// the per frame totals of a zone over the last frames, which
+	// are only added in the frames that the zone ran
+	struct ZONE_HISTORY
+	{
+		const char* name;
+		float cpuSamples[g_HistoryFrames];
+		float gpuSamples[g_HistoryFrames];
+		int nextSample;
+		int sampleCount;
+		int lastCalls;
+		// totals of the frame being resolved
+		double frameCpu;
+		double frameGpu;
+		int frameCalls;
+	};
+
+	// one zone kept for the trace file, in microseconds
+	struct TRACE_EVENT
+	{
+		int zone;
+		bool bGPU;
+		double start;
+		double duration;
+	};
+
+	// read by the zones of every thread, so they are atomic
+	std::atomic<bool> g_bEnabled(false);
+	std::atomic<bool> g_bInFrame(false);
+	// thread that enabled the profiling, which owns the OpenGL
+	// context that the queries are issued on - the zones of other
+	// threads check it before touching anything else
+	std::atomic<std::thread::id> g_RenderThread;
+	std::vector<ZONE_HISTORY> g_Zones;
+	FRAME_RECORD g_Frames[g_FrameRecords];
+	int g_CurrentFrame = 0;
+	// records of the open zones in the current frame
+	std::vector<size_t> g_ZoneStack;
+	std::vector<TRACE_EVENT> g_Trace;
+	std::chrono::steady_clock::time_point g_StartTime = std::chrono::steady_clock::now();
+
+	/***********************************************************
+	 *  NowMicroseconds()
+	 *
+	 *  This helper function is used for getting the CPU time
+	 *  since the program started, in microseconds.
+	 ***********************************************************/
+	double NowMicroseconds()
+	{
+		return(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_StartTime).count());
+	}
+
+	/***********************************************************
+	 *  FindZone()
+	 *
+	 *  This helper function is used for getting the index of the
+	 *  zone with the passed in name, and for adding the zone the
+	 *  first time that it runs.
+	 ***********************************************************/
+	int FindZone(const char* name)
+	{
+		for (size_t i = 0; i < g_Zones.size(); i++)
+		{
+			if ((g_Zones[i].name == name) || (strcmp(g_Zones[i].name, name) == 0))
+			{
+				return((int)i);
+			}
+		}
+
+		ZONE_HISTORY zone;
+		memset(&zone, 0, sizeof(zone));
+		zone.name = name;
+		g_Zones.push_back(zone);
+
+		return((int)g_Zones.size() - 1);
+	}
+
+	/***********************************************************
+	 *  ResolveFrame()
+	 *
+	 *  This helper function is used for reading the queries of a
+	 *  frame that was issued one frame ago, and for adding its
+	 *  zone times to the statistics and the trace.
+	 ***********************************************************/
+	void ResolveFrame(FRAME_RECORD& frame)
+	{
+		if (!frame.bPending)
+		{
+			return;
+		}
+		frame.bPending = false;
+
+		for (size_t i = 0; i < frame.zones.size(); i++)
+		{
+			const ZONE_RECORD& record = frame.zones[i];
+			GLuint64 gpuStart = 0;
+			GLuint64 gpuEnd = 0;
+			glGetQueryObjectui64v(frame.queries[record.queryIndex], GL_QUERY_RESULT, &gpuStart);
+			glGetQueryObjectui64v(frame.queries[record.queryIndex + 1], GL_QUERY_RESULT, &gpuEnd);
+
+			double cpuDuration = record.cpuEnd - record.cpuStart;
+			double gpuDuration = (gpuEnd > gpuStart) ? (gpuEnd - gpuStart) / 1000.0 : 0.0;
+
+			ZONE_HISTORY& zone = g_Zones[record.zone];
+			zone.frameCpu += cpuDuration;
+			zone.frameGpu += gpuDuration;
+			zone.frameCalls++;
+
+			if (g_Trace.size() + 2 <= g_MaxTraceEvents)
+			{
+				TRACE_EVENT event;
+				event.zone = record.zone;
+				event.bGPU = false;
+				event.start = record.cpuStart;
+				event.duration = cpuDuration;
+				g_Trace.push_back(event);
+
+				// the GPU clock is moved onto the CPU clock with the
+				// times taken together at the start of the frame
+				event.bGPU = true;
+				event.start = frame.cpuCalibration + ((GLint64)gpuStart - frame.gpuCalibration) / 1000.0;
+				event.duration = gpuDuration;
+				g_Trace.push_back(event);
+			}
+		}
+
+		for (size_t i = 0; i < g_Zones.size(); i++)
+		{
+			ZONE_HISTORY& zone = g_Zones[i];
+			if (zone.frameCalls == 0)
+			{
+				continue;
+			}
+
+			zone.cpuSamples[zone.nextSample] = (float)(zone.frameCpu / 1000.0);
+			zone.gpuSamples[zone.nextSample] = (float)(zone.frameGpu / 1000.0);
+			zone.nextSample = (zone.nextSample + 1) % g_HistoryFrames;
+			zone.sampleCount = std::min(zone.sampleCount + 1, g_HistoryFrames);
+			zone.lastCalls = zone.frameCalls;
+
+			zone.frameCpu = 0.0;
+			zone.frameGpu = 0.0;
+			zone.frameCalls = 0;
+		}
+	}
+
+	/***********************************************************
+	 *  GetSampleStats()
+	 *
+	 *  This helper function is used for getting the minimum, the
+	 *  average and the 99th percentile of a zone sample array.
+	 ***********************************************************/
+	void GetSampleStats(const float* pSamples, int sampleCount, float& minimum, float& average, float& percentile)
+	{
+		std::vector<float> sorted(pSamples, pSamples + sampleCount);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (int i = 0; i < sampleCount; i++)
+		{
+			total += sorted[i];
+		}
+
+		minimum = sorted[0];
+		average = (float)(total / sampleCount);
+		percentile = sorted[std::min(sampleCount - 1, (sampleCount * 99) / 100)];
+	}
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for turning the profiling on or off.
+ *  It must be called between frames.
+ ***********************************************************/
+void FrameProfiler::SetEnabled(bool bEnable)
+{
+	g_RenderThread = std::this_thread::get_id();
+	g_bInFrame = false;
+	g_ZoneStack.clear();
+	g_bEnabled = bEnable;
+}
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  This method is used for getting whether the profiling is
+ *  turned on.
+ ***********************************************************/
+bool FrameProfiler::IsEnabled()
+{
+	return(g_bEnabled);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame and the zone
+ *  around the whole frame.
+ ***********************************************************/
+void FrameProfiler::BeginFrame()
+{
+	if (!g_bEnabled)
+	{
+		return;
+	}
+
+	FRAME_RECORD& frame = g_Frames[g_CurrentFrame];
+	frame.zones.clear();
+	frame.usedQueries = 0;
+	glGetInteger64v(GL_TIMESTAMP, &frame.gpuCalibration);
+	frame.cpuCalibration = NowMicroseconds();
+
+	g_bInFrame = true;
+	g_ZoneStack.clear();
+	BeginZone(g_FrameZoneName);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for ending the current frame, and for
+ *  resolving the frame before it, whose queries the GPU has
+ *  had a whole frame to finish.
+ ***********************************************************/
+void FrameProfiler::EndFrame()
+{
+	if (!g_bEnabled || !g_bInFrame)
+	{
+		return;
+	}
+
+	while (!g_ZoneStack.empty())
+	{
+		EndZone();
+	}
+	g_bInFrame = false;
+	g_Frames[g_CurrentFrame].bPending = true;
+
+	g_CurrentFrame = (g_CurrentFrame + 1) % g_FrameRecords;
+	ResolveFrame(g_Frames[g_CurrentFrame]);
+}
+
+/***********************************************************
+ *  BeginZone()
+ *
+ *  This method is used for starting a zone in the current
+ *  frame, on the CPU and in the GPU command stream.
+ ***********************************************************/
+void FrameProfiler::BeginZone(const char* name)
+{
+	if ((std::this_thread::get_id() != g_RenderThread.load()) || !g_bEnabled || !g_bInFrame)
+	{
+		return;
+	}
+
+	FRAME_RECORD& frame = g_Frames[g_CurrentFrame];
+	if (frame.usedQueries + 2 > frame.queries.size())
+	{
+		size_t oldSize = frame.queries.size();
+		frame.queries.resize(oldSize + std::max(g_QueryPoolGrowth, oldSize));
+		glGenQueries((GLsizei)(frame.queries.size() - oldSize), &frame.queries[oldSize]);
+	}
+
+	ZONE_RECORD record;
+	record.zone = FindZone(name);
+	record.queryIndex = frame.usedQueries;
+	frame.usedQueries += 2;
+
+	glQueryCounter(frame.queries[record.queryIndex], GL_TIMESTAMP);
+	record.cpuStart = NowMicroseconds();
+	record.cpuEnd = record.cpuStart;
+
+	g_ZoneStack.push_back(frame.zones.size());
+	frame.zones.push_back(record);
+}
+
+/***********************************************************
+ *  EndZone()
+ *
+ *  This method is used for ending the zone that was started
+ *  last.
+ ***********************************************************/
+void FrameProfiler::EndZone()
+{
+	if ((std::this_thread::get_id() != g_RenderThread.load()) || !g_bEnabled || g_ZoneStack.empty())
+	{
+		return;
+	}
+
+	FRAME_RECORD& frame = g_Frames[g_CurrentFrame];
+	ZONE_RECORD& record = frame.zones[g_ZoneStack.back()];
+	g_ZoneStack.pop_back();
+
+	record.cpuEnd = NowMicroseconds();
+	glQueryCounter(frame.queries[record.queryIndex + 1], GL_TIMESTAMP);
+}
+
+/***********************************************************
+ *  GetZoneStats()
+ *
+ *  This method is used for getting the rolling statistics of
+ *  every zone that has run.
+ ***********************************************************/
+void FrameProfiler::GetZoneStats(std::vector<ZONE_STATS>& stats)
+{
+	stats.clear();
+
+	for (size_t i = 0; i < g_Zones.size(); i++)
+	{
+		const ZONE_HISTORY& zone = g_Zones[i];
+		if (zone.sampleCount == 0)
+		{
+			continue;
+		}
+
+		ZONE_STATS zoneStats;
+		zoneStats.name = zone.name;
+		zoneStats.calls = zone.lastCalls;
+		GetSampleStats(zone.cpuSamples, zone.sampleCount, zoneStats.cpuMin, zoneStats.cpuAverage, zoneStats.cpu99th);
+		GetSampleStats(zone.gpuSamples, zone.sampleCount, zoneStats.gpuMin, zoneStats.gpuAverage, zoneStats.gpu99th);
+		stats.push_back(zoneStats);
+	}
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method is used for printing the rolling statistics
+ *  of every zone.
+ ***********************************************************/
+void FrameProfiler::PrintReport()
+{
+	std::vector<ZONE_STATS> stats;
+	GetZoneStats(stats);
+
+	std::cout << "Frame profile over the last " << g_HistoryFrames << " frames, in ms min/avg/p99:" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		std::cout << "  " << stats[i].name << " x" << stats[i].calls
+			<< " - CPU " << stats[i].cpuMin << "/" << stats[i].cpuAverage << "/" << stats[i].cpu99th
+			<< ", GPU " << stats[i].gpuMin << "/" << stats[i].gpuAverage << "/" << stats[i].gpu99th << std::endl;
+	}
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << std::setprecision(6);
+}
+
+/***********************************************************
+ *  WriteTrace()
+ *
+ *  This method is used for writing the recorded zones into a
+ *  file in the Chrome trace event format, with the CPU zones
+ *  and the GPU zones on two separate tracks.
+ ***********************************************************/
+bool FrameProfiler::WriteTrace(const char* filename)
+{
+	std::ofstream traceFile(filename);
+	if (!traceFile.is_open())
+	{
+		std::cout << "Could not write the profile trace:" << filename << std::endl;
+		return(false);
+	}
+
+	traceFile << std::fixed << std::setprecision(3);
+	traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	traceFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	traceFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	for (size_t i = 0; i < g_Trace.size(); i++)
+	{
+		const TRACE_EVENT& event = g_Trace[i];
+		traceFile << ",\n{\"name\":\"" << g_Zones[event.zone].name
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.bGPU ? 2 : 1)
+			<< ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+	}
+	traceFile << "\n]}\n";
+
+	if (g_Trace.size() + 2 > g_MaxTraceEvents)
+	{
+		std::cout << "The profile trace was full, so only the first frames were written" << std::endl;
+	}
+
+	return(traceFile.good());
+}
+
+/***********************************************************
+ *  Shutdown()
+ *
+ *  This method is used for turning the profiling off and for
+ *  freeing the queries of every frame.
+ ***********************************************************/
+void FrameProfiler::Shutdown()
+{
+	SetEnabled(false);
+
+	for (int i = 0; i < g_FrameRecords; i++)
+	{
+		FRAME_RECORD& frame = g_Frames[i];
+		if (!frame.queries.empty())
+		{
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		}
+		frame.queries.clear();
+		frame.zones.clear();
+		frame.usedQueries = 0;
+		frame.bPending = false;
+	}
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.h
+// ============
+// time the named zones of every frame on the CPU and on the GPU
+//
+//	The GPU times come from timestamp queries that are read one frame
+//	after they were issued, when the GPU has almost always finished them,
+//	so profiling never waits for the GPU. The zones of a frame can be
+//	written out as a trace file for chrome://tracing or Perfetto.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  FrameProfiler
+ *
+ *  This class collects the CPU and GPU time spent in the
+ *  zones of each frame, keeps the totals of the last frames
+ *  for every zone, and records the zones for a trace file.
+ *  It is only used from the rendering thread, and does
+ *  nothing until it is enabled. Zones that run on other
+ *  threads are skipped, so code shared with a worker thread
+ *  can keep its zones.
+ ***********************************************************/
+class FrameProfiler
+{
+public:
+	// rolling statistics of one zone over the last frames, in
+	// milliseconds of zone time per frame
+	struct ZONE_STATS
+	{
+		const char* name;
+		float cpuMin;
+		float cpuAverage;
+		float cpu99th;
+		float gpuMin;
+		float gpuAverage;
+		float gpu99th;
+		// times the zone ran in the last resolved frame
+		int calls;
+	};
+
+	// turn the profiling on or off between frames
+	static void SetEnabled(bool bEnable);
+	static bool IsEnabled();
+
+	// mark the start and the end of a frame - the zones are only
+	// timed between these calls
+	static void BeginFrame();
+	static void EndFrame();
+
+	// start and end a zone, which can hold nested zones - the
+	// name must stay valid until the profiler shuts down
+	static void BeginZone(const char* name);
+	static void EndZone();
+
+	// get the statistics of every zone, and print them
+	static void GetZoneStats(std::vector<ZONE_STATS>& stats);
+	static void PrintReport();
+
+	// write the recorded zones into a Chrome trace JSON file
+	static bool WriteTrace(const char* filename);
+
+	// free the queries - must be called while the OpenGL context
+	// still exists
+	static void Shutdown();
+};
+
+/***********************************************************
+ *  ProfileZone
+ *
+ *  This class times a zone from its construction until the
+ *  end of the scope that holds it.
+ ***********************************************************/
+class ProfileZone
+{
+public:
+	// constructor - starts the zone
+	explicit ProfileZone(const char* name) { FrameProfiler::BeginZone(name); }
+	// destructor - ends the zone
+	~ProfileZone() { FrameProfiler::EndZone(); }
+};
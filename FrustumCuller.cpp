@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// test world-space bounding boxes against the planes of the view frustum
+//
+//	The boxes are kept as separate arrays of centers and extents, so that
+//	four boxes are tested against a plane with a single set of SSE
+//	instructions. Builds without SSE use the same test one box at a time.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <cmath>
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	// planes that never cull anything until the first update
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for resizing the box arrays. The
+ *  padding boxes after the last one are never reported.
+ ***********************************************************/
+void FrustumCuller::BOX_LIST::Resize(size_t boxCount)
+{
+	size_t paddedCount = (boxCount + 3) & ~(size_t)3;
+
+	count = boxCount;
+	centerX.assign(paddedCount, 0.0f);
+	centerY.assign(paddedCount, 0.0f);
+	centerZ.assign(paddedCount, 0.0f);
+	extentX.assign(paddedCount, 0.0f);
+	extentY.assign(paddedCount, 0.0f);
+	extentZ.assign(paddedCount, 0.0f);
+}
+
+/***********************************************************
+ *  SetBox()
+ *
+ *  This method is used for setting one box of the list from
+ *  its minimum and maximum corners.
+ ***********************************************************/
+void FrustumCuller::BOX_LIST::SetBox(size_t index, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	centerX[index] = (boxMin.x + boxMax.x) * 0.5f;
+	centerY[index] = (boxMin.y + boxMax.y) * 0.5f;
+	centerZ[index] = (boxMin.z + boxMax.z) * 0.5f;
+	extentX[index] = (boxMax.x - boxMin.x) * 0.5f;
+	extentY[index] = (boxMax.y - boxMin.y) * 0.5f;
+	extentZ[index] = (boxMax.z - boxMin.z) * 0.5f;
+}
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  This method is used for extracting the six frustum planes
+ *  from the rows of the view projection matrix, and for
+ *  normalizing them so that the plane distances are in
+ *  world units.
+ ***********************************************************/
+void FrustumCuller::SetViewProjection(const glm::mat4& viewProjection)
+{
+	glm::vec4 rows[4];
+
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = glm::vec4(
+			viewProjection[0][row],
+			viewProjection[1][row],
+			viewProjection[2][row],
+			viewProjection[3][row]);
+	}
+
+	m_planes[0] = rows[3] + rows[0];
+	m_planes[1] = rows[3] - rows[0];
+	m_planes[2] = rows[3] + rows[1];
+	m_planes[3] = rows[3] - rows[1];
+	m_planes[4] = rows[3] + rows[2];
+	m_planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+		{
+			m_planes[i] = m_planes[i] / length;
+		}
+	}
+}
+
+/***********************************************************
+ *  TestBox()
+ *
+ *  This method is used for testing one box against the six
+ *  frustum planes.
+ ***********************************************************/
+bool FrustumCuller::TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = m_planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+
+		if (distance + radius < 0.0f)
+		{
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ClassifyBox()
+ *
+ *  This method is used for testing one box against the six
+ *  frustum planes and telling apart the boxes that are
+ *  completely inside from the ones that cross a plane.
+ ***********************************************************/
+FrustumCuller::BOX_CLASS FrustumCuller::ClassifyBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	BOX_CLASS boxClass = BOX_INSIDE;
+
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = m_planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+
+		if (distance + radius < 0.0f)
+		{
+			return(BOX_OUTSIDE);
+		}
+		if (distance - radius < 0.0f)
+		{
+			boxClass = BOX_INTERSECTING;
+		}
+	}
+
+	return(boxClass);
+}
+
+/***********************************************************
+ *  CullBoxes()
+ *
+ *  This method is used for testing every box of a list
+ *  against the six frustum planes.
+ ***********************************************************/
+int FrustumCuller::CullBoxes(const BOX_LIST& boxes, std::vector<unsigned char>& visible) const
+{
+	visible.resize(boxes.count);
+
+	return(CullBoxRange(boxes, 0, boxes.count, visible));
+}
+
+/***********************************************************
+ *  CullBoxRange()
+ *
+ *  This method is used for testing the boxes of a list from
+ *  the first box up to the end box against the six frustum
+ *  planes. With SSE, four boxes are tested against each
+ *  plane at once. Only the flags of the range are written,
+ *  so threads can cull separate ranges of one list.
+ ***********************************************************/
+int FrustumCuller::CullBoxRange(
+	const BOX_LIST& boxes,
+	size_t firstBox,
+	size_t endBox,
+	std::vector<unsigned char>& visible) const
+{
+	int visibleCount = 0;
+
+	if (endBox > boxes.count)
+	{
+		endBox = boxes.count;
+	}
+
+#ifdef FRUSTUM_CULLER_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = firstBox; i < endBox; i += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 planeX = _mm_set1_ps(m_planes[p].x);
+			__m128 planeY = _mm_set1_ps(m_planes[p].y);
+			__m128 planeZ = _mm_set1_ps(m_planes[p].z);
+			__m128 planeW = _mm_set1_ps(m_planes[p].w);
+
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX, centerX), _mm_mul_ps(planeY, centerY)),
+				_mm_add_ps(_mm_mul_ps(planeZ, centerZ), planeW));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(_mm_andnot_ps(signMask, planeX), extentX),
+					_mm_mul_ps(_mm_andnot_ps(signMask, planeY), extentY)),
+				_mm_mul_ps(_mm_andnot_ps(signMask, planeZ), extentZ));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (size_t lane = 0; (lane < 4) && (i + lane < endBox); lane++)
+		{
+			visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+			visibleCount += visible[i + lane];
+		}
+	}
+#else
+	for (size_t i = firstBox; i < endBox; i++)
+	{
+		glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+		glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+		visible[i] = TestBox(center - extent, center + extent) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+#endif
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  This method is used for getting the world-space box that
+ *  encloses a local box after the model matrix moved it.
+ *  The extent of the world box is the local extent through
+ *  the absolute values of the rotation and scale columns.
+ ***********************************************************/
+void FrustumCuller::TransformBounds(
+	const glm::mat4& model,
+	const glm::vec3& localMin,
+	const glm::vec3& localMax,
+	glm::vec3& worldMin,
+	glm::vec3& worldMax)
+{
+	glm::vec3 center = (localMin + localMax) * 0.5f;
+	glm::vec3 extent = (localMax - localMin) * 0.5f;
+	glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		worldExtent[axis] =
+			std::fabs(model[0][axis]) * extent.x +
+			std::fabs(model[1][axis]) * extent.y +
+			std::fabs(model[2][axis]) * extent.z;
+	}
+
+	worldMin = worldCenter - worldExtent;
+	worldMax = worldCenter + worldExtent;
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// test world-space bounding boxes against the planes of the view frustum
+//
+//	The boxes are kept as separate arrays of centers and extents, so that
+//	four boxes are tested against a plane with a single set of SSE
+//	instructions. Builds without SSE use the same test one box at a time.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class extracts the six frustum planes from a view
+ *  projection matrix and tests axis-aligned bounding boxes
+ *  against them. A box is only culled when it is completely
+ *  outside of one of the planes.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+
+	// axis-aligned boxes as center and extent arrays - the
+	// arrays are padded to a multiple of four boxes
+	struct BOX_LIST
+	{
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+		size_t count;
+
+		BOX_LIST() : count(0) {}
+		// resize the arrays for the passed in number of boxes
+		void Resize(size_t boxCount);
+		// set one box from its minimum and maximum corners
+		void SetBox(size_t index, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	};
+
+	// result of classifying a box against the frustum
+	enum BOX_CLASS
+	{
+		BOX_OUTSIDE = 0,
+		BOX_INTERSECTING,
+		BOX_INSIDE
+	};
+
+	// extract the frustum planes from a view projection matrix
+	void SetViewProjection(const glm::mat4& viewProjection);
+
+	// test one box - returns false when it is outside
+	bool TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+	// classify one box as outside, crossing or inside of the
+	// frustum, for skipping the tests below an inside node
+	BOX_CLASS ClassifyBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+	// test a list of boxes and set a visible flag for every box,
+	// four boxes at a time - returns the number of visible boxes
+	int CullBoxes(const BOX_LIST& boxes, std::vector<unsigned char>& visible) const;
+	// test the boxes from the first up to the end box and set
+	// their flags in a visible list that already holds every
+	// box - the first box must be a multiple of four for SSE
+	int CullBoxRange(
+		const BOX_LIST& boxes,
+		size_t firstBox,
+		size_t endBox,
+		std::vector<unsigned char>& visible) const;
+
+	// get the six planes extracted from the view projection
+	const glm::vec4* GetPlanes() const { return m_planes; }
+
+	// get the world-space bounding box of a transformed box
+	static void TransformBounds(
+		const glm::mat4& model,
+		const glm::vec3& localMin,
+		const glm::vec3& localMax,
+		glm::vec3& worldMin,
+		glm::vec3& worldMax);
+
+private:
+	// left, right, bottom, top, near and far planes - xyz is the
+	// normal pointing into the frustum and w is the distance
+	glm::vec4 m_planes[6];
+};
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// shadow the OpenGL binding state and drop the updates that change nothing
+//
+//	The uniform values are shadowed by the UniformCache of each program,
+//	which reports its submitted and filtered calls here, so one set of
+//	counters covers all the state traffic of a frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+// declaration of global variables
+namespace
+{
+	// a shadowed value that is not known is marked with this
+	const GLuint g_UnknownBinding = 0xFFFFFFFF;
+
+	// last texture bound on each texture unit
+	GLuint g_BoundTextures[GLStateCache::MAX_TEXTURE_UNITS] = {};
+	GLenum g_BoundTargets[GLStateCache::MAX_TEXTURE_UNITS] = {};
+	// last selected texture unit
+	int g_ActiveUnit = -1;
+	// last bound vertex array object
+	GLuint g_BoundVertexArray = g_UnknownBinding;
+	// true once the texture shadow has been initialized
+	bool g_bTexturesKnown = false;
+
+	// submitted and filtered state calls since the last reset
+	GLStateCache::STATE_COUNTERS g_Counters = {};
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture on a texture
+ *  unit. The unit is only selected and the texture is only
+ *  bound when they differ from the shadowed values.
+ ***********************************************************/
+void GLStateCache::BindTexture(int unit, GLenum target, GLuint textureID)
+{
+	if ((unit < 0) || (unit >= MAX_TEXTURE_UNITS))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, textureID);
+		g_ActiveUnit = -1;
+		g_Counters.submittedTextures++;
+		return;
+	}
+
+	if (g_bTexturesKnown == false)
+	{
+		InvalidateTextures();
+	}
+
+	if ((g_BoundTextures[unit] == textureID) && (g_BoundTargets[unit] == target))
+	{
+		g_Counters.filteredTextures++;
+		return;
+	}
+
+	if (g_ActiveUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		g_ActiveUnit = unit;
+	}
+	glBindTexture(target, textureID);
+	g_BoundTextures[unit] = textureID;
+	g_BoundTargets[unit] = target;
+	g_Counters.submittedTextures++;
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array object
+ *  when it is not already bound.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (g_BoundVertexArray == vao)
+	{
+		g_Counters.filteredVertexArrays++;
+		return;
+	}
+
+	glBindVertexArray(vao);
+	g_BoundVertexArray = vao;
+	g_Counters.submittedVertexArrays++;
+}
+
+/***********************************************************
+ *  InvalidateTextures()
+ *
+ *  This method is used for forgetting the shadowed texture
+ *  bindings, so that the next binding of every unit is sent.
+ ***********************************************************/
+void GLStateCache::InvalidateTextures()
+{
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		g_BoundTextures[i] = g_UnknownBinding;
+		g_BoundTargets[i] = 0;
+	}
+	g_ActiveUnit = -1;
+	g_bTexturesKnown = true;
+}
+
+/***********************************************************
+ *  InvalidateVertexArray()
+ *
+ *  This method is used for forgetting the shadowed vertex
+ *  array binding, for example after a library has drawn
+ *  with its own vertex array objects.
+ ***********************************************************/
+void GLStateCache::InvalidateVertexArray()
+{
+	g_BoundVertexArray = g_UnknownBinding;
+}
+
+/***********************************************************
+ *  CountUniform()
+ *
+ *  This method is used for counting a uniform update that
+ *  was either sent to OpenGL or dropped as a no-op.
+ ***********************************************************/
+void GLStateCache::CountUniform(bool bFiltered)
+{
+	if (bFiltered)
+	{
+		g_Counters.filteredUniforms++;
+	}
+	else
+	{
+		g_Counters.submittedUniforms++;
+	}
+}
+
+/***********************************************************
+ *  CountDrawCall()
+ *
+ *  This method is used for counting a draw call, where one
+ *  multi-draw call counts once.
+ ***********************************************************/
+void GLStateCache::CountDrawCall()
+{
+	g_Counters.drawCalls++;
+}
+
+/***********************************************************
+ *  GetCounters()
+ *
+ *  This method is used for getting the state call counters
+ *  since the last reset.
+ ***********************************************************/
+const GLStateCache::STATE_COUNTERS& GLStateCache::GetCounters()
+{
+	return(g_Counters);
+}
+
+/***********************************************************
+ *  ResetCounters()
+ *
+ *  This method is used for resetting the state call
+ *  counters, usually at the start of a frame.
+ ***********************************************************/
+void GLStateCache::ResetCounters()
+{
+	g_Counters = STATE_COUNTERS();
+}
@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// shadow the OpenGL binding state and drop the updates that change nothing
+//
+//	The uniform values are shadowed by the UniformCache of each program,
+//	which reports its submitted and filtered calls here, so one set of
+//	counters covers all the state traffic of a frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class remembers the last texture and vertex array
+ *  bindings that were sent to OpenGL and skips a binding
+ *  when it is already current. Code that changes the same
+ *  state without going through this class must invalidate
+ *  the shadowed value.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// submitted and filtered state calls since the last reset
+	struct STATE_COUNTERS
+	{
+		unsigned int submittedUniforms;
+		unsigned int filteredUniforms;
+		unsigned int submittedTextures;
+		unsigned int filteredTextures;
+		unsigned int submittedVertexArrays;
+		unsigned int filteredVertexArrays;
+		unsigned int drawCalls;
+	};
+
+	// the maximum number of shadowed texture units
+	static const int MAX_TEXTURE_UNITS = 32;
+
+	// bind a texture on a texture unit
+	static void BindTexture(int unit, GLenum target, GLuint textureID);
+	// bind a vertex array object
+	static void BindVertexArray(GLuint vao);
+
+	// forget the shadowed values after an outside change
+	static void InvalidateTextures();
+	static void InvalidateVertexArray();
+
+	// count a uniform update that was sent or dropped
+	static void CountUniform(bool bFiltered);
+	// count a draw call sent to OpenGL
+	static void CountDrawCall();
+
+	// get and reset the state call counters
+	static const STATE_COUNTERS& GetCounters();
+	static void ResetCounters();
+};
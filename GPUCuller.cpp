@@ -0,0 +1,305 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.cpp
+// ============
+// cull draw packets with a compute shader that writes the draw commands
+//
+//	The packets are culled one per shader thread. Visible packets take the
+//	next command slot from an atomic counter, so the written commands are
+//	packed at the start of the command buffer in no particular order.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUCuller.h"
+#include "SceneMeshes.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// declaration of global variables and defines
+namespace
+{
+	// shader threads in one work group - must match the local
+	// size in the culling shader
+	const GLuint g_WorkGroupSize = 64;
+
+	// storage buffer binding points used by the culling shader
+	const GLuint g_PacketBinding = 0;
+	const GLuint g_CommandBinding = 1;
+	const GLuint g_LevelBinding = 2;
+	// atomic counter buffer binding point of the command count
+	const GLuint g_CounterBinding = 0;
+}
+
+/***********************************************************
+ *  GPUCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUCuller::GPUCuller()
+{
+	m_programID = 0;
+	m_packetBuffer = 0;
+	m_commandBuffer = 0;
+	m_levelBuffer = 0;
+	m_counterBuffer = 0;
+	m_packetCount = 0;
+	m_packetCountLocation = -1;
+	m_frustumPlanesLocation = -1;
+	m_cameraPositionLocation = -1;
+	m_projectionScaleLocation = -1;
+	m_perspectiveLocation = -1;
+	m_levelSwitchSizesLocation = -1;
+	m_levelHysteresisLocation = -1;
+}
+
+/***********************************************************
+ *  ~GPUCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUCuller::~GPUCuller()
+{
+	if (0 != m_programID)
+	{
+		glDeleteProgram(m_programID);
+		m_programID = 0;
+	}
+	if (0 != m_packetBuffer)
+	{
+		glDeleteBuffers(1, &m_packetBuffer);
+		glDeleteBuffers(1, &m_commandBuffer);
+		glDeleteBuffers(1, &m_levelBuffer);
+		glDeleteBuffers(1, &m_counterBuffer);
+		m_packetBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the OpenGL context
+ *  has compute shaders, storage buffers and indirect draws,
+ *  which are all part of OpenGL 4.3.
+ ***********************************************************/
+bool GPUCuller::IsSupported()
+{
+	return(GLEW_VERSION_4_3 == GL_TRUE);
+}
+
+/***********************************************************
+ *  IsDrawCountSupported()
+ *
+ *  This method is used for checking that a multi-draw call
+ *  can read its number of commands from a buffer, which is
+ *  part of OpenGL 4.6 and an extension before that.
+ ***********************************************************/
+bool GPUCuller::IsDrawCountSupported()
+{
+	return((GLEW_VERSION_4_6 == GL_TRUE) || (GLEW_ARB_indirect_parameters == GL_TRUE));
+}
+
+/***********************************************************
+ *  LoadShader()
+ *
+ *  This method is used for compiling and linking the culling
+ *  compute shader from a GLSL file, and for creating the
+ *  buffers that it reads and writes.
+ ***********************************************************/
+bool GPUCuller::LoadShader(const char* filename)
+{
+	std::ifstream shaderFile(filename);
+	if (!shaderFile.is_open())
+	{
+		std::cout << "Could not open culling shader:" << filename << std::endl;
+		return(false);
+	}
+
+	std::stringstream shaderStream;
+	shaderStream << shaderFile.rdbuf();
+	std::string shaderCode = shaderStream.str();
+	const char* pShaderCode = shaderCode.c_str();
+
+	GLint status = GL_FALSE;
+	char infoLog[512];
+
+	GLuint shaderID = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shaderID, 1, &pShaderCode, NULL);
+	glCompileShader(shaderID);
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Culling shader compilation failed:" << filename << std::endl << infoLog << std::endl;
+		glDeleteShader(shaderID);
+		return(false);
+	}
+
+	m_programID = glCreateProgram();
+	glAttachShader(m_programID, shaderID);
+	glLinkProgram(m_programID);
+	glDeleteShader(shaderID);
+	glGetProgramiv(m_programID, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glGetProgramInfoLog(m_programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Culling shader linking failed:" << filename << std::endl << infoLog << std::endl;
+		glDeleteProgram(m_programID);
+		m_programID = 0;
+		return(false);
+	}
+
+	m_packetCountLocation = glGetUniformLocation(m_programID, "packetCount");
+	m_frustumPlanesLocation = glGetUniformLocation(m_programID, "frustumPlanes");
+	m_cameraPositionLocation = glGetUniformLocation(m_programID, "cameraPosition");
+	m_projectionScaleLocation = glGetUniformLocation(m_programID, "projectionScale");
+	m_perspectiveLocation = glGetUniformLocation(m_programID, "bPerspective");
+	m_levelSwitchSizesLocation = glGetUniformLocation(m_programID, "levelSwitchSizes");
+	m_levelHysteresisLocation = glGetUniformLocation(m_programID, "levelHysteresis");
+
+	// the level switching never changes
+	GLfloat switchSizes[SceneMeshes::LOD_LEVELS - 1];
+	for (int level = 0; level < SceneMeshes::LOD_LEVELS - 1; level++)
+	{
+		switchSizes[level] = SceneMeshes::GetLevelSwitchSize(level);
+	}
+	glProgramUniform1fv(m_programID, m_levelSwitchSizesLocation, SceneMeshes::LOD_LEVELS - 1, switchSizes);
+	glProgramUniform1f(m_programID, m_levelHysteresisLocation, SceneMeshes::GetLevelHysteresis());
+
+	glGenBuffers(1, &m_packetBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_levelBuffer);
+	glGenBuffers(1, &m_counterBuffer);
+
+	// the last dispatch must be done with the counter and the
+	// commands before they are reset
+	GLuint zero = 0;
+	glMemoryBarrier(GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_counterBuffer);
+	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetPackets()
+ *
+ *  This method is used for uploading the culling values of
+ *  the draw packets, and for sizing the command buffer so
+ *  that every packet can be visible. The packet levels
+ *  start again at full detail.
+ ***********************************************************/
+void GPUCuller::SetPackets(const std::vector<CULL_PACKET>& packets)
+{
+	if (0 == m_programID)
+	{
+		return;
+	}
+
+	m_packetCount = (GLsizei)packets.size();
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_packetBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, packets.size() * sizeof(CULL_PACKET), packets.data(), GL_STATIC_DRAW);
+
+	std::vector<GLint> levels(packets.size(), 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_levelBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, levels.size() * sizeof(GLint), levels.data(), GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, packets.size() * sizeof(SceneMeshes::DRAW_COMMAND), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Dispatch()
+ *
+ *  This method is used for running the culling shader over
+ *  all the packets for a camera view. The command counter is
+ *  reset first, and when the draw cannot read the counter
+ *  the commands are cleared, so that the slots left unused
+ *  draw no instances.
+ ***********************************************************/
+void GPUCuller::Dispatch(
+	const glm::vec4* frustumPlanes,
+	const glm::vec3& cameraPosition,
+	float projectionScale,
+	bool bPerspective)
+{
+	if ((0 == m_programID) || (0 == m_packetCount))
+	{
+		return;
+	}
+
+	// the last dispatch must be done with the counter and the
+	// commands before they are reset
+	GLuint zero = 0;
+	glMemoryBarrier(GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_counterBuffer);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	if (!IsDrawCountSupported())
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		glClearBufferData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	glProgramUniform1ui(m_programID, m_packetCountLocation, (GLuint)m_packetCount);
+	glProgramUniform4fv(m_programID, m_frustumPlanesLocation, 6, &frustumPlanes[0].x);
+	glProgramUniform3f(m_programID, m_cameraPositionLocation, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+	glProgramUniform1f(m_programID, m_projectionScaleLocation, projectionScale);
+	glProgramUniform1i(m_programID, m_perspectiveLocation, bPerspective ? 1 : 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_PacketBinding, m_packetBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_CommandBinding, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_LevelBinding, m_levelBuffer);
+	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, g_CounterBinding, m_counterBuffer);
+
+	glUseProgram(m_programID);
+	glDispatchCompute(((GLuint)m_packetCount + g_WorkGroupSize - 1) / g_WorkGroupSize, 1, 1);
+
+	// the draws read the commands and the counter as parameters
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  GetCounterBuffer()
+ *
+ *  This method is used for getting the buffer holding the
+ *  number of commands written, for the draw calls that can
+ *  read it.
+ ***********************************************************/
+GLuint GPUCuller::GetCounterBuffer() const
+{
+	if (!IsDrawCountSupported())
+	{
+		return(0);
+	}
+
+	return(m_counterBuffer);
+}
+
+/***********************************************************
+ *  ReadCommandCount()
+ *
+ *  This method is used for reading back the number of draw
+ *  commands written by the last dispatch.
+ ***********************************************************/
+GLuint GPUCuller::ReadCommandCount() const
+{
+	GLuint commandCount = 0;
+
+	if (0 == m_counterBuffer)
+	{
+		return(0);
+	}
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_counterBuffer);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &commandCount);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	return(commandCount);
+}
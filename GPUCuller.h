@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.h
+// ============
+// cull draw packets with a compute shader that writes the draw commands
+//
+//	The bounding boxes and mesh ranges of the packets stay in a storage
+//	buffer on the GPU. Every frame a compute pass tests them against the
+//	view frustum, picks their tessellation levels and appends an indirect
+//	draw command for each visible packet, so the commands are drawn
+//	without reading anything back to the CPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  GPUCuller
+ *
+ *  This class runs the culling compute shader over a list
+ *  of draw packets and keeps the indirect command buffer
+ *  that it writes. The commands are only valid for drawing
+ *  with the instance values that the packets were built
+ *  for, and need OpenGL 4.3.
+ ***********************************************************/
+class GPUCuller
+{
+public:
+	// constructor
+	GPUCuller();
+	// destructor
+	~GPUCuller();
+
+	// culling values of one draw packet - the layout must match
+	// the packet buffer in the culling shader
+	struct CULL_PACKET
+	{
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		glm::vec4 center;
+		GLuint levelCounts[4];
+		GLuint levelFirstIndices[4];
+		GLint baseVertex;
+		GLuint baseInstance;
+		GLuint instanceCount;
+		GLint levelCount;
+	};
+
+	// true when the OpenGL context can run compute shaders
+	static bool IsSupported();
+	// true when the number of commands written can be read by
+	// the draw call from the counter buffer
+	static bool IsDrawCountSupported();
+
+	// compile the culling compute shader from a GLSL file -
+	// returns false when it cannot be used
+	bool LoadShader(const char* filename);
+
+	// replace the culled packets and reset their levels
+	void SetPackets(const std::vector<CULL_PACKET>& packets);
+	// cull the packets for a camera view and write the draw
+	// commands - the shader program in use is changed
+	void Dispatch(
+		const glm::vec4* frustumPlanes,
+		const glm::vec3& cameraPosition,
+		float projectionScale,
+		bool bPerspective);
+
+	// get the buffers of the last dispatch for drawing - the
+	// counter buffer is 0 when the draw cannot read it, and then
+	// the unused commands draw no instances
+	GLuint GetCommandBuffer() const { return m_commandBuffer; }
+	GLuint GetCounterBuffer() const;
+	// get the number of culled packets, which is the most
+	// commands that can be written
+	GLsizei GetPacketCount() const { return m_packetCount; }
+
+	// read back the number of commands written by the last
+	// dispatch - this waits for the GPU and is only for checks
+	GLuint ReadCommandCount() const;
+
+private:
+	// compiled and linked culling program
+	GLuint m_programID;
+	// packet values, draw commands, packet levels and the
+	// atomic command counter
+	GLuint m_packetBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_levelBuffer;
+	GLuint m_counterBuffer;
+	// number of packets in the packet buffer
+	GLsizei m_packetCount;
+
+	// uniform locations of the culling program
+	GLint m_packetCountLocation;
+	GLint m_frustumPlanesLocation;
+	GLint m_cameraPositionLocation;
+	GLint m_projectionScaleLocation;
+	GLint m_perspectiveLocation;
+	GLint m_levelSwitchSizesLocation;
+	GLint m_levelHysteresisLocation;
+};
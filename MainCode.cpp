@@ -1,5 +1,10 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <string>           // command line arguments
+#include <vector>           // headless camera poses
+#include <chrono>           // headless frame timing
+#include <cstdio>           // stress scene grid parsing
+#include <cstring>          // command line options
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,6 +18,14 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "GLStateCache.h"
+#include "OffscreenRenderer.h"
+#include "FrameCapture.h"
+#include "FrameProfiler.h"
+#include "FramePipeline.h"
+#include "CameraPath.h"
+#include "BenchmarkReport.h"
 
 // Namespace for declaring global variables
 namespace
@@ -23,18 +36,64 @@ namespace
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
 
+	// number of frames between the profile reports
+	const int PROFILE_REPORT_FRAMES = 240;
+
+	// longest time that the window waits for input while nothing
+	// changes, which also picks up the texture images decoded in
+	// the meantime
+	const double IDLE_WAIT_SECONDS = 0.1;
+
+	// fixed time step of the benchmark camera in seconds, the
+	// frames drawn before the measured ones, and the time that
+	// the built in orbit takes
+	const float BENCHMARK_TIMESTEP = 1.0f / 60.0f;
+	const int BENCHMARK_WARMUP_FRAMES = 30;
+	const float BENCHMARK_ORBIT_SECONDS = 20.0f;
+
+	// number of frames between the comparisons of the GPU culling
+	// against the CPU culling
+	const int CULLING_REPORT_FRAMES = 600;
+
+#ifdef _DEBUG
+	// number of frames between the state call reports
+	const int STATE_REPORT_FRAMES = 600;
+#endif
+
 	// scene manager object for managing the 3D scene prepare and render
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+
+	// grid of rooms that the desk room is tiled into, and the seed
+	// of their random changes
+	int g_StressColumns = 1;
+	int g_StressRows = 1;
+	unsigned int g_StressSeed = 1;
+
+	// cull the opaque packets with the culling shader in every mode,
+	// and compare its draws against the CPU culling now and then
+	bool g_bGPUCulling = false;
+	bool g_bCompareCulling = false;
+	// trace file that the frame profile is written into, or NULL
+	// when the frames are not profiled
+	const char* g_ProfileTrace = NULL;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+const char* GetOptionValue(int argc, char* argv[], const char* option);
+const char* GetOptionArgument(int argc, char* argv[], const char* option, int index, const char* defaultValue);
+bool HasOption(int argc, char* argv[], const char* option);
+OffscreenRenderer* CreateHeadlessScene();
+void RenderHeadlessFrame(OffscreenRenderer* pRenderer, const glm::vec3& position, const glm::vec3& front);
+void DestroyHeadlessScene(OffscreenRenderer* pRenderer);
+int RenderHeadless(const char* poseFilename, const char* outputFolder, const char* formatName);
+int RunBenchmark(const char* pathName, int frameCount, const char* resultFilename);
 
 
 /***********************************************************
@@ -45,6 +104,99 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// tile the desk room into a grid of randomized rooms, which
+	// works with every mode below, for example
+	//   --benchmark orbit 600 result.json --stress-scene 150x150 --seed 7
+	const char* stressGrid = GetOptionValue(argc, argv, "--stress-scene");
+	if (NULL != stressGrid)
+	{
+		if (sscanf(stressGrid, "%dx%d", &g_StressColumns, &g_StressRows) != 2)
+		{
+			std::cout << "The stress scene grid must look like 20x10:" << stressGrid << std::endl;
+			return(EXIT_FAILURE);
+		}
+		const char* seed = GetOptionValue(argc, argv, "--seed");
+		if (NULL != seed)
+		{
+			g_StressSeed = (unsigned int)strtoul(seed, NULL, 10);
+		}
+	}
+
+	// time the model matrix builders without opening a window
+	if ((argc > 1) && (std::string(argv[1]) == "--bench-transforms"))
+	{
+		SceneManager::BenchmarkModelMatrices(100000);
+		return(EXIT_SUCCESS);
+	}
+	// time the software occlusion culling, which needs no GPU
+	if ((argc > 1) && (std::string(argv[1]) == "--bench-occlusion"))
+	{
+		OcclusionCuller::Benchmark(10000);
+		return(EXIT_SUCCESS);
+	}
+	// time the object hierarchy builds and queries
+	if ((argc > 1) && (std::string(argv[1]) == "--bench-bvh"))
+	{
+		SceneBVH::Benchmark(1000);
+		SceneBVH::Benchmark(10000);
+		SceneBVH::Benchmark(100000);
+		return(EXIT_SUCCESS);
+	}
+
+	// cull the opaque packets with a compute shader, and report how
+	// many packets it draws next to the CPU frustum test - reading
+	// the counter back waits for the GPU, so frames get slower
+	g_bGPUCulling = HasOption(argc, argv, "--gpu-culling");
+	g_bCompareCulling = HasOption(argc, argv, "--compare-culling");
+	// time the zones of every frame, print their statistics and
+	// write them into a trace file on exit
+	g_ProfileTrace = GetOptionArgument(argc, argv, "--profile", 1, "profile.json");
+
+	// render a list of camera poses into image files without a
+	// display window, as fast as the GPU allows
+	if (HasOption(argc, argv, "--headless"))
+	{
+		return(RenderHeadless(
+			GetOptionArgument(argc, argv, "--headless", 1, "poses.txt"),
+			GetOptionArgument(argc, argv, "--headless", 2, "."),
+			GetOptionArgument(argc, argv, "--headless", 3, "tga")));
+	}
+
+	// replay a camera path at a fixed time step without a display
+	// window, and write the frame statistics as JSON
+	if (HasOption(argc, argv, "--benchmark"))
+	{
+		return(RunBenchmark(
+			GetOptionArgument(argc, argv, "--benchmark", 1, "orbit"),
+			atoi(GetOptionArgument(argc, argv, "--benchmark", 2, "600")),
+			GetOptionArgument(argc, argv, "--benchmark", 3, "benchmark.json")));
+	}
+	// check benchmark results against a baseline, failing when any
+	// metric grew by more than the tolerance
+	if ((argc > 1) && (std::string(argv[1]) == "--bench-compare"))
+	{
+		if (argc < 4)
+		{
+			std::cout << "Usage: --bench-compare baseline.json result.json [tolerance]" << std::endl;
+			return(EXIT_FAILURE);
+		}
+		int regressions = BenchmarkReport::CompareFiles(argv[2], argv[3], (argc > 4) ? atof(argv[4]) : 0.1);
+		return((regressions == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// write every displayed frame into an image file while the
+	// window keeps running
+	bool bCapture = HasOption(argc, argv, "--capture");
+	bool bProfile = (NULL != g_ProfileTrace);
+	// record the camera moves into a path file for benchmarks
+	bool bRecordPath = HasOption(argc, argv, "--record-path");
+	// prepare and draw every frame in turn on one thread, which
+	// works with every windowed mode
+	bool bSerialFrames = HasOption(argc, argv, "--serial-frames");
+	// draw every frame even when nothing changed, instead of
+	// waiting for input
+	bool bContinuous = HasOption(argc, argv, "--continuous");
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -68,18 +220,88 @@ int main(int argc, char* argv[])
 
 	// load the shader code from the external GLSL files
 	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+		"shaders/vertexShader.glsl",
+		"shaders/fragmentShader.glsl");
 	g_ShaderManager->use();
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetStressGrid(g_StressColumns, g_StressRows, g_StressSeed);
 	g_SceneManager->PrepareScene();
+	if (g_bGPUCulling)
+	{
+		g_SceneManager->SetGPUCulling(true);
+	}
+
+	FrameCapture* pCapture = NULL;
+	if (bCapture)
+	{
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+		pCapture = new FrameCapture(
+			framebufferWidth,
+			framebufferHeight,
+			GetOptionArgument(argc, argv, "--capture", 1, "."),
+			FrameCapture::FormatFromName(GetOptionArgument(argc, argv, "--capture", 2, "tga")));
+	}
+
+	FrameProfiler::SetEnabled(bProfile);
+	int profiledFrames = 0;
+
+	CameraPath recordedPath;
+	double recordStart = glfwGetTime();
+
+	// cull and sort the next frame on an update thread while this
+	// one is drawn and swapped - the culling shader runs on the
+	// rendering thread, so GPU culling keeps the frames in turn
+	FramePipeline* pPipeline = NULL;
+	if ((bSerialFrames == false) && g_SceneManager->CanPrepareFrames())
+	{
+		g_SceneManager->UpdateScene();
+		g_ViewManager->UpdateCameraView();
+		pPipeline = new FramePipeline(g_SceneManager);
+		pPipeline->RequestFrame(
+			g_ViewManager->GetViewMatrix(),
+			g_ViewManager->GetProjectionMatrix(),
+			g_ViewManager->GetCameraPosition());
+	}
+
+	// camera view of the last drawn frame, which starts out
+	// matching no camera so that the first frame is drawn
+	glm::mat4 drawnView(0.0f);
+	glm::mat4 drawnProjection(0.0f);
+	int renderedFrames = 0;
+	int skippedFrames = 0;
+
+#ifdef _DEBUG
+	int frameCount = 0;
+#endif
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		// move the camera with the input, and only draw a frame when
+		// the camera, the window or the scene changed since the last
+		// drawn one - otherwise sleep until the next input arrives
+		g_ViewManager->UpdateCameraView();
+		bool bWindowChanged = g_ViewManager->TakeWindowChanged();
+		bool bSceneChanged = g_SceneManager->HasSceneChanges();
+		if ((bContinuous == false) && (bWindowChanged == false) && (bSceneChanged == false) &&
+			(g_ViewManager->GetViewMatrix() == drawnView) &&
+			(g_ViewManager->GetProjectionMatrix() == drawnProjection))
+		{
+			skippedFrames++;
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+			continue;
+		}
+		renderedFrames++;
+
+		// count the state calls of this frame only
+		GLStateCache::ResetCounters();
+		FrameProfiler::BeginFrame();
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -87,18 +309,170 @@ int main(int argc, char* argv[])
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+		// take the frame that the update thread prepared, which it
+		// stays away from the scene after, so the textures and the
+		// compile can change the scene here - a compile renumbers
+		// the packets, so the frame is prepared again
+		SceneManager::FRAME_SNAPSHOT* pSnapshot = NULL;
+		if (NULL != pPipeline)
+		{
+			{
+				ProfileZone zone("WaitFrame");
+				pSnapshot = pPipeline->WaitFrame();
+			}
+			if (g_SceneManager->UpdateScene())
+			{
+				g_SceneManager->PrepareFrame(*pSnapshot);
+			}
+		}
+
+		// convert from 3D object space to 2D view - with the update
+		// thread, the view of the next frame is handed to it and the
+		// view of the prepared frame goes into the shader
+		{
+			ProfileZone zone("PrepareSceneView");
+			if (NULL != pSnapshot)
+			{
+				pPipeline->RequestFrame(
+					g_ViewManager->GetViewMatrix(),
+					g_ViewManager->GetProjectionMatrix(),
+					g_ViewManager->GetCameraPosition());
+				g_ViewManager->ApplyCameraView(pSnapshot->view, pSnapshot->projection, pSnapshot->cameraPosition);
+				drawnView = pSnapshot->view;
+				drawnProjection = pSnapshot->projection;
+			}
+			else
+			{
+				g_ViewManager->ApplyCameraView(
+					g_ViewManager->GetViewMatrix(),
+					g_ViewManager->GetProjectionMatrix(),
+					g_ViewManager->GetCameraPosition());
+				drawnView = g_ViewManager->GetViewMatrix();
+				drawnProjection = g_ViewManager->GetProjectionMatrix();
+			}
+		}
+		if (bRecordPath)
+		{
+			recordedPath.AddKeyframe(
+				(float)(glfwGetTime() - recordStart),
+				g_ViewManager->GetCameraPosition(),
+				g_ViewManager->GetCameraFront());
+		}
 
 		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+		if (NULL != pSnapshot)
+		{
+			ProfileZone zone("SubmitFrame");
+			g_SceneManager->SubmitFrame(*pSnapshot);
+		}
+		else
+		{
+			// pass the prepared camera view to the scene for sorting
+			g_SceneManager->SetCameraView(
+				g_ViewManager->GetViewMatrix(),
+				g_ViewManager->GetProjectionMatrix(),
+				g_ViewManager->GetCameraPosition());
+
+			ProfileZone zone("RenderScene");
+			g_SceneManager->RenderScene();
+		}
 
+#ifdef _DEBUG
+		// report how many state calls the state cache dropped
+		if ((frameCount++ % STATE_REPORT_FRAMES) == 0)
+		{
+			const GLStateCache::STATE_COUNTERS& counters = GLStateCache::GetCounters();
+			std::cout << "State calls per frame - uniforms sent:" << counters.submittedUniforms
+				<< " dropped:" << counters.filteredUniforms
+				<< ", textures sent:" << counters.submittedTextures
+				<< " dropped:" << counters.filteredTextures
+				<< ", vertex arrays sent:" << counters.submittedVertexArrays
+				<< " dropped:" << counters.filteredVertexArrays
+				<< ", draw calls:" << counters.drawCalls << std::endl;
+			// the scene counts belong to the update thread while it
+			// runs, so the counts of the drawn frame are used
+			SceneManager::FRAME_COUNTS counts;
+			if (NULL != pSnapshot)
+			{
+				counts = pSnapshot->counts;
+			}
+			else
+			{
+				g_SceneManager->GetFrameCounts(counts);
+			}
+			std::cout << "Scene objects visible:" << counts.visibleObjects
+				<< " culled:" << counts.culledObjects
+				<< " occluded:" << counts.occludedObjects
+				<< ", draws saved by occlusion:" << counts.occludedDraws << std::endl;
+			std::cout << "Curved shape indices drawn:" << counts.levelIndices
+				<< " at full detail:" << counts.fullDetailIndices << std::endl;
+			std::cout << "Multi-draw calls:" << g_SceneManager->GetIndirectDrawCallCount()
+				<< " drawing commands:" << g_SceneManager->GetIndirectCommandCount() << std::endl;
+		}
+#endif
+		if (g_bCompareCulling && ((renderedFrames % CULLING_REPORT_FRAMES) == 1))
+		{
+			g_SceneManager->CompareGPUCulling();
+		}
+
+		// read the back buffer before it is swapped, at the size
+		// that the resized window has now
+		if (NULL != pCapture)
+		{
+			ProfileZone zone("CaptureFrame");
+			if (bWindowChanged)
+			{
+				int framebufferWidth = 0;
+				int framebufferHeight = 0;
+				glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+				pCapture->Resize(framebufferWidth, framebufferHeight);
+			}
+			pCapture->CaptureFrame();
+		}
 
 		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		{
+			ProfileZone zone("SwapBuffers");
+			glfwSwapBuffers(g_Window);
+		}
 
 		// query the latest GLFW events
 		glfwPollEvents();
+
+		FrameProfiler::EndFrame();
+		if (bProfile && ((++profiledFrames % PROFILE_REPORT_FRAMES) == 0))
+		{
+			FrameProfiler::PrintReport();
+		}
+	}
+
+	std::cout << "Frames rendered:" << renderedFrames << " skipped while idle:" << skippedFrames << std::endl;
+
+	// stop the update thread before the scene goes away
+	if (NULL != pPipeline)
+	{
+		delete pPipeline;
+		pPipeline = NULL;
+	}
+
+	if (bProfile)
+	{
+		FrameProfiler::PrintReport();
+		FrameProfiler::WriteTrace(g_ProfileTrace);
+	}
+	FrameProfiler::Shutdown();
+
+	if (bRecordPath)
+	{
+		recordedPath.Save(GetOptionArgument(argc, argv, "--record-path", 1, "camera_path.txt"));
+	}
+
+	// the last captured frames are read back while the context
+	// still exists
+	if (NULL != pCapture)
+	{
+		delete pCapture;
+		pCapture = NULL;
 	}
 
 	// clear the allocated manager objects from memory
@@ -117,6 +491,8 @@ int main(int argc, char* argv[])
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+	// clear the cached uniform locations
+	UniformCache::DestroyAll();
 
 	// Terminates the program successfully
 	exit(EXIT_SUCCESS); 
@@ -162,6 +538,14 @@ bool InitializeGLEW()
 
 	// try to initialize the GLEW library
 	GLEWInitResult = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// a headless EGL context has no GLX display, which GLEW
+	// reports after the OpenGL functions are already loaded
+	if (GLEW_ERROR_NO_GLX_DISPLAY == GLEWInitResult)
+	{
+		GLEWInitResult = GLEW_OK;
+	}
+#endif
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
@@ -174,4 +558,295 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *	GetOptionValue()
+ *
+ *  This function is used to find an option anywhere on the
+ *  command line, and to get the value after it. Returns NULL
+ *  when the option is not given.
+ ***********************************************************/
+const char* GetOptionValue(int argc, char* argv[], const char* option)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], option) == 0)
+		{
+			return(argv[i + 1]);
+		}
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *	GetOptionArgument()
+ *
+ *  This function is used to find an option anywhere on the
+ *  command line, and to get the argument at a position after
+ *  it, or the default value when it is not given. Returns
+ *  NULL when the option is not given.
+ ***********************************************************/
+const char* GetOptionArgument(int argc, char* argv[], const char* option, int index, const char* defaultValue)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], option) != 0)
+		{
+			continue;
+		}
+
+		// the arguments end at the next option
+		for (int j = 1; j <= index; j++)
+		{
+			if ((i + j >= argc) || (strncmp(argv[i + j], "--", 2) == 0))
+			{
+				return(defaultValue);
+			}
+		}
+		return(argv[i + index]);
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *	HasOption()
+ *
+ *  This function is used to find an option without a value
+ *  anywhere on the command line.
+ ***********************************************************/
+bool HasOption(int argc, char* argv[], const char* option)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], option) == 0)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *	CreateHeadlessScene()
+ *
+ *  This function is used to create the surfaceless OpenGL
+ *  context and the manager objects, and to prepare the 3D
+ *  scene with all of its textures loaded. Returns NULL when
+ *  no headless context can be created.
+ ***********************************************************/
+OffscreenRenderer* CreateHeadlessScene()
+{
+	// the context is made current before anything calls OpenGL
+	OffscreenRenderer* pRenderer = new OffscreenRenderer();
+	if ((pRenderer->CreateContext() == false) ||
+		(InitializeGLEW() == false) ||
+		(pRenderer->CreateFramebuffer(ViewManager::GetDisplayWidth(), ViewManager::GetDisplayHeight()) == false))
+	{
+		delete pRenderer;
+		return(NULL);
+	}
+
+	g_ShaderManager = new ShaderManager();
+	g_ViewManager = new ViewManager(
+		g_ShaderManager);
+	g_ViewManager->UseOffscreenView();
+
+	g_ShaderManager->LoadShaders(
+		"shaders/vertexShader.glsl",
+		"shaders/fragmentShader.glsl");
+	g_ShaderManager->use();
+
+	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetStressGrid(g_StressColumns, g_StressRows, g_StressSeed);
+	g_SceneManager->PrepareScene();
+	if (g_bGPUCulling)
+	{
+		g_SceneManager->SetGPUCulling(true);
+	}
+	// every headless frame shows the loaded textures
+	g_SceneManager->WaitForTextures();
+
+	FrameProfiler::SetEnabled(NULL != g_ProfileTrace);
+
+	return(pRenderer);
+}
+
+/***********************************************************
+ *	RenderHeadlessFrame()
+ *
+ *  This function is used to draw the 3D scene from a camera
+ *  pose into the headless framebuffer.
+ ***********************************************************/
+void RenderHeadlessFrame(OffscreenRenderer* pRenderer, const glm::vec3& position, const glm::vec3& front)
+{
+	pRenderer->BindFramebuffer();
+
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	g_ViewManager->SetCameraPose(position, front);
+	g_ViewManager->PrepareSceneView();
+	g_SceneManager->SetCameraView(
+		g_ViewManager->GetViewMatrix(),
+		g_ViewManager->GetProjectionMatrix(),
+		g_ViewManager->GetCameraPosition());
+	g_SceneManager->RenderScene();
+}
+
+/***********************************************************
+ *	DestroyHeadlessScene()
+ *
+ *  This function is used to free the manager objects and
+ *  then the headless OpenGL context.
+ ***********************************************************/
+void DestroyHeadlessScene(OffscreenRenderer* pRenderer)
+{
+	// the profile queries are read while the context exists
+	if (NULL != g_ProfileTrace)
+	{
+		FrameProfiler::PrintReport();
+		FrameProfiler::WriteTrace(g_ProfileTrace);
+	}
+	FrameProfiler::Shutdown();
+
+	delete g_SceneManager;
+	g_SceneManager = NULL;
+	delete g_ViewManager;
+	g_ViewManager = NULL;
+	delete g_ShaderManager;
+	g_ShaderManager = NULL;
+	UniformCache::DestroyAll();
+	// the context goes last, after every OpenGL object is freed
+	delete pRenderer;
+}
+
+/***********************************************************
+ *	RenderHeadless()
+ *
+ *  This function is used to render the 3D scene from every
+ *  camera pose in a file into TGA or PNG images in an output
+ *  folder, without opening a display window. The frames are
+ *  never swapped, so nothing holds them to a refresh rate,
+ *  and each one is read back while the next ones render.
+ ***********************************************************/
+int RenderHeadless(const char* poseFilename, const char* outputFolder, const char* formatName)
+{
+	std::vector<OffscreenRenderer::CAMERA_POSE> poses;
+
+	if (OffscreenRenderer::LoadCameraPoses(poseFilename, poses) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	OffscreenRenderer* pRenderer = CreateHeadlessScene();
+	if (NULL == pRenderer)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	FrameCapture* pCapture = new FrameCapture(
+		ViewManager::GetDisplayWidth(),
+		ViewManager::GetDisplayHeight(),
+		outputFolder,
+		FrameCapture::FormatFromName(formatName));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < poses.size(); i++)
+	{
+		FrameProfiler::BeginFrame();
+		RenderHeadlessFrame(pRenderer, poses[i].position, poses[i].front);
+		pCapture->CaptureFrame();
+		FrameProfiler::EndFrame();
+	}
+	// the time includes writing the last frames
+	pCapture->Finish();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << poses.size() << " frames in " << seconds << "s, "
+		<< (poses.size() / seconds) << " frames per second, "
+		<< pCapture->GetStallCount() << " readback stalls" << std::endl;
+
+	delete pCapture;
+	DestroyHeadlessScene(pRenderer);
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	RunBenchmark()
+ *
+ *  This function is used to replay a camera path through the
+ *  3D scene in a headless context, one fixed time step per
+ *  frame, and to write the frame statistics into a JSON
+ *  file. Every run draws the same frames, so the results of
+ *  runs on the same machine can be compared. The path name
+ *  "orbit" circles the desk without any path file.
+ ***********************************************************/
+int RunBenchmark(const char* pathName, int frameCount, const char* resultFilename)
+{
+	CameraPath path;
+
+	if (std::string(pathName) == "orbit")
+	{
+		path.MakeOrbit(glm::vec3(0.0f, 1.0f, 0.0f), 12.0f, 4.0f, BENCHMARK_ORBIT_SECONDS);
+	}
+	else if (path.Load(pathName) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	OffscreenRenderer* pRenderer = CreateHeadlessScene();
+	if (NULL == pRenderer)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	BenchmarkReport report;
+
+	// the warm up frames draw the first pose, so that the driver
+	// has compiled everything before the measured frames
+	for (int i = -BENCHMARK_WARMUP_FRAMES; i < frameCount; i++)
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		path.Sample((i > 0) ? i * BENCHMARK_TIMESTEP : 0.0f, position, front);
+
+		GLStateCache::ResetCounters();
+		FrameProfiler::BeginFrame();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		RenderHeadlessFrame(pRenderer, position, front);
+		// nothing is swapped, so the frame is only done when the
+		// GPU has finished drawing it
+		glFinish();
+
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		FrameProfiler::EndFrame();
+		if (g_bCompareCulling && ((i % CULLING_REPORT_FRAMES) == 0))
+		{
+			g_SceneManager->CompareGPUCulling();
+		}
+		if (i >= 0)
+		{
+			const GLStateCache::STATE_COUNTERS& counters = GLStateCache::GetCounters();
+			report.AddFrame(milliseconds, counters.drawCalls, counters.submittedUniforms);
+		}
+	}
+
+	report.Print();
+	bool bWritten = report.WriteJSON(
+		resultFilename,
+		pathName,
+		BENCHMARK_TIMESTEP,
+		(const char*)glGetString(GL_RENDERER));
+
+	DestroyHeadlessScene(pRenderer);
+
+	return(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,653 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ============
+// rasterize large occluders on the CPU and test bounding boxes behind them
+//
+//	The occluders are drawn into a small depth buffer by a software
+//	rasterizer that fills four pixels at a time with SSE. The rows of tiles
+//	are shared out to a pool of worker threads, and every tile keeps the
+//	farthest depth of its pixels so that most boxes are rejected with a
+//	few tile tests instead of reading single pixels.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define OCCLUSION_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// size of the depth buffer - the width must be a multiple
+	// of four and both must be multiples of the tile size
+	const int g_DepthWidth = 256;
+	const int g_DepthHeight = 144;
+	const int g_TileSize = 8;
+	const int g_TilesX = g_DepthWidth / g_TileSize;
+	const int g_TilesY = g_DepthHeight / g_TileSize;
+	// most threads used when the count is not passed in,
+	// counting the calling thread
+	const int g_MaxDefaultThreads = 4;
+
+	// corners of the unit box around the origin, where bit 0
+	// of the index picks x, bit 1 picks y and bit 2 picks z
+	const float g_BoxCorners[8][3] =
+	{
+		{ -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f },
+		{ -0.5f,  0.5f, -0.5f }, { 0.5f,  0.5f, -0.5f },
+		{ -0.5f, -0.5f,  0.5f }, { 0.5f, -0.5f,  0.5f },
+		{ -0.5f,  0.5f,  0.5f }, { 0.5f,  0.5f,  0.5f }
+	};
+	// two triangles for each of the six box faces
+	const int g_BoxTriangles[12][3] =
+	{
+		{ 0, 2, 6 }, { 0, 6, 4 },
+		{ 1, 5, 7 }, { 1, 7, 3 },
+		{ 0, 4, 5 }, { 0, 5, 1 },
+		{ 2, 3, 7 }, { 2, 7, 6 },
+		{ 0, 1, 3 }, { 0, 3, 2 },
+		{ 4, 6, 7 }, { 4, 7, 5 }
+	};
+
+	/***********************************************************
+	 *  ClipToScreen()
+	 *
+	 *  This helper function is used for converting a clip-space
+	 *  position into depth buffer pixels and a depth between 0
+	 *  and 1.
+	 ***********************************************************/
+	glm::vec3 ClipToScreen(const glm::vec4& clip)
+	{
+		float inverseW = 1.0f / clip.w;
+
+		return(glm::vec3(
+			(clip.x * inverseW * 0.5f + 0.5f) * g_DepthWidth,
+			(clip.y * inverseW * 0.5f + 0.5f) * g_DepthHeight,
+			clip.z * inverseW * 0.5f + 0.5f));
+	}
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller(int workerCount)
+{
+	m_viewProjection = glm::mat4(1.0f);
+	m_depth.assign(g_DepthWidth * g_DepthHeight, 1.0f);
+	m_tileDepth.assign(g_TilesX * g_TilesY, 1.0f);
+	m_frameNumber = 0;
+	m_busyWorkers = 0;
+	m_nextTileRow = 0;
+	m_bStopping = false;
+
+	if (workerCount <= 0)
+	{
+		int threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount > g_MaxDefaultThreads)
+		{
+			threadCount = g_MaxDefaultThreads;
+		}
+		workerCount = threadCount - 1;
+	}
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&OcclusionCuller::RasterizeFrames, this));
+	}
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_frameReady.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame with the
+ *  camera view projection. The occluders of the last frame
+ *  are removed.
+ ***********************************************************/
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	m_triangles.clear();
+}
+
+/***********************************************************
+ *  AddBoxOccluder()
+ *
+ *  This method is used for adding the twelve triangles of a
+ *  transformed unit box as occluders.
+ ***********************************************************/
+void OcclusionCuller::AddBoxOccluder(const glm::mat4& model)
+{
+	glm::mat4 modelViewProjection = m_viewProjection * model;
+	glm::vec4 clipCorners[8];
+
+	for (int i = 0; i < 8; i++)
+	{
+		clipCorners[i] = modelViewProjection *
+			glm::vec4(g_BoxCorners[i][0], g_BoxCorners[i][1], g_BoxCorners[i][2], 1.0f);
+	}
+
+	for (int i = 0; i < 12; i++)
+	{
+		AddTriangle(
+			clipCorners[g_BoxTriangles[i][0]],
+			clipCorners[g_BoxTriangles[i][1]],
+			clipCorners[g_BoxTriangles[i][2]]);
+	}
+}
+
+/***********************************************************
+ *  AddTriangle()
+ *
+ *  This method is used for clipping a clip-space triangle
+ *  against the near plane. The part in front of the camera
+ *  is at most a quad, which is added as two triangles.
+ ***********************************************************/
+void OcclusionCuller::AddTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2)
+{
+	const glm::vec4* input[3] = { &clip0, &clip1, &clip2 };
+	glm::vec4 clipped[4];
+	int clippedCount = 0;
+
+	// a point is in front of the near plane when z + w >= 0
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4& current = *input[i];
+		const glm::vec4& next = *input[(i + 1) % 3];
+		float currentDistance = current.z + current.w;
+		float nextDistance = next.z + next.w;
+
+		if (currentDistance >= 0.0f)
+		{
+			clipped[clippedCount++] = current;
+		}
+		if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+		{
+			float t = currentDistance / (currentDistance - nextDistance);
+			clipped[clippedCount++] = current + (next - current) * t;
+		}
+	}
+
+	if (clippedCount < 3)
+	{
+		return;
+	}
+
+	glm::vec3 screen[4];
+	for (int i = 0; i < clippedCount; i++)
+	{
+		if (clipped[i].w <= 0.0f)
+		{
+			return;
+		}
+		screen[i] = ClipToScreen(clipped[i]);
+	}
+
+	SetupTriangle(screen[0], screen[1], screen[2]);
+	if (clippedCount == 4)
+	{
+		SetupTriangle(screen[0], screen[2], screen[3]);
+	}
+}
+
+/***********************************************************
+ *  SetupTriangle()
+ *
+ *  This method is used for computing the pixel bounds, the
+ *  edge equations and the depth plane of a screen-space
+ *  triangle. Triangles are turned around as needed, so the
+ *  edge values are never negative inside of any of them.
+ ***********************************************************/
+void OcclusionCuller::SetupTriangle(const glm::vec3& screen0, const glm::vec3& screen1, const glm::vec3& screen2)
+{
+	glm::vec3 vertices[3] = { screen0, screen1, screen2 };
+	float area = (vertices[1].x - vertices[0].x) * (vertices[2].y - vertices[0].y) -
+		(vertices[2].x - vertices[0].x) * (vertices[1].y - vertices[0].y);
+
+	if (area < 0.0f)
+	{
+		vertices[1] = screen2;
+		vertices[2] = screen1;
+		area = -area;
+	}
+	if (area < 1e-6f)
+	{
+		return;
+	}
+
+	SCREEN_TRIANGLE triangle;
+	float minX = glm::min(vertices[0].x, glm::min(vertices[1].x, vertices[2].x));
+	float maxX = glm::max(vertices[0].x, glm::max(vertices[1].x, vertices[2].x));
+	float minY = glm::min(vertices[0].y, glm::min(vertices[1].y, vertices[2].y));
+	float maxY = glm::max(vertices[0].y, glm::max(vertices[1].y, vertices[2].y));
+
+	if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= g_DepthWidth) || (minY >= g_DepthHeight))
+	{
+		return;
+	}
+
+	triangle.minX = glm::max(0, (int)std::floor(minX));
+	triangle.maxX = glm::min(g_DepthWidth - 1, (int)std::floor(maxX));
+	triangle.minY = glm::max(0, (int)std::floor(minY));
+	triangle.maxY = glm::min(g_DepthHeight - 1, (int)std::floor(maxY));
+
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& start = vertices[i];
+		const glm::vec3& end = vertices[(i + 1) % 3];
+
+		triangle.edgeA[i] = start.y - end.y;
+		triangle.edgeB[i] = end.x - start.x;
+		triangle.edgeC[i] = -(triangle.edgeA[i] * start.x + triangle.edgeB[i] * start.y);
+	}
+
+	float depth1 = vertices[1].z - vertices[0].z;
+	float depth2 = vertices[2].z - vertices[0].z;
+	triangle.depthA = (depth1 * (vertices[2].y - vertices[0].y) - depth2 * (vertices[1].y - vertices[0].y)) / area;
+	triangle.depthB = (depth2 * (vertices[1].x - vertices[0].x) - depth1 * (vertices[2].x - vertices[0].x)) / area;
+	triangle.depthC = vertices[0].z - triangle.depthA * vertices[0].x - triangle.depthB * vertices[0].y;
+
+	m_triangles.push_back(triangle);
+}
+
+/***********************************************************
+ *  RenderOccluders()
+ *
+ *  This method is used for rasterizing the occluders of the
+ *  frame. The calling thread takes rows of tiles next to the
+ *  workers, and returns when all the rows are done.
+ ***********************************************************/
+void OcclusionCuller::RenderOccluders()
+{
+	m_nextTileRow = 0;
+
+	if (m_workers.empty())
+	{
+		RenderTileRows();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_busyWorkers = (int)m_workers.size();
+		m_frameNumber++;
+	}
+	m_frameReady.notify_all();
+
+	RenderTileRows();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_busyWorkers > 0)
+	{
+		m_frameDone.wait(lock);
+	}
+}
+
+/***********************************************************
+ *  RasterizeFrames()
+ *
+ *  This method is used by every worker thread for helping to
+ *  rasterize each new frame until the culler is destroyed.
+ ***********************************************************/
+void OcclusionCuller::RasterizeFrames()
+{
+	int lastFrame = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ((m_frameNumber == lastFrame) && (m_bStopping == false))
+			{
+				m_frameReady.wait(lock);
+			}
+			if (m_bStopping)
+			{
+				return;
+			}
+			lastFrame = m_frameNumber;
+		}
+
+		RenderTileRows();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+		}
+		m_frameDone.notify_one();
+	}
+}
+
+/***********************************************************
+ *  RenderTileRows()
+ *
+ *  This method is used for taking rows of tiles that no
+ *  other thread has taken, and rasterizing them.
+ ***********************************************************/
+void OcclusionCuller::RenderTileRows()
+{
+	int tileRow = m_nextTileRow++;
+
+	while (tileRow < g_TilesY)
+	{
+		RenderTileRow(tileRow);
+		tileRow = m_nextTileRow++;
+	}
+}
+
+/***********************************************************
+ *  RenderTileRow()
+ *
+ *  This method is used for clearing one row of tiles and
+ *  rasterizing every occluder triangle that touches it, and
+ *  for storing the farthest depth of each of its tiles. With
+ *  SSE, the edges and depth of four pixels are evaluated at
+ *  the same time.
+ ***********************************************************/
+void OcclusionCuller::RenderTileRow(int tileRow)
+{
+	int rowStart = tileRow * g_TileSize;
+	int rowEnd = rowStart + g_TileSize - 1;
+
+	std::fill(m_depth.begin() + rowStart * g_DepthWidth, m_depth.begin() + (rowEnd + 1) * g_DepthWidth, 1.0f);
+
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		const SCREEN_TRIANGLE& triangle = m_triangles[i];
+		int startY = glm::max(triangle.minY, rowStart);
+		int endY = glm::min(triangle.maxY, rowEnd);
+
+		for (int y = startY; y <= endY; y++)
+		{
+			float centerY = y + 0.5f;
+			float* pRow = &m_depth[y * g_DepthWidth];
+
+#ifdef OCCLUSION_CULLER_SSE
+			__m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+			__m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+			__m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+			__m128 rowDepth = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+			__m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+			__m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+			__m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+			__m128 depthA = _mm_set1_ps(triangle.depthA);
+			__m128 zero = _mm_setzero_ps();
+
+			// the groups of four start on a multiple of four, so a
+			// group never reaches past the end of a row
+			for (int x = triangle.minX & ~3; x <= triangle.maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+				__m128 inside = _mm_and_ps(
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, centerX), rowEdge0), zero),
+					_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, centerX), rowEdge1), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, centerX), rowEdge2), zero)));
+
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+				__m128 current = _mm_loadu_ps(pRow + x);
+				__m128 nearer = _mm_min_ps(current, depth);
+				_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+			}
+#else
+			for (int x = triangle.minX; x <= triangle.maxX; x++)
+			{
+				float centerX = x + 0.5f;
+				bool bInside = true;
+				for (int edge = 0; edge < 3; edge++)
+				{
+					if (triangle.edgeA[edge] * centerX + triangle.edgeB[edge] * centerY + triangle.edgeC[edge] < 0.0f)
+					{
+						bInside = false;
+					}
+				}
+
+				if (bInside)
+				{
+					float depth = triangle.depthA * centerX + triangle.depthB * centerY + triangle.depthC;
+					pRow[x] = glm::min(pRow[x], depth);
+				}
+			}
+#endif
+		}
+	}
+
+	// keep the farthest depth of every tile in the row
+	for (int tileX = 0; tileX < g_TilesX; tileX++)
+	{
+		float farthest = 0.0f;
+		for (int y = rowStart; y <= rowEnd; y++)
+		{
+			const float* pTile = &m_depth[y * g_DepthWidth + tileX * g_TileSize];
+			for (int x = 0; x < g_TileSize; x++)
+			{
+				farthest = glm::max(farthest, pTile[x]);
+			}
+		}
+		m_tileDepth[tileRow * g_TilesX + tileX] = farthest;
+	}
+}
+
+/***********************************************************
+ *  TestBox()
+ *
+ *  This method is used for testing a world-space box against
+ *  the rasterized occluders. The screen rectangle and the
+ *  nearest depth of the box are compared with the farthest
+ *  depth of each tile first, and single pixels are only read
+ *  in the tiles that do not hide the box. The occluders only
+ *  fill the pixels whose centers they cover, so the rectangle
+ *  is grown by one pixel on every side - a box that shows
+ *  past the edge of an occluder then reaches a pixel that
+ *  the occluder left empty. Boxes that cross the near plane
+ *  are always visible.
+ ***********************************************************/
+bool OcclusionCuller::TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	float minX = (float)g_DepthWidth;
+	float maxX = 0.0f;
+	float minY = (float)g_DepthHeight;
+	float maxY = 0.0f;
+	float nearestDepth = 1.0f;
+
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner(
+			(i & 1) ? boxMax.x : boxMin.x,
+			(i & 2) ? boxMax.y : boxMin.y,
+			(i & 4) ? boxMax.z : boxMin.z,
+			1.0f);
+		glm::vec4 clip = m_viewProjection * corner;
+
+		if ((clip.w <= 0.0f) || (clip.z + clip.w < 0.0f))
+		{
+			return(true);
+		}
+
+		glm::vec3 screen = ClipToScreen(clip);
+		minX = glm::min(minX, screen.x);
+		maxX = glm::max(maxX, screen.x);
+		minY = glm::min(minY, screen.y);
+		maxY = glm::max(maxY, screen.y);
+		nearestDepth = glm::min(nearestDepth, screen.z);
+	}
+
+	// boxes off the screen are left to the frustum test
+	if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= g_DepthWidth) || (minY >= g_DepthHeight))
+	{
+		return(true);
+	}
+
+	int startX = glm::max(0, (int)std::floor(minX) - 1);
+	int endX = glm::min(g_DepthWidth - 1, (int)std::floor(maxX) + 1);
+	int startY = glm::max(0, (int)std::floor(minY) - 1);
+	int endY = glm::min(g_DepthHeight - 1, (int)std::floor(maxY) + 1);
+
+	for (int tileY = startY / g_TileSize; tileY <= endY / g_TileSize; tileY++)
+	{
+		for (int tileX = startX / g_TileSize; tileX <= endX / g_TileSize; tileX++)
+		{
+			if (m_tileDepth[tileY * g_TilesX + tileX] < nearestDepth)
+			{
+				continue;
+			}
+
+			// the tile is not completely in front of the box, so
+			// look at the pixels that the box covers in it
+			int pixelStartX = glm::max(startX, tileX * g_TileSize);
+			int pixelEndX = glm::min(endX, tileX * g_TileSize + g_TileSize - 1);
+			int pixelStartY = glm::max(startY, tileY * g_TileSize);
+			int pixelEndY = glm::min(endY, tileY * g_TileSize + g_TileSize - 1);
+
+			for (int y = pixelStartY; y <= pixelEndY; y++)
+			{
+				const float* pRow = &m_depth[y * g_DepthWidth];
+				int x = pixelStartX;
+
+#ifdef OCCLUSION_CULLER_SSE
+				__m128 boxDepth = _mm_set1_ps(nearestDepth);
+				for (; x + 3 <= pixelEndX; x += 4)
+				{
+					if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + x), boxDepth)) != 0)
+					{
+						return(true);
+					}
+				}
+#endif
+				for (; x <= pixelEndX; x++)
+				{
+					if (pRow[x] >= nearestDepth)
+					{
+						return(true);
+					}
+				}
+			}
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  Benchmark()
+ *
+ *  This method is used for timing the occluder rasterizing
+ *  and the box tests from the starting camera position, with
+ *  the walls and desk top of the room as the occluders. Half
+ *  of the boxes are placed behind the back wall, where all
+ *  of them should be hidden, and the other half inside of
+ *  the room. The results are written to the console.
+ ***********************************************************/
+void OcclusionCuller::Benchmark(int boxCount)
+{
+	const int frameCount = 100;
+	OcclusionCuller culler;
+	glm::mat4 view = glm::lookAt(
+		glm::vec3(0.0f, 5.0f, 12.0f),
+		glm::vec3(0.0f, 5.0f, 12.0f) + glm::vec3(0.0f, -0.5f, -2.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(80.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+	// the same sizes and positions as in DefineSceneObjects()
+	std::vector<glm::mat4> occluders;
+	occluders.push_back(glm::translate(glm::vec3(0.0f, 3.0f, 0.0f)) * glm::scale(glm::vec3(16.0f, 0.4f, 8.0f)));
+	occluders.push_back(glm::translate(glm::vec3(0.0f, 10.0f, -15.0f)) * glm::scale(glm::vec3(50.0f, 20.0f, 0.3f)));
+	occluders.push_back(glm::translate(glm::vec3(-25.0f, 10.0f, 0.0f)) * glm::scale(glm::vec3(0.3f, 20.0f, 30.0f)));
+	occluders.push_back(glm::translate(glm::vec3(25.0f, 10.0f, 0.0f)) * glm::scale(glm::vec3(0.3f, 20.0f, 30.0f)));
+
+	std::vector<glm::vec3> boundsMin(boxCount);
+	std::vector<glm::vec3> boundsMax(boxCount);
+	unsigned int seed = 777;
+	for (int i = 0; i < boxCount; i++)
+	{
+		float values[3];
+		for (int j = 0; j < 3; j++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			values[j] = (float)(seed >> 8) / (float)(1 << 24);
+		}
+
+		glm::vec3 center;
+		if (i % 2 == 0)
+		{
+			center = glm::vec3(values[0] * 40.0f - 20.0f, values[1] * 18.0f + 1.0f, -16.0f - values[2] * 20.0f);
+		}
+		else
+		{
+			center = glm::vec3(values[0] * 40.0f - 20.0f, values[1] * 18.0f + 1.0f, values[2] * 24.0f - 14.0f);
+		}
+		boundsMin[i] = center - glm::vec3(0.5f, 0.5f, 0.5f);
+		boundsMax[i] = center + glm::vec3(0.5f, 0.5f, 0.5f);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		culler.BeginFrame(projection * view);
+		for (size_t i = 0; i < occluders.size(); i++)
+		{
+			culler.AddBoxOccluder(occluders[i]);
+		}
+		culler.RenderOccluders();
+	}
+	double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frameCount;
+
+	int hiddenBehind = 0;
+	int hiddenInside = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < boxCount; i++)
+	{
+		if (culler.TestBox(boundsMin[i], boundsMax[i]) == false)
+		{
+			if (i % 2 == 0)
+			{
+				hiddenBehind++;
+			}
+			else
+			{
+				hiddenInside++;
+			}
+		}
+	}
+	double testMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Occlusion culling with " << culler.GetTriangleCount() << " occluder triangles on "
+		<< (culler.m_workers.size() + 1) << " threads - rasterize:" << renderMs << "ms, "
+		<< boxCount << " box tests:" << testMs << "ms, hidden behind the back wall:" << hiddenBehind
+		<< " of " << (boxCount + 1) / 2 << ", hidden inside of the room:" << hiddenInside
+		<< " of " << boxCount / 2 << std::endl;
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// ============
+// rasterize large occluders on the CPU and test bounding boxes behind them
+//
+//	The occluders are drawn into a small depth buffer by a software
+//	rasterizer that fills four pixels at a time with SSE. The rows of tiles
+//	are shared out to a pool of worker threads, and every tile keeps the
+//	farthest depth of its pixels so that most boxes are rejected with a
+//	few tile tests instead of reading single pixels.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class renders the boxes of the selected occluders
+ *  into a hierarchical depth buffer and tests world-space
+ *  bounding boxes against it. A box is only reported as
+ *  hidden when every pixel that it touches, and every pixel
+ *  next to those, holds a nearer occluder depth. Nothing
+ *  here calls into OpenGL.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// constructor - a worker count of 0 uses one worker per
+	// hardware thread, up to four, next to the calling thread
+	OcclusionCuller(int workerCount = 0);
+	// destructor
+	~OcclusionCuller();
+
+	// start a new frame with the camera view projection and
+	// remove the occluders of the last frame
+	void BeginFrame(const glm::mat4& viewProjection);
+	// add the box mesh of a scene object as an occluder - the
+	// model matrix transforms the unit box around the origin
+	void AddBoxOccluder(const glm::mat4& model);
+	// rasterize the added occluders into the depth buffer
+	void RenderOccluders();
+
+	// test a world-space box against the occluders - returns
+	// false when the box is completely hidden
+	bool TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// get the number of occluder triangles of the frame
+	int GetTriangleCount() const { return (int)m_triangles.size(); }
+
+	// time the rasterizer and the box tests with the walls and
+	// desk of the room and the passed in number of boxes
+	static void Benchmark(int boxCount);
+
+private:
+	// a screen-space triangle set up for rasterizing - the edge
+	// values are not negative inside, and the depth is a plane
+	struct SCREEN_TRIANGLE
+	{
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+	};
+
+	// camera view projection of the frame
+	glm::mat4 m_viewProjection;
+	// occluder triangles of the frame
+	std::vector<SCREEN_TRIANGLE> m_triangles;
+	// depth of every pixel, between 0 at the near plane and 1
+	// at the far plane or where no occluder was drawn
+	std::vector<float> m_depth;
+	// farthest depth of every tile of pixels
+	std::vector<float> m_tileDepth;
+
+	// rasterizing worker threads
+	std::vector<std::thread> m_workers;
+	// guards the frame number, the busy count and the stop flag
+	std::mutex m_mutex;
+	// signalled when a frame is ready or the workers must stop
+	std::condition_variable m_frameReady;
+	// signalled when a worker has finished its part of a frame
+	std::condition_variable m_frameDone;
+	// number of the frame that the workers are rasterizing
+	int m_frameNumber;
+	// number of workers still rasterizing the frame
+	int m_busyWorkers;
+	// next row of tiles that no thread has taken yet
+	std::atomic<int> m_nextTileRow;
+	// true when the workers must stop
+	bool m_bStopping;
+
+	// clip a triangle against the near plane and add the parts
+	void AddTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2);
+	// set up a screen-space triangle for rasterizing
+	void SetupTriangle(const glm::vec3& screen0, const glm::vec3& screen1, const glm::vec3& screen2);
+	// rasterize rows of tiles until none are left
+	void RenderTileRows();
+	// rasterize one row of tiles and update its tile depths
+	void RenderTileRow(int tileRow);
+	// wait for frames and help rasterizing them until stopping
+	void RasterizeFrames();
+};
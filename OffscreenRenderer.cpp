@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// offscreenrenderer.cpp
+// ============
+// render the 3D scene without a display, for batch jobs on servers
+//
+//	The surfaceless EGL platform is tried first, since it needs neither a
+//	display server nor a GPU device, and Mesa renders on it in software
+//	when no GPU is present.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OffscreenRenderer.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define OFFSCREEN_RENDERER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// declaration of global variables and defines
+namespace
+{
+	// the OpenGL versions tried for the context, newest first -
+	// the first one matches the version of the display window
+	const int g_ContextVersions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 3 }, { 3, 3 } };
+	const int g_ContextVersionCount = 4;
+}
+
+/***********************************************************
+ *  OffscreenRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OffscreenRenderer::OffscreenRenderer()
+{
+	m_display = NULL;
+	m_context = NULL;
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~OffscreenRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OffscreenRenderer::~OffscreenRenderer()
+{
+	if (0 != m_framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_framebuffer = 0;
+	}
+
+#ifdef OFFSCREEN_RENDERER_EGL
+	if (NULL != m_context)
+	{
+		eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)m_display, (EGLContext)m_context);
+		m_context = NULL;
+	}
+	if (NULL != m_display)
+	{
+		eglTerminate((EGLDisplay)m_display);
+		m_display = NULL;
+	}
+#endif
+}
+
+/***********************************************************
+ *  CreateContext()
+ *
+ *  This method is used for creating an OpenGL core profile
+ *  context through EGL and making it current without any
+ *  drawing surface.
+ ***********************************************************/
+bool OffscreenRenderer::CreateContext()
+{
+#ifdef OFFSCREEN_RENDERER_EGL
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+	EGLConfig config = (EGLConfig)0;
+	EGLint configCount = 0;
+	EGLint majorVersion = 0;
+	EGLint minorVersion = 0;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (NULL != getPlatformDisplay)
+	{
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (EGL_NO_DISPLAY == display)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if ((EGL_NO_DISPLAY == display) || (eglInitialize(display, &majorVersion, &minorVersion) == EGL_FALSE))
+	{
+		std::cout << "Failed to initialize an EGL display for headless rendering" << std::endl;
+		return(false);
+	}
+	m_display = display;
+
+	if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE)
+	{
+		std::cout << "The EGL display cannot create OpenGL contexts" << std::endl;
+		return(false);
+	}
+
+	// the framebuffer object is drawn into, so any OpenGL config
+	// will do, and none is needed where EGL allows it
+	const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	if ((eglChooseConfig(display, configAttributes, &config, 1, &configCount) == EGL_FALSE) || (configCount == 0))
+	{
+		config = EGL_NO_CONFIG_KHR;
+	}
+
+	for (int i = 0; (i < g_ContextVersionCount) && (EGL_NO_CONTEXT == context); i++)
+	{
+		const EGLint contextAttributes[] =
+		{
+			EGL_CONTEXT_MAJOR_VERSION, g_ContextVersions[i][0],
+			EGL_CONTEXT_MINOR_VERSION, g_ContextVersions[i][1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	}
+	if (EGL_NO_CONTEXT == context)
+	{
+		std::cout << "Failed to create a headless OpenGL 3.3 or later context" << std::endl;
+		return(false);
+	}
+	m_context = context;
+
+	if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_FALSE)
+	{
+		std::cout << "The headless OpenGL context cannot be used without a surface" << std::endl;
+		return(false);
+	}
+
+	return(true);
+#else
+	std::cout << "Headless rendering needs EGL, which is not available on this platform" << std::endl;
+	return(false);
+#endif
+}
+
+/***********************************************************
+ *  CreateFramebuffer()
+ *
+ *  This method is used for creating the framebuffer object
+ *  that the headless frames are drawn into, with a color
+ *  and a depth buffer of the passed in size.
+ ***********************************************************/
+bool OffscreenRenderer::CreateFramebuffer(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "The headless framebuffer is not complete" << std::endl;
+		return(false);
+	}
+
+	glViewport(0, 0, width, height);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BindFramebuffer()
+ *
+ *  This method is used for making the headless framebuffer
+ *  the target of the next draws.
+ ***********************************************************/
+void OffscreenRenderer::BindFramebuffer()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+/***********************************************************
+ *  LoadCameraPoses()
+ *
+ *  This method is used for reading the camera poses to render
+ *  from a text file.
+ ***********************************************************/
+bool OffscreenRenderer::LoadCameraPoses(const char* filename, std::vector<CAMERA_POSE>& poses)
+{
+	std::ifstream poseFile(filename);
+	std::string line;
+	int lineNumber = 0;
+
+	if (!poseFile.is_open())
+	{
+		std::cout << "Could not open the camera pose file:" << filename << std::endl;
+		return(false);
+	}
+
+	poses.clear();
+	while (std::getline(poseFile, line))
+	{
+		lineNumber++;
+
+		size_t first = line.find_first_not_of(" \t\r");
+		if ((first == std::string::npos) || (line[first] == '#'))
+		{
+			continue;
+		}
+
+		CAMERA_POSE pose;
+		std::istringstream values(line);
+		if (!(values >> pose.position.x >> pose.position.y >> pose.position.z
+			>> pose.front.x >> pose.front.y >> pose.front.z))
+		{
+			std::cout << "Camera pose " << lineNumber << " needs six numbers:" << filename << std::endl;
+			return(false);
+		}
+		poses.push_back(pose);
+	}
+
+	return(true);
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// offscreenrenderer.h
+// ============
+// render the 3D scene without a display, for batch jobs on servers
+//
+//	The OpenGL context is created through EGL without any surface, and
+//	the frames are drawn into a framebuffer object of the display window
+//	size. Nothing is ever swapped, so the frame rate is never held to the
+//	refresh rate of a display.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  OffscreenRenderer
+ *
+ *  This class owns the surfaceless OpenGL context and the
+ *  framebuffer that the headless frames are drawn into.
+ *  Headless rendering needs EGL, so it is not available on
+ *  Windows and macOS.
+ ***********************************************************/
+class OffscreenRenderer
+{
+public:
+	// constructor
+	OffscreenRenderer();
+	// destructor
+	~OffscreenRenderer();
+
+	// one camera pose to render
+	struct CAMERA_POSE
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+	};
+
+	// create the OpenGL context and make it current - returns
+	// false when no context can be created without a display
+	bool CreateContext();
+	// create the framebuffer that the frames are drawn into
+	bool CreateFramebuffer(int width, int height);
+	// bind the framebuffer and its viewport for drawing
+	void BindFramebuffer();
+
+	// read camera poses from a text file with one pose of six
+	// numbers on every line - the position and then the front
+	// direction - where lines starting with # are skipped
+	static bool LoadCameraPoses(const char* filename, std::vector<CAMERA_POSE>& poses);
+
+private:
+	// EGL display and context, kept as untyped handles so that
+	// the EGL headers are only needed by the implementation
+	void* m_display;
+	void* m_context;
+	// framebuffer and its color and depth storage
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+};
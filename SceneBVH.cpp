@@ -0,0 +1,719 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// bounding volume hierarchy over the world-space boxes of the scene objects
+//
+//	The hierarchy is built top-down with a binned surface area heuristic.
+//	Objects that move only refit the boxes on the path from their leaf up
+//	to the root, so the tree is only built again when objects are added.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// number of bins per axis for the surface area heuristic
+	const int g_SAHBins = 16;
+	// nodes with this many primitives or fewer are always leaves
+	const int g_MinLeafPrimitives = 2;
+	// traversal stack reserved up front, which grows when the
+	// hierarchy is deeper
+	const int g_TraversalStackSize = 64;
+
+	/***********************************************************
+	 *  HalfSurfaceArea()
+	 *
+	 *  This helper function is used for getting half of the
+	 *  surface area of a box, which is all that the surface
+	 *  area heuristic needs for comparing costs.
+	 ***********************************************************/
+	float HalfSurfaceArea(const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 extent = boxMax - boxMin;
+
+		if ((extent.x < 0.0f) || (extent.y < 0.0f) || (extent.z < 0.0f))
+		{
+			return(0.0f);
+		}
+
+		return(extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	/***********************************************************
+	 *  RayHitsBox()
+	 *
+	 *  This helper function is used for intersecting a ray with
+	 *  a box using the slab test. The distance where the ray
+	 *  enters the box is returned, or FLT_MAX for a miss.
+	 ***********************************************************/
+	float RayHitsBox(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax,
+		float maxDistance)
+	{
+		glm::vec3 t1 = (boxMin - origin) * inverseDirection;
+		glm::vec3 t2 = (boxMax - origin) * inverseDirection;
+		glm::vec3 tSmall = glm::min(t1, t2);
+		glm::vec3 tLarge = glm::max(t1, t2);
+		float tEnter = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+		float tExit = glm::min(glm::min(tLarge.x, tLarge.y), glm::min(tLarge.z, maxDistance));
+
+		return((tEnter <= tExit) ? tEnter : FLT_MAX);
+	}
+
+	/***********************************************************
+	 *  SphereTouchesBox()
+	 *
+	 *  This helper function is used for testing whether a
+	 *  sphere touches a box, by the distance from the sphere
+	 *  center to the closest point of the box.
+	 ***********************************************************/
+	bool SphereTouchesBox(
+		const glm::vec3& center,
+		float radius,
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax)
+	{
+		glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+		glm::vec3 offset = center - closest;
+
+		return(glm::dot(offset, offset) <= radius * radius);
+	}
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the hierarchy from the
+ *  root down. Every node is split where the binned surface
+ *  area heuristic gives the lowest cost, until splitting no
+ *  longer pays off.
+ ***********************************************************/
+void SceneBVH::Build(
+	const std::vector<glm::vec3>& boundsMin,
+	const std::vector<glm::vec3>& boundsMax)
+{
+	int primitiveCount = (int)boundsMin.size();
+
+	m_primitiveMin = boundsMin;
+	m_primitiveMax = boundsMax;
+	m_primitiveCenters.resize(primitiveCount);
+	m_leafPrimitives.resize(primitiveCount);
+	m_primitiveLeaves.assign(primitiveCount, 0);
+	m_nodes.clear();
+	m_nodeParents.clear();
+
+	if (primitiveCount == 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < primitiveCount; i++)
+	{
+		m_primitiveCenters[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+		m_leafPrimitives[i] = i;
+	}
+
+	// a binary tree never has more than 2n - 1 nodes, so the
+	// nodes never move while they are being split
+	m_nodes.reserve(primitiveCount * 2);
+	m_nodeParents.reserve(primitiveCount * 2);
+
+	BVH_NODE root;
+	root.first = 0;
+	root.count = primitiveCount;
+	m_nodes.push_back(root);
+	m_nodeParents.push_back(-1);
+	UpdateNodeBounds(0);
+
+	std::vector<int> splitStack;
+	splitStack.push_back(0);
+	while (splitStack.empty() == false)
+	{
+		int node = splitStack.back();
+		splitStack.pop_back();
+
+		Subdivide(node);
+		if (m_nodes[node].count == 0)
+		{
+			splitStack.push_back(m_nodes[node].first);
+			splitStack.push_back(m_nodes[node].first + 1);
+		}
+	}
+
+	// remember the leaf of every primitive for refitting
+	for (int node = 0; node < (int)m_nodes.size(); node++)
+	{
+		for (int i = 0; i < m_nodes[node].count; i++)
+		{
+			m_primitiveLeaves[m_leafPrimitives[m_nodes[node].first + i]] = node;
+		}
+	}
+}
+
+/***********************************************************
+ *  UpdateNodeBounds()
+ *
+ *  This method is used for computing the box of a leaf node
+ *  from the boxes of its primitives.
+ ***********************************************************/
+void SceneBVH::UpdateNodeBounds(int node)
+{
+	BVH_NODE& bvhNode = m_nodes[node];
+
+	bvhNode.boundsMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	bvhNode.boundsMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < bvhNode.count; i++)
+	{
+		int primitive = m_leafPrimitives[bvhNode.first + i];
+		bvhNode.boundsMin = glm::min(bvhNode.boundsMin, m_primitiveMin[primitive]);
+		bvhNode.boundsMax = glm::max(bvhNode.boundsMax, m_primitiveMax[primitive]);
+	}
+}
+
+/***********************************************************
+ *  Subdivide()
+ *
+ *  This method is used for splitting a leaf node into two
+ *  children. The primitive centers are sorted into bins
+ *  along each axis, and the split between two bins with the
+ *  lowest surface area cost is taken when it is cheaper
+ *  than keeping the leaf.
+ ***********************************************************/
+void SceneBVH::Subdivide(int node)
+{
+	BVH_NODE& bvhNode = m_nodes[node];
+
+	if (bvhNode.count <= g_MinLeafPrimitives)
+	{
+		return;
+	}
+
+	// the bins span the centers, not the boxes
+	glm::vec3 centerMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	glm::vec3 centerMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < bvhNode.count; i++)
+	{
+		const glm::vec3& center = m_primitiveCenters[m_leafPrimitives[bvhNode.first + i]];
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = bvhNode.count * HalfSurfaceArea(bvhNode.boundsMin, bvhNode.boundsMax);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float axisMin = centerMin[axis];
+		float axisExtent = centerMax[axis] - axisMin;
+		if (axisExtent <= 0.0f)
+		{
+			continue;
+		}
+
+		int binCounts[g_SAHBins] = {};
+		glm::vec3 binMin[g_SAHBins];
+		glm::vec3 binMax[g_SAHBins];
+		for (int bin = 0; bin < g_SAHBins; bin++)
+		{
+			binMin[bin] = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			binMax[bin] = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+
+		float binScale = g_SAHBins / axisExtent;
+		for (int i = 0; i < bvhNode.count; i++)
+		{
+			int primitive = m_leafPrimitives[bvhNode.first + i];
+			int bin = glm::min(g_SAHBins - 1, (int)((m_primitiveCenters[primitive][axis] - axisMin) * binScale));
+			binCounts[bin]++;
+			binMin[bin] = glm::min(binMin[bin], m_primitiveMin[primitive]);
+			binMax[bin] = glm::max(binMax[bin], m_primitiveMax[primitive]);
+		}
+
+		// sweep from both ends to get the area and count on each
+		// side of every split
+		float leftAreas[g_SAHBins - 1];
+		int leftCounts[g_SAHBins - 1];
+		glm::vec3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		glm::vec3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		int sweepCount = 0;
+		for (int split = 0; split < g_SAHBins - 1; split++)
+		{
+			sweepCount += binCounts[split];
+			sweepMin = glm::min(sweepMin, binMin[split]);
+			sweepMax = glm::max(sweepMax, binMax[split]);
+			leftCounts[split] = sweepCount;
+			leftAreas[split] = HalfSurfaceArea(sweepMin, sweepMax);
+		}
+
+		sweepMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		sweepMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		sweepCount = 0;
+		for (int split = g_SAHBins - 2; split >= 0; split--)
+		{
+			sweepCount += binCounts[split + 1];
+			sweepMin = glm::min(sweepMin, binMin[split + 1]);
+			sweepMax = glm::max(sweepMax, binMax[split + 1]);
+
+			if ((leftCounts[split] == 0) || (sweepCount == 0))
+			{
+				continue;
+			}
+
+			float cost = leftCounts[split] * leftAreas[split] + sweepCount * HalfSurfaceArea(sweepMin, sweepMax);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+	{
+		return;
+	}
+
+	// move the primitives left of the split to the front
+	float axisMin = centerMin[bestAxis];
+	float binScale = g_SAHBins / (centerMax[bestAxis] - axisMin);
+	int left = bvhNode.first;
+	int right = bvhNode.first + bvhNode.count - 1;
+	while (left <= right)
+	{
+		int primitive = m_leafPrimitives[left];
+		int bin = glm::min(g_SAHBins - 1, (int)((m_primitiveCenters[primitive][bestAxis] - axisMin) * binScale));
+		if (bin <= bestSplit)
+		{
+			left++;
+		}
+		else
+		{
+			m_leafPrimitives[left] = m_leafPrimitives[right];
+			m_leafPrimitives[right] = primitive;
+			right--;
+		}
+	}
+
+	int leftCount = left - bvhNode.first;
+	if ((leftCount == 0) || (leftCount == bvhNode.count))
+	{
+		return;
+	}
+
+	int childIndex = (int)m_nodes.size();
+	BVH_NODE leftChild;
+	leftChild.first = bvhNode.first;
+	leftChild.count = leftCount;
+	BVH_NODE rightChild;
+	rightChild.first = left;
+	rightChild.count = bvhNode.count - leftCount;
+
+	bvhNode.first = childIndex;
+	bvhNode.count = 0;
+
+	m_nodes.push_back(leftChild);
+	m_nodes.push_back(rightChild);
+	m_nodeParents.push_back(node);
+	m_nodeParents.push_back(node);
+	UpdateNodeBounds(childIndex);
+	UpdateNodeBounds(childIndex + 1);
+}
+
+/***********************************************************
+ *  RefitPrimitive()
+ *
+ *  This method is used for changing the box of a primitive
+ *  that moved, and for refitting the boxes of its leaf and
+ *  of every node above it. The tree shape stays the same,
+ *  so a primitive that moves far makes queries slower until
+ *  the next build.
+ ***********************************************************/
+void SceneBVH::RefitPrimitive(int primitive, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	if ((primitive < 0) || (primitive >= GetPrimitiveCount()))
+	{
+		return;
+	}
+
+	m_primitiveMin[primitive] = boxMin;
+	m_primitiveMax[primitive] = boxMax;
+	m_primitiveCenters[primitive] = (boxMin + boxMax) * 0.5f;
+
+	int node = m_primitiveLeaves[primitive];
+	UpdateNodeBounds(node);
+
+	node = m_nodeParents[node];
+	while (node >= 0)
+	{
+		BVH_NODE& bvhNode = m_nodes[node];
+		const BVH_NODE& leftChild = m_nodes[bvhNode.first];
+		const BVH_NODE& rightChild = m_nodes[bvhNode.first + 1];
+
+		bvhNode.boundsMin = glm::min(leftChild.boundsMin, rightChild.boundsMin);
+		bvhNode.boundsMax = glm::max(leftChild.boundsMax, rightChild.boundsMax);
+		node = m_nodeParents[node];
+	}
+}
+
+/***********************************************************
+ *  CollectPrimitives()
+ *
+ *  This method is used for adding all the primitives below
+ *  a node to the results without testing them.
+ ***********************************************************/
+void SceneBVH::CollectPrimitives(int node, std::vector<int>& results) const
+{
+	std::vector<int> stack;
+	stack.reserve(g_TraversalStackSize);
+
+	stack.push_back(node);
+	while (stack.empty() == false)
+	{
+		const BVH_NODE& bvhNode = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (bvhNode.count > 0)
+		{
+			for (int i = 0; i < bvhNode.count; i++)
+			{
+				results.push_back(m_leafPrimitives[bvhNode.first + i]);
+			}
+		}
+		else
+		{
+			stack.push_back(bvhNode.first);
+			stack.push_back(bvhNode.first + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  QueryFrustum()
+ *
+ *  This method is used for collecting the primitives inside
+ *  of a view frustum. Nodes outside of the frustum are
+ *  skipped with everything below them, and nodes completely
+ *  inside are collected without any more tests.
+ ***********************************************************/
+int SceneBVH::QueryFrustum(const FrustumCuller& frustum, std::vector<int>& results) const
+{
+	std::vector<int> stack;
+	stack.reserve(g_TraversalStackSize);
+
+	results.clear();
+	if (m_nodes.empty())
+	{
+		return(0);
+	}
+
+	stack.push_back(0);
+	while (stack.empty() == false)
+	{
+		int node = stack.back();
+		stack.pop_back();
+		const BVH_NODE& bvhNode = m_nodes[node];
+		FrustumCuller::BOX_CLASS boxClass = frustum.ClassifyBox(bvhNode.boundsMin, bvhNode.boundsMax);
+
+		if (boxClass == FrustumCuller::BOX_OUTSIDE)
+		{
+			continue;
+		}
+		if (boxClass == FrustumCuller::BOX_INSIDE)
+		{
+			CollectPrimitives(node, results);
+			continue;
+		}
+
+		if (bvhNode.count > 0)
+		{
+			for (int i = 0; i < bvhNode.count; i++)
+			{
+				int primitive = m_leafPrimitives[bvhNode.first + i];
+				if (frustum.TestBox(m_primitiveMin[primitive], m_primitiveMax[primitive]))
+				{
+					results.push_back(primitive);
+				}
+			}
+		}
+		else
+		{
+			stack.push_back(bvhNode.first);
+			stack.push_back(bvhNode.first + 1);
+		}
+	}
+
+	return((int)results.size());
+}
+
+/***********************************************************
+ *  QueryRay()
+ *
+ *  This method is used for finding the closest primitive box
+ *  that a ray hits. The nearer child is visited first, and
+ *  nodes behind the closest hit so far are skipped.
+ ***********************************************************/
+int SceneBVH::QueryRay(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	float& hitDistance) const
+{
+	std::vector<int> stack;
+	stack.reserve(g_TraversalStackSize);
+	int hitPrimitive = -1;
+	glm::vec3 inverseDirection = 1.0f / direction;
+
+	hitDistance = maxDistance;
+	if (m_nodes.empty())
+	{
+		return(-1);
+	}
+
+	stack.push_back(0);
+	while (stack.empty() == false)
+	{
+		const BVH_NODE& bvhNode = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (RayHitsBox(origin, inverseDirection, bvhNode.boundsMin, bvhNode.boundsMax, hitDistance) == FLT_MAX)
+		{
+			continue;
+		}
+
+		if (bvhNode.count > 0)
+		{
+			for (int i = 0; i < bvhNode.count; i++)
+			{
+				int primitive = m_leafPrimitives[bvhNode.first + i];
+				float distance = RayHitsBox(origin, inverseDirection,
+					m_primitiveMin[primitive], m_primitiveMax[primitive], hitDistance);
+				if (distance < hitDistance)
+				{
+					hitDistance = distance;
+					hitPrimitive = primitive;
+				}
+			}
+		}
+		else
+		{
+			const BVH_NODE& leftChild = m_nodes[bvhNode.first];
+			const BVH_NODE& rightChild = m_nodes[bvhNode.first + 1];
+			float leftDistance = RayHitsBox(origin, inverseDirection, leftChild.boundsMin, leftChild.boundsMax, hitDistance);
+			float rightDistance = RayHitsBox(origin, inverseDirection, rightChild.boundsMin, rightChild.boundsMax, hitDistance);
+
+			// the child pushed last is visited first
+			if (leftDistance <= rightDistance)
+			{
+				if (rightDistance != FLT_MAX) stack.push_back(bvhNode.first + 1);
+				if (leftDistance != FLT_MAX) stack.push_back(bvhNode.first);
+			}
+			else
+			{
+				if (leftDistance != FLT_MAX) stack.push_back(bvhNode.first);
+				if (rightDistance != FLT_MAX) stack.push_back(bvhNode.first + 1);
+			}
+		}
+	}
+
+	return(hitPrimitive);
+}
+
+/***********************************************************
+ *  QueryRadius()
+ *
+ *  This method is used for collecting the primitives whose
+ *  boxes touch a sphere.
+ ***********************************************************/
+int SceneBVH::QueryRadius(const glm::vec3& center, float radius, std::vector<int>& results) const
+{
+	std::vector<int> stack;
+	stack.reserve(g_TraversalStackSize);
+
+	results.clear();
+	if (m_nodes.empty())
+	{
+		return(0);
+	}
+
+	stack.push_back(0);
+	while (stack.empty() == false)
+	{
+		const BVH_NODE& bvhNode = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (SphereTouchesBox(center, radius, bvhNode.boundsMin, bvhNode.boundsMax) == false)
+		{
+			continue;
+		}
+
+		if (bvhNode.count > 0)
+		{
+			for (int i = 0; i < bvhNode.count; i++)
+			{
+				int primitive = m_leafPrimitives[bvhNode.first + i];
+				if (SphereTouchesBox(center, radius, m_primitiveMin[primitive], m_primitiveMax[primitive]))
+				{
+					results.push_back(primitive);
+				}
+			}
+		}
+		else
+		{
+			stack.push_back(bvhNode.first);
+			stack.push_back(bvhNode.first + 1);
+		}
+	}
+
+	return((int)results.size());
+}
+
+/***********************************************************
+ *  Benchmark()
+ *
+ *  This method is used for timing the hierarchy with random
+ *  boxes spread through a room that grows with the box
+ *  count. The frustum query is also compared against
+ *  testing every box in a flat list that holds the same
+ *  moved boxes, and the boxes that only one of them finds
+ *  visible are counted.
+ ***********************************************************/
+void SceneBVH::Benchmark(int primitiveCount)
+{
+	const int queryCount = 1000;
+	float roomSize = 10.0f * std::cbrt((float)primitiveCount / 1000.0f) + 10.0f;
+	std::vector<glm::vec3> boundsMin(primitiveCount);
+	std::vector<glm::vec3> boundsMax(primitiveCount);
+	unsigned int seed = 4242;
+
+	// repeatable pseudo-random numbers between 0 and 1
+	struct RANDOM
+	{
+		static float Next(unsigned int& state)
+		{
+			state = state * 1664525u + 1013904223u;
+			return (float)(state >> 8) / (float)(1 << 24);
+		}
+	};
+
+	for (int i = 0; i < primitiveCount; i++)
+	{
+		glm::vec3 center(
+			(RANDOM::Next(seed) - 0.5f) * roomSize,
+			(RANDOM::Next(seed) - 0.5f) * roomSize,
+			(RANDOM::Next(seed) - 0.5f) * roomSize);
+		glm::vec3 extent(
+			0.1f + RANDOM::Next(seed) * 0.7f,
+			0.1f + RANDOM::Next(seed) * 0.7f,
+			0.1f + RANDOM::Next(seed) * 0.7f);
+		boundsMin[i] = center - extent;
+		boundsMax[i] = center + extent;
+	}
+
+	SceneBVH bvh;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bvh.Build(boundsMin, boundsMax);
+	double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// move one in a hundred boxes a little - the flat list
+	// below is built from the moved boxes as well
+	start = std::chrono::steady_clock::now();
+	int refitCount = 0;
+	for (int i = 0; i < primitiveCount; i += 100)
+	{
+		glm::vec3 offset(0.25f, 0.0f, -0.25f);
+		boundsMin[i] += offset;
+		boundsMax[i] += offset;
+		bvh.RefitPrimitive(i, boundsMin[i], boundsMax[i]);
+		refitCount++;
+	}
+	double refitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// a camera in one corner looking at the middle of the room
+	FrustumCuller frustum;
+	glm::mat4 view = glm::lookAt(glm::vec3(-0.5f, 0.2f, -0.5f) * roomSize, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, roomSize);
+	frustum.SetViewProjection(projection * view);
+
+	std::vector<int> results;
+	start = std::chrono::steady_clock::now();
+	int visibleCount = bvh.QueryFrustum(frustum, results);
+	double frustumMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	FrustumCuller::BOX_LIST boxes;
+	std::vector<unsigned char> visible;
+	boxes.Resize(primitiveCount);
+	for (int i = 0; i < primitiveCount; i++)
+	{
+		boxes.SetBox(i, boundsMin[i], boundsMax[i]);
+	}
+	start = std::chrono::steady_clock::now();
+	int flatVisibleCount = frustum.CullBoxes(boxes, visible);
+	double flatMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// the boxes that only the hierarchy found, and the visible
+	// boxes of the flat list that the hierarchy missed
+	int hierarchyOnlyCount = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (visible[results[i]] == 0)
+		{
+			hierarchyOnlyCount++;
+		}
+	}
+	int mismatchCount = hierarchyOnlyCount + (flatVisibleCount - (visibleCount - hierarchyOnlyCount));
+
+	start = std::chrono::steady_clock::now();
+	int rayHits = 0;
+	for (int i = 0; i < queryCount; i++)
+	{
+		glm::vec3 direction = glm::normalize(glm::vec3(
+			RANDOM::Next(seed) - 0.5f, RANDOM::Next(seed) - 0.5f, RANDOM::Next(seed) - 0.5f) + glm::vec3(0.001f, 0.001f, 0.001f));
+		float hitDistance = 0.0f;
+		if (bvh.QueryRay(glm::vec3(0.0f, 0.0f, 0.0f), direction, roomSize, hitDistance) >= 0)
+		{
+			rayHits++;
+		}
+	}
+	double rayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	size_t radiusResults = 0;
+	for (int i = 0; i < queryCount; i++)
+	{
+		glm::vec3 center(
+			(RANDOM::Next(seed) - 0.5f) * roomSize,
+			(RANDOM::Next(seed) - 0.5f) * roomSize,
+			(RANDOM::Next(seed) - 0.5f) * roomSize);
+		radiusResults += bvh.QueryRadius(center, 2.0f, results);
+	}
+	double radiusMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "BVH with " << primitiveCount << " boxes, " << bvh.GetNodeCount() << " nodes - build:" << buildMs
+		<< "ms, refit of " << refitCount << ":" << refitMs
+		<< "ms, frustum:" << frustumMs << "ms (" << visibleCount << " visible, flat list:" << flatMs
+		<< "ms, " << flatVisibleCount << " visible, " << mismatchCount << " mismatched), " << queryCount << " rays:" << rayMs
+		<< "ms (" << rayHits << " hits), " << queryCount << " radius queries:" << radiusMs
+		<< "ms (" << radiusResults << " results)" << std::endl;
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// bounding volume hierarchy over the world-space boxes of the scene objects
+//
+//	The hierarchy is built top-down with a binned surface area heuristic.
+//	Objects that move only refit the boxes on the path from their leaf up
+//	to the root, so the tree is only built again when objects are added.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class builds a bounding volume hierarchy over a list
+ *  of axis-aligned boxes, called primitives, and answers
+ *  frustum, ray and radius queries with the indices of the
+ *  primitives that were hit.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+
+	// build the hierarchy over the passed in primitive boxes
+	void Build(
+		const std::vector<glm::vec3>& boundsMin,
+		const std::vector<glm::vec3>& boundsMax);
+	// change the box of one primitive and refit its ancestors
+	void RefitPrimitive(int primitive, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+	// collect the primitives whose boxes are inside or crossing
+	// the frustum - returns the number of collected primitives
+	int QueryFrustum(const FrustumCuller& frustum, std::vector<int>& results) const;
+	// find the closest primitive box hit by a ray - returns -1
+	// when no box is hit within the maximum distance
+	int QueryRay(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		float& hitDistance) const;
+	// collect the primitives whose boxes touch a sphere
+	int QueryRadius(const glm::vec3& center, float radius, std::vector<int>& results) const;
+
+	// get the number of primitives and nodes in the hierarchy
+	int GetPrimitiveCount() const { return (int)m_primitiveMin.size(); }
+	int GetNodeCount() const { return (int)m_nodes.size(); }
+
+	// time the build, refit and queries for the passed in number
+	// of random boxes and write the results to the console
+	static void Benchmark(int primitiveCount);
+
+private:
+	// a node is a leaf when its count is above 0 - a leaf holds
+	// the primitives from first on, and an inner node has its
+	// two children at first and first + 1
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		int first;
+		glm::vec3 boundsMax;
+		int count;
+	};
+
+	// nodes of the hierarchy, the root is the first one
+	std::vector<BVH_NODE> m_nodes;
+	// parent of every node, -1 for the root
+	std::vector<int> m_nodeParents;
+	// primitive indices in leaf order
+	std::vector<int> m_leafPrimitives;
+	// leaf node that holds every primitive
+	std::vector<int> m_primitiveLeaves;
+	// primitive boxes and their centers
+	std::vector<glm::vec3> m_primitiveMin;
+	std::vector<glm::vec3> m_primitiveMax;
+	std::vector<glm::vec3> m_primitiveCenters;
+
+	// compute the box of a node from its primitives
+	void UpdateNodeBounds(int node);
+	// split a node with the binned surface area heuristic
+	void Subdivide(int node);
+	// collect all the primitives below a node
+	void CollectPrimitives(int node, std::vector<int>& results) const;
+};
@@ -8,6 +8,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "GLStateCache.h"
+#include "FrameProfiler.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,14 +18,247 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <chrono>
+
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureArrayName = "objectTextureArray";
+	const char* g_TextureLayerName = "textureLayer";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_MaterialIndexName = "materialIndex";
+	const char* g_UseInstancingName = "bUseInstancing";
+
+	// uniform block names and binding points - the array sizes
+	// must match MAX_MATERIALS and MAX_LIGHTS in the fragment shader
+	const char* g_MaterialBlockName = "MaterialBlock";
+	const char* g_LightBlockName = "LightBlock";
+	const GLuint g_MaterialBlockBinding = 0;
+	const GLuint g_LightBlockBinding = 1;
+	const int g_MaxMaterials = 32;
+	const int g_MaxLights = 4;
+
+	// instance batches for the repeated objects in the scene
+	const int g_DeskLegBatch = 0;
+	const int g_PenBatch = 1;
+	const int g_LeafBatch = 2;
+
+	// texture units of the texture array and the placeholder
+	// texture - the 2D textures are bound on the units after them
+	const int g_TextureArrayUnit = 0;
+	const int g_PlaceholderUnit = 1;
+	const int g_MaxTextureUnits = 16;
+	// most decoded images uploaded in one frame while rendering
+	const int g_MaxTextureUploadsPerFrame = 2;
+	// width and height of the textures that go into the texture
+	// array, and the most layers that OpenGL always supports
+	const int g_TextureArraySize = 1024;
+	const int g_MaxTextureArrayLayers = 256;
+
+	// draw packet sort key layout, from the highest bits down:
+	//   opaque      - pass, coarse front-to-back depth, material,
+	//                 texture, mesh
+	//   transparent - pass, fine back-to-front depth
+	// the packet index always fills the lowest bits, which also
+	// keeps the sort stable, and the tessellation level of the
+	// packet is kept in the unused bits above it
+	const int g_SortPassShift = 62;
+	const int g_SortCoarseDepthShift = 58;
+	const int g_SortCoarseDepthBits = 4;
+	const int g_SortMaterialShift = 48;
+	const int g_SortTextureShift = 36;
+	const int g_SortMeshShift = 30;
+	const int g_SortFineDepthShift = 38;
+	const int g_SortFineDepthBits = 24;
+	const int g_SortIndexBits = 20;
+	const uint64_t g_SortIndexMask = (1ull << g_SortIndexBits) - 1;
+	const int g_SortLevelShift = 20;
+	const uint64_t g_SortLevelMask = 0x3;
+	// distance from the camera that maps to the farthest depth
+	const float g_SortMaxDepth = 100.0f;
+
+	// scenes with fewer objects than this are culled by testing
+	// every packet box, which beats walking the hierarchy
+	const int g_MinHierarchyCullObjects = 256;
+
+	// scenes with at least this many packets, and frames with at
+	// least this many packets left by the hierarchy, share the
+	// visible packets out to the packet threads in chunks
+	const size_t g_MinParallelPackets = 2048;
+	const int g_PacketChunkSize = 256;
+	// most packet threads, counting the rendering thread
+	const int g_MaxPacketThreads = 8;
+
+	// compute shader for culling the packets on the GPU
+	const char* g_CullingShaderFile = "shaders/cullingShader.glsl";
+
+	// distance between the rooms of the stress scene grid - the
+	// walls of a room are 50 apart across and 30 deep
+	const float g_StressRoomPitchX = 52.0f;
+	const float g_StressRoomPitchZ = 32.0f;
+	// the objects of a room whose centers are inside this half
+	// size stand on or under the desk, and are moved together by
+	// up to the desk shift - objects at least the structure size
+	// across are the floor and the walls, which never move
+	const float g_StressDeskAreaX = 8.5f;
+	const float g_StressDeskAreaZ = 4.5f;
+	const float g_StressDeskShiftX = 6.0f;
+	const float g_StressDeskShiftZ = 2.0f;
+	const float g_StressStructureSize = 20.0f;
+	// the rooms take their own batches after the desk room ones
+	const int g_StressBatchesPerRoom = 3;
+	const int g_StressFirstBatch = 3;
+	// the opaque textures that the rooms swap around
+	const char* const g_StressTextureTags[] =
+	{
+		"woodDesk", "wallpaper", "floorTiles", "clay", "plantBox", "plantStem"
+	};
+	const int g_StressTextureCount = 6;
+
+	/***********************************************************
+	 *  NextRandom()
+	 *
+	 *  This helper function is used for getting repeatable
+	 *  pseudo-random numbers between 0 and 1, which are the
+	 *  same on every platform for the same seed.
+	 ***********************************************************/
+	float NextRandom(unsigned int& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return((float)(state >> 8) / (float)(1 << 24));
+	}
+
+	// std140 layout of the light uniform block
+	struct LIGHT_BLOCK
+	{
+		SceneManager::LIGHT_BLOCK_ENTRY lights[g_MaxLights];
+		GLint lightCount;
+		GLint padding[3];
+	};
+
+	/***********************************************************
+	 *  MultiplyModelMatrix()
+	 *
+	 *  This helper function is used for building the model
+	 *  matrix from the passed in transformation values with
+	 *  one matrix per transformation. It is only kept as the
+	 *  reference for BenchmarkModelMatrices().
+	 ***********************************************************/
+	glm::mat4 MultiplyModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ)
+	{
+		// variables for this method
+		glm::mat4 scale;
+		glm::mat4 rotationX;
+		glm::mat4 rotationY;
+		glm::mat4 rotationZ;
+		glm::mat4 translation;
+
+		// set the scale value in the transform buffer
+		scale = glm::scale(scaleXYZ);
+		// set the rotation values in the transform buffer
+		rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+		rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+		rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+		// set the translation value in the transform buffer
+		translation = glm::translate(positionXYZ);
+
+		return(translation * rotationX * rotationY * rotationZ * scale);
+	}
+
+	/***********************************************************
+	 *  BuildModelMatrix()
+	 *
+	 *  This helper function is used for building the model
+	 *  matrix from the passed in transformation values. The
+	 *  result is the same as translation * rotationX * rotationY
+	 *  * rotationZ * scale, but every column is written directly
+	 *  from the sines and cosines of the three angles, without
+	 *  any 4x4 matrix multiplies.
+	 ***********************************************************/
+	glm::mat4 BuildModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ)
+	{
+		glm::vec3 radians = glm::radians(glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees));
+		glm::vec3 sines = glm::sin(radians);
+		glm::vec3 cosines = glm::cos(radians);
+		float sx = sines.x, sy = sines.y, sz = sines.z;
+		float cx = cosines.x, cy = cosines.y, cz = cosines.z;
+		glm::mat4 model;
+
+		// rotation columns of Rx * Ry * Rz, each one scaled
+		model[0] = glm::vec4(
+			cy * cz,
+			sx * sy * cz + cx * sz,
+			sx * sz - cx * sy * cz,
+			0.0f) * scaleXYZ.x;
+		model[1] = glm::vec4(
+			-cy * sz,
+			cx * cz - sx * sy * sz,
+			cx * sy * sz + sx * cz,
+			0.0f) * scaleXYZ.y;
+		model[2] = glm::vec4(
+			sy,
+			-sx * cy,
+			cx * cy,
+			0.0f) * scaleXYZ.z;
+		// translation column
+		model[3] = glm::vec4(positionXYZ, 1.0f);
+
+		return(model);
+	}
+
+	/***********************************************************
+	 *  RadixSortKeys()
+	 *
+	 *  This helper function is used for sorting 64-bit keys with
+	 *  an LSD radix sort, 8 bits per pass. Passes where every key
+	 *  has the same digit are skipped.
+	 ***********************************************************/
+	void RadixSortKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+	{
+		size_t count = keys.size();
+
+		scratch.resize(count);
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t histogram[256] = {};
+
+			for (size_t i = 0; i < count; i++)
+			{
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+			if ((count == 0) || (histogram[(keys[0] >> shift) & 0xFF] == count))
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (int digit = 0; digit < 256; digit++)
+			{
+				size_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				scratch[histogram[(keys[i] >> shift) & 0xFF]++] = keys[i];
+			}
+			keys.swap(scratch);
+		}
+	}
 
 	/***********************************************************
 	 *  DefineObjectMaterials()
@@ -32,7 +267,7 @@ namespace
 	 *  objects in the 3D scene. Materials control how objects
 	 *  interact with light using the Phong lighting model.
 	 ***********************************************************/
-	void DefineObjectMaterials(SceneManager* sceneManager, std::vector<SceneManager::OBJECT_MATERIAL>& materials)
+	void DefineObjectMaterials(std::vector<SceneManager::OBJECT_MATERIAL>& materials)
 	{
 		SceneManager::OBJECT_MATERIAL woodMaterial;
 		woodMaterial.ambientColor = glm::vec3(0.2f, 0.15f, 0.1f);
@@ -81,53 +316,58 @@ namespace
 	}
 
 	/***********************************************************
-	 *  SetupSceneLights()
+	 *  DefineSceneLights()
 	 *
-	 *  This helper function is used for setting up the light sources in
+	 *  This helper function is used for defining the light sources in
 	 *  the 3D scene. It configures multiple light sources with
 	 *  different positions and properties to properly illuminate
 	 *  the scene using the Phong lighting model.
 	 ***********************************************************/
-	void SetupSceneLights(ShaderManager* shaderManager)
+	void DefineSceneLights(std::vector<SceneManager::LIGHT_SOURCE>& lights)
 	{
-		// Enable lighting in the shader
-		shaderManager->setBoolValue(g_UseLightingName, true);
-
 		// Light 1: Main overhead ceiling light (warm white) - centered above the desk
 		// This simulates a typical room ceiling light providing main illumination
-		shaderManager->setVec3Value("lightSources[0].position", glm::vec3(0.0f, 18.0f, 2.0f));
-		shaderManager->setVec3Value("lightSources[0].ambientColor", glm::vec3(0.35f, 0.32f, 0.28f));  // Warm ambient
-		shaderManager->setVec3Value("lightSources[0].diffuseColor", glm::vec3(1.0f, 0.95f, 0.85f));  // Warm white light
-		shaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(0.9f, 0.9f, 0.85f));
-		shaderManager->setFloatValue("lightSources[0].focalStrength", 48.0f);
-		shaderManager->setFloatValue("lightSources[0].specularIntensity", 0.6f);
+		SceneManager::LIGHT_SOURCE ceilingLight;
+		ceilingLight.position = glm::vec3(0.0f, 18.0f, 2.0f);
+		ceilingLight.ambientColor = glm::vec3(0.35f, 0.32f, 0.28f);  // Warm ambient
+		ceilingLight.diffuseColor = glm::vec3(1.0f, 0.95f, 0.85f);   // Warm white light
+		ceilingLight.specularColor = glm::vec3(0.9f, 0.9f, 0.85f);
+		ceilingLight.focalStrength = 48.0f;
+		ceilingLight.specularIntensity = 0.6f;
+		lights.push_back(ceilingLight);
 
 		// Light 2: Desk lamp from left side (warmer tone)
 		// This simulates a desk lamp providing task lighting
-		shaderManager->setVec3Value("lightSources[1].position", glm::vec3(-12.0f, 8.0f, 3.0f));
-		shaderManager->setVec3Value("lightSources[1].ambientColor", glm::vec3(0.15f, 0.12f, 0.08f));
-		shaderManager->setVec3Value("lightSources[1].diffuseColor", glm::vec3(0.9f, 0.85f, 0.7f));  // Warm desk lamp
-		shaderManager->setVec3Value("lightSources[1].specularColor", glm::vec3(0.8f, 0.75f, 0.65f));
-		shaderManager->setFloatValue("lightSources[1].focalStrength", 24.0f);
-		shaderManager->setFloatValue("lightSources[1].specularIntensity", 0.5f);
+		SceneManager::LIGHT_SOURCE deskLamp;
+		deskLamp.position = glm::vec3(-12.0f, 8.0f, 3.0f);
+		deskLamp.ambientColor = glm::vec3(0.15f, 0.12f, 0.08f);
+		deskLamp.diffuseColor = glm::vec3(0.9f, 0.85f, 0.7f);  // Warm desk lamp
+		deskLamp.specularColor = glm::vec3(0.8f, 0.75f, 0.65f);
+		deskLamp.focalStrength = 24.0f;
+		deskLamp.specularIntensity = 0.5f;
+		lights.push_back(deskLamp);
 
 		// Light 3: Window light from the right (cool daylight)
 		// This simulates natural light coming from a window
-		shaderManager->setVec3Value("lightSources[2].position", glm::vec3(20.0f, 12.0f, 5.0f));
-		shaderManager->setVec3Value("lightSources[2].ambientColor", glm::vec3(0.12f, 0.15f, 0.18f));
-		shaderManager->setVec3Value("lightSources[2].diffuseColor", glm::vec3(0.7f, 0.8f, 0.95f));  // Cool daylight
-		shaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(0.85f, 0.9f, 1.0f));
-		shaderManager->setFloatValue("lightSources[2].focalStrength", 20.0f);
-		shaderManager->setFloatValue("lightSources[2].specularIntensity", 0.4f);
+		SceneManager::LIGHT_SOURCE windowLight;
+		windowLight.position = glm::vec3(20.0f, 12.0f, 5.0f);
+		windowLight.ambientColor = glm::vec3(0.12f, 0.15f, 0.18f);
+		windowLight.diffuseColor = glm::vec3(0.7f, 0.8f, 0.95f);  // Cool daylight
+		windowLight.specularColor = glm::vec3(0.85f, 0.9f, 1.0f);
+		windowLight.focalStrength = 20.0f;
+		windowLight.specularIntensity = 0.4f;
+		lights.push_back(windowLight);
 
 		// Light 4: Monitor glow (subtle blue light)
 		// This simulates the screen glow from the monitor
-		shaderManager->setVec3Value("lightSources[3].position", glm::vec3(0.0f, 5.0f, 0.0f));
-		shaderManager->setVec3Value("lightSources[3].ambientColor", glm::vec3(0.05f, 0.08f, 0.12f));
-		shaderManager->setVec3Value("lightSources[3].diffuseColor", glm::vec3(0.4f, 0.6f, 0.9f));  // Blue monitor glow
-		shaderManager->setVec3Value("lightSources[3].specularColor", glm::vec3(0.5f, 0.7f, 1.0f));
-		shaderManager->setFloatValue("lightSources[3].focalStrength", 12.0f);
-		shaderManager->setFloatValue("lightSources[3].specularIntensity", 0.3f);
+		SceneManager::LIGHT_SOURCE monitorGlow;
+		monitorGlow.position = glm::vec3(0.0f, 5.0f, 0.0f);
+		monitorGlow.ambientColor = glm::vec3(0.05f, 0.08f, 0.12f);
+		monitorGlow.diffuseColor = glm::vec3(0.4f, 0.6f, 0.9f);  // Blue monitor glow
+		monitorGlow.specularColor = glm::vec3(0.5f, 0.7f, 1.0f);
+		monitorGlow.focalStrength = 12.0f;
+		monitorGlow.specularIntensity = 0.3f;
+		lights.push_back(monitorGlow);
 	}
 }
 
@@ -139,7 +379,62 @@ namespace
 SceneManager::SceneManager(ShaderManager *pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pUniformCache = NULL;
+	m_loadedTextures = 0;
+	m_textureUnits = 0;
+	m_textureArray = 0;
+	m_textureArrayCapacity = 0;
+	m_textureArrayLayers = 0;
+	m_textureArrayFormat = GL_RGB8;
+	m_textureArrayLevels = 1;
+	m_bTextureArrayMipmaps = false;
+	m_placeholderTexture = 0;
+	m_pTextureLoader = NULL;
+	m_materialBuffer = 0;
+	m_lightBuffer = 0;
+	m_instancedMeshes = new SceneMeshes();
+	m_bSceneDirty = false;
+	m_unsortedStateChanges = 0;
+	m_sortedStateChanges = 0;
+	m_visibleObjects = 0;
+	m_culledObjects = 0;
+	m_pOcclusionCuller = new OcclusionCuller();
+	m_occludedDraws = 0;
+	m_occludedObjects = 0;
+	m_levelIndices = 0;
+	m_fullDetailIndices = 0;
+	m_bUseIndirect = false;
+	m_pGPUCuller = NULL;
+	m_bUseGPUCulling = false;
+	m_indirectDrawCalls = 0;
+	m_indirectCommands = 0;
+	m_stressColumns = 1;
+	m_stressRows = 1;
+	m_stressSeed = 1;
+	m_packetFrameNumber = 0;
+	m_busyPacketWorkers = 0;
+	m_nextPacketChunk = 0;
+	m_bStoppingPacketWorkers = false;
+	m_bOccludersRendered = false;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_cameraPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	// the rendering thread generates packets next to the workers
+	int packetThreads = (int)std::thread::hardware_concurrency();
+	if (packetThreads > g_MaxPacketThreads)
+	{
+		packetThreads = g_MaxPacketThreads;
+	}
+	if (packetThreads < 1)
+	{
+		packetThreads = 1;
+	}
+	m_packetResults.resize(packetThreads);
+	for (int i = 1; i < packetThreads; i++)
+	{
+		m_packetWorkers.push_back(std::thread(&SceneManager::GeneratePacketFrames, this, i));
+	}
 }
 
 /***********************************************************
@@ -149,1134 +444,2708 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
+	{
+		std::lock_guard<std::mutex> lock(m_packetMutex);
+		m_bStoppingPacketWorkers = true;
+	}
+	m_packetFrameReady.notify_all();
+
+	for (size_t i = 0; i < m_packetWorkers.size(); i++)
+	{
+		m_packetWorkers[i].join();
+	}
+
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
+	m_pUniformCache = NULL;
+	if (0 != m_materialBuffer)
+	{
+		glDeleteBuffers(1, &m_materialBuffer);
+		m_materialBuffer = 0;
+	}
+	if (0 != m_lightBuffer)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		m_lightBuffer = 0;
+	}
+	// stop the loading before freeing the textures
+	delete m_pTextureLoader;
+	m_pTextureLoader = NULL;
+	DestroyGLTextures();
+	delete m_instancedMeshes;
+	m_instancedMeshes = NULL;
+	delete m_pOcclusionCuller;
+	m_pOcclusionCuller = NULL;
+	delete m_pGPUCuller;
+	m_pGPUCuller = NULL;
 }
 
 /***********************************************************
- *  CreateGLTexture()
+ *  ResolveShaderUniforms()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for resolving the uniforms that are
+ *  set for every draw into location handles, so that the
+ *  rendering code never has to look them up by name.
  ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+void SceneManager::ResolveShaderUniforms()
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+	m_pUniformCache = UniformCache::ForCurrentProgram();
+
+	m_uniforms.model = m_pUniformCache->Resolve(g_ModelName);
+	m_uniforms.objectColor = m_pUniformCache->Resolve(g_ColorValueName);
+	m_uniforms.objectTexture = m_pUniformCache->Resolve(g_TextureValueName);
+	m_uniforms.objectTextureArray = m_pUniformCache->Resolve(g_TextureArrayName);
+	m_uniforms.textureLayer = m_pUniformCache->Resolve(g_TextureLayerName);
+	m_uniforms.useTexture = m_pUniformCache->Resolve(g_UseTextureName);
+	m_uniforms.UVscale = m_pUniformCache->Resolve("UVscale");
+	m_uniforms.materialIndex = m_pUniformCache->Resolve(g_MaterialIndexName);
+	m_uniforms.useInstancing = m_pUniformCache->Resolve(g_UseInstancingName);
+}
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method is used for uploading all the defined object
+ *  materials into a std140 uniform buffer one time, so that
+ *  each draw only has to select its material by index.
+ ***********************************************************/
+void SceneManager::CreateMaterialBuffer()
+{
+	std::vector<MATERIAL_BLOCK_ENTRY> entries(g_MaxMaterials);
 
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+	if (m_objectMaterials.size() > (size_t)g_MaxMaterials)
+	{
+		std::cout << "Too many object materials for the material buffer:" << m_objectMaterials.size() << std::endl;
+	}
 
-	// if the image was successfully read from the image file
-	if (image)
+	for (int i = 0; (i < (int)m_objectMaterials.size()) && (i < g_MaxMaterials); i++)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		entries[i].ambient = glm::vec4(m_objectMaterials[i].ambientColor, m_objectMaterials[i].ambientStrength);
+		entries[i].diffuse = glm::vec4(m_objectMaterials[i].diffuseColor, 1.0f);
+		entries[i].specular = glm::vec4(m_objectMaterials[i].specularColor, m_objectMaterials[i].shininess);
+	}
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	glGenBuffers(1, &m_materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, entries.size() * sizeof(MATERIAL_BLOCK_ENTRY), entries.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// connect the shader uniform block to the buffer binding point
+	GLuint programID = m_pUniformCache->GetProgramID();
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_MaterialBlockName);
+	if (GL_INVALID_INDEX != blockIndex)
+	{
+		glUniformBlockBinding(programID, blockIndex, g_MaterialBlockBinding);
+	}
+	else
+	{
+		std::cout << "Uniform block not found in shader program:" << g_MaterialBlockName << std::endl;
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_MaterialBlockBinding, m_materialBuffer);
+}
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
+/***********************************************************
+ *  CreateLightBuffer()
+ *
+ *  This method is used for uploading all the defined light
+ *  sources into a std140 uniform buffer one time.
+ ***********************************************************/
+void SceneManager::CreateLightBuffer()
+{
+	LIGHT_BLOCK block = {};
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+	if (m_lightSources.size() > (size_t)g_MaxLights)
+	{
+		std::cout << "Too many light sources for the light buffer:" << m_lightSources.size() << std::endl;
+	}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+	block.lightCount = 0;
+	for (int i = 0; (i < (int)m_lightSources.size()) && (i < g_MaxLights); i++)
+	{
+		block.lights[i].position = glm::vec4(m_lightSources[i].position, m_lightSources[i].focalStrength);
+		block.lights[i].ambientColor = glm::vec4(m_lightSources[i].ambientColor, 1.0f);
+		block.lights[i].diffuseColor = glm::vec4(m_lightSources[i].diffuseColor, 1.0f);
+		block.lights[i].specularColor = glm::vec4(m_lightSources[i].specularColor, m_lightSources[i].specularIntensity);
+		block.lightCount++;
+	}
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	glGenBuffers(1, &m_lightBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_BLOCK), &block, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-		return true;
+	// connect the shader uniform block to the buffer binding point
+	GLuint programID = m_pUniformCache->GetProgramID();
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_LightBlockName);
+	if (GL_INVALID_INDEX != blockIndex)
+	{
+		glUniformBlockBinding(programID, blockIndex, g_LightBlockBinding);
 	}
+	else
+	{
+		std::cout << "Uniform block not found in shader program:" << g_LightBlockName << std::endl;
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_LightBlockBinding, m_lightBuffer);
 
-	std::cout << "Could not load image:" << filename << std::endl;
-
-	// Error loading the image
-	return false;
+	// Enable lighting in the shader
+	m_pUniformCache->SetBoolValue(m_pUniformCache->Resolve(g_UseLightingName), true);
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  CreateGLTexture()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for queueing a texture image file to
+ *  be decoded on a worker thread. The texture handle is
+ *  ready right away, and the texture is drawn with the
+ *  placeholder texture until UpdateGLTextures() has uploaded
+ *  the decoded image.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+bool SceneManager::CreateGLTexture(const char* filename, const std::string& tag)
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	TEXTURE_INFO texture;
+
+	if (NULL == m_pTextureLoader)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		m_pTextureLoader = new TextureLoader();
+		CreatePlaceholderTexture();
 	}
+
+	texture.ID = m_placeholderTexture;
+	texture.bHasAlpha = false;
+	texture.unit = g_PlaceholderUnit;
+	texture.layer = -1;
+
+	// register the texture and intern the special tag string into
+	// the texture handle, which is the texture slot index
+	m_textureIDs.push_back(texture);
+	m_textureHandles[tag] = m_loadedTextures;
+#ifdef _DEBUG
+	m_textureNames.push_back(tag);
+#endif
+	m_pTextureLoader->RequestImage(m_loadedTextures, filename);
+	m_loadedTextures++;
+
+	return true;
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  CreatePlaceholderTexture()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for creating the single pixel texture
+ *  that is drawn while the texture images are loading.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+void SceneManager::CreatePlaceholderTexture()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	const unsigned char greyPixel[4] = { 128, 128, 128, 255 };
+
+	glGenTextures(1, &m_placeholderTexture);
+	GLStateCache::BindTexture(g_PlaceholderUnit, GL_TEXTURE_2D, m_placeholderTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, greyPixel);
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  CreateGLTextureArray()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for allocating the texture array the
+ *  first time that a same-size image is uploaded. The image
+ *  sizes are not known before decoding, so the array gets a
+ *  layer for every requested texture. The array takes the
+ *  format of the first image - the block format and mip
+ *  chain of a cached texture, or plain RGB with a full mip
+ *  chain that is generated from the uploaded layers.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::CreateGLTextureArray(const TextureLoader::DECODED_IMAGE& image)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	if (0 != m_textureArray)
+	{
+		return;
+	}
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	m_textureArrayCapacity = m_loadedTextures;
+	if (m_textureArrayCapacity > g_MaxTextureArrayLayers)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		m_textureArrayCapacity = g_MaxTextureArrayLayers;
 	}
 
-	return(textureID);
-}
+	glGenTextures(1, &m_textureArray);
+	GLStateCache::BindTexture(g_TextureArrayUnit, GL_TEXTURE_2D_ARRAY, m_textureArray);
 
-/***********************************************************
- *  FindTextureSlot()
- *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
- ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
-{
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (NULL != image.pCached)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		const std::vector<TextureCache::MIP_LEVEL>& levels = image.pCached->levels;
+
+		m_textureArrayFormat = image.pCached->format;
+		m_textureArrayLevels = (int)levels.size();
+		for (int level = 0; level < m_textureArrayLevels; level++)
 		{
-			textureSlot = index;
-			bFound = true;
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, m_textureArrayFormat,
+				levels[level].width, levels[level].height, m_textureArrayCapacity, 0,
+				(GLsizei)(levels[level].size * m_textureArrayCapacity), NULL);
 		}
-		else
-			index++;
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_textureArrayLevels - 1);
 	}
+	else
+	{
+		// uncompressed layers only upload their first level, and
+		// the smaller levels are generated after the uploads
+		int levelSize = g_TextureArraySize;
 
-	return(textureSlot);
+		m_textureArrayFormat = GL_RGB8;
+		m_textureArrayLevels = 0;
+		while (true)
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, m_textureArrayLevels, GL_RGB8, levelSize, levelSize,
+				m_textureArrayCapacity, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+			m_textureArrayLevels++;
+			if (levelSize == 1)
+			{
+				break;
+			}
+			levelSize = levelSize / 2;
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_textureArrayLevels - 1);
+	}
+
+	std::cout << "Created texture array with " << m_textureArrayCapacity << " layers" << std::endl;
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  UpdateGLTextures()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for uploading the texture images that
+ *  the worker threads have decoded. While rendering, only a
+ *  few images are uploaded per frame to keep the frames
+ *  smooth - passing true waits for and uploads all of them.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+int SceneManager::UpdateGLTextures(bool bWaitForAll)
 {
-	if (m_objectMaterials.size() == 0)
+	int changedCount = 0;
+	TextureLoader::DECODED_IMAGE image;
+
+	if ((NULL == m_pTextureLoader) || (m_pTextureLoader->GetPendingCount() == 0))
 	{
-		return(false);
+		return(0);
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	while ((bWaitForAll) || (changedCount < g_MaxTextureUploadsPerFrame))
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		bool bFetched = bWaitForAll ?
+			m_pTextureLoader->WaitDecodedImage(image) :
+			m_pTextureLoader->FetchDecodedImage(image);
+		if (bFetched == false)
 		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			break;
 		}
-		else
+		if (UploadGLTexture(image))
 		{
-			index++;
+			changedCount++;
 		}
 	}
 
-	return(true);
+	// the mipmaps of the uncompressed texture array are generated
+	// one time for all the layers uploaded in this frame
+	if (m_bTextureArrayMipmaps)
+	{
+		GLStateCache::BindTexture(g_TextureArrayUnit, GL_TEXTURE_2D_ARRAY, m_textureArray);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		m_bTextureArrayMipmaps = false;
+	}
+
+	// the texture layers and transparency are baked into the
+	// draw packets and instance values
+	if (changedCount > 0)
+	{
+		m_bSceneDirty = true;
+	}
+
+	return(changedCount);
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  WaitForTextures()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for waiting until all the queued
+ *  texture images are decoded and uploaded.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::WaitForTextures()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	UpdateGLTextures(true);
+}
 
-	if (NULL != m_pShaderManager)
+/***********************************************************
+ *  HasSceneChanges()
+ *
+ *  This method is used for finding out whether the next frame
+ *  would draw the scene differently from the last one, which
+ *  is when the scene objects changed or decoded texture
+ *  images are waiting for their upload.
+ ***********************************************************/
+bool SceneManager::HasSceneChanges()
+{
+	if (m_bSceneDirty)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		return(true);
 	}
+
+	return((NULL != m_pTextureLoader) && (m_pTextureLoader->GetReadyCount() > 0));
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  UploadGLTexture()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for uploading one decoded image into
+ *  OpenGL texture data through a pixel buffer object. A
+ *  cached texture uploads its compressed mip chain as it is,
+ *  while plain pixels get their mipmaps generated. RGB
+ *  images of the texture array size become a layer of the
+ *  texture array - every other image gets its own texture
+ *  and texture unit. The decode and upload times are
+ *  written to the console.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+bool SceneManager::UploadGLTexture(TextureLoader::DECODED_IMAGE& image)
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	TEXTURE_INFO& texture = m_textureIDs[image.handle];
+	GLuint textureID = 0;
+	GLenum imageFormat = GL_RGB8;
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	if ((NULL == image.pixels) && (NULL == image.pCached) && (image.uploadBuffer < 0))
+	{
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		return false;
+	}
+	if ((image.colorChannels != 3) && (image.colorChannels != 4))
+	{
+		std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+		m_pTextureLoader->FreeImage(image);
+		return false;
+	}
+
+	if (NULL != image.pCached)
+	{
+		imageFormat = image.pCached->format;
+	}
 
-	if (NULL != m_pShaderManager)
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// same-size RGB images share the texture array while it still
+	// has free layers and they match its format
+	if ((image.width == g_TextureArraySize) && (image.height == g_TextureArraySize) &&
+		(image.colorChannels == 3) &&
+		((0 == m_textureArray) ||
+		((m_textureArrayLayers < m_textureArrayCapacity) && (m_textureArrayFormat == imageFormat) &&
+		((NULL == image.pCached) || ((int)image.pCached->levels.size() == m_textureArrayLevels)))))
+	{
+		CreateGLTextureArray(image);
+
+		texture.ID = m_textureArray;
+		texture.unit = g_TextureArrayUnit;
+		texture.layer = m_textureArrayLayers;
+		m_textureArrayLayers++;
+
+		GLStateCache::BindTexture(g_TextureArrayUnit, GL_TEXTURE_2D_ARRAY, m_textureArray);
+		m_pTextureLoader->BeginUpload(image);
+		if (NULL != image.pCached)
+		{
+			const std::vector<TextureCache::MIP_LEVEL>& levels = image.pCached->levels;
+			for (size_t level = 0; level < levels.size(); level++)
+			{
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, texture.layer,
+					levels[level].width, levels[level].height, 1, imageFormat,
+					(GLsizei)levels[level].size, (void*)levels[level].offset);
+			}
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, texture.layer, image.width, image.height, 1,
+				GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+			m_bTextureArrayMipmaps = true;
+		}
+		m_pTextureLoader->EndUpload();
+	}
+	else
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		// every other image needs a texture unit of its own
+		if (g_PlaceholderUnit + 1 + m_textureUnits >= g_MaxTextureUnits)
+		{
+			std::cout << "No texture unit is left for image:" << image.filename << std::endl;
+			m_pTextureLoader->FreeImage(image);
+			return false;
+		}
+
+		glGenTextures(1, &textureID);
+		texture.ID = textureID;
+		texture.unit = g_PlaceholderUnit + 1 + m_textureUnits;
+		texture.layer = -1;
+		m_textureUnits++;
+
+		GLStateCache::BindTexture(texture.unit, GL_TEXTURE_2D, textureID);
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		m_pTextureLoader->BeginUpload(image);
+		if (NULL != image.pCached)
+		{
+			// the cached mip chain replaces the generated mipmaps
+			const std::vector<TextureCache::MIP_LEVEL>& levels = image.pCached->levels;
+			for (size_t level = 0; level < levels.size(); level++)
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, imageFormat,
+					levels[level].width, levels[level].height, 0,
+					(GLsizei)levels[level].size, (void*)levels[level].offset);
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+			m_pTextureLoader->EndUpload();
+		}
+		else
+		{
+			// if the loaded image is in RGB format
+			if (image.colorChannels == 3)
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+			// if the loaded image is in RGBA format - it supports transparency
+			else
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+			m_pTextureLoader->EndUpload();
+
+			// generate the texture mipmaps for mapping textures to lower resolutions
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
 	}
+	texture.bHasAlpha = (image.colorChannels == 4);
+
+	double uploadMs = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width
+		<< ", height:" << image.height << ", channels:" << image.colorChannels
+		<< (image.bFromCache ? ", cache:" : ", decode:") << image.decodeMs
+		<< "ms, upload:" << uploadMs << "ms" << std::endl;
+
+	// free the image data from local memory
+	m_pTextureLoader->FreeImage(image);
+
+	return true;
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  BindGLTextures()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for binding the loaded textures to
+ *  OpenGL texture memory slots.  The texture array and the
+ *  placeholder take the first two slots and the other
+ *  textures use up to 14 more.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::BindGLTextures()
 {
-	if (NULL != m_pShaderManager)
+	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		// bind textures on corresponding texture units
+		if (m_textureIDs[i].layer >= 0)
+		{
+			GLStateCache::BindTexture(g_TextureArrayUnit, GL_TEXTURE_2D_ARRAY, m_textureIDs[i].ID);
+		}
+		else
+		{
+			GLStateCache::BindTexture(m_textureIDs[i].unit, GL_TEXTURE_2D, m_textureIDs[i].ID);
+		}
+#ifdef _DEBUG
+		std::cout << "Bound texture:" << GetTextureName(i) << " to slot:" << m_textureIDs[i].unit
+			<< " layer:" << m_textureIDs[i].layer << std::endl;
+#endif
+	}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetSampler2DValue(m_uniforms.objectTextureArray, g_TextureArrayUnit);
 	}
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  DestroyGLTextures()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for freeing the memory in all the
+ *  used texture memory slots.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::DestroyGLTextures()
 {
-	if (NULL != m_pShaderManager)
+	for (int i = 0; i < m_loadedTextures; i++)
+	{
+		if ((m_textureIDs[i].layer < 0) && (m_textureIDs[i].ID != m_placeholderTexture))
+		{
+			glDeleteTextures(1, &m_textureIDs[i].ID);
+		}
+	}
+	if (0 != m_textureArray)
+	{
+		glDeleteTextures(1, &m_textureArray);
+		m_textureArray = 0;
+	}
+	if (0 != m_placeholderTexture)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		glDeleteTextures(1, &m_placeholderTexture);
+		m_placeholderTexture = 0;
 	}
+	m_textureIDs.clear();
+	m_loadedTextures = 0;
+	m_textureUnits = 0;
+	m_textureArrayCapacity = 0;
+	m_textureArrayLayers = 0;
+	m_bTextureArrayMipmaps = false;
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  FindTextureID()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+int SceneManager::FindTextureID(const std::string& tag)
 {
-	if (m_objectMaterials.size() > 0)
-	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+	int textureID = -1;
+	int textureSlot = FindTextureSlot(tag);
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+	if (textureSlot >= 0)
+	{
+		textureID = m_textureIDs[textureSlot].ID;
 	}
+
+	return(textureID);
 }
 
-/**************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
-/*** preparing and rendering their own 3D replicated scenes.***/
-/*** Please refer to the code in the OpenGL sample project  ***/
-/*** for assistance.                                        ***/
-/**************************************************************/
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag. The
+ *  slot index is also the texture handle used when rendering.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(const std::string& tag)
+{
+	int textureSlot = -1;
+
+	std::unordered_map<std::string, int>::const_iterator it = m_textureHandles.find(tag);
+	if (it != m_textureHandles.end())
+	{
+		textureSlot = it->second;
+	}
+#ifdef _DEBUG
+	else
+	{
+		std::cout << "Texture tag was never loaded:" << tag << std::endl;
+	}
+#endif
 
+	return(textureSlot);
+}
 
 /***********************************************************
- *  PrepareScene()
+ *  FindMaterialIndex()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene
- *  rendering
+ *  This method is used for getting the index of a material in
+ *  the previously defined materials list that is associated
+ *  with the passed in tag. The index is the material handle
+ *  used when rendering and selects the material in the
+ *  material uniform buffer.
  ***********************************************************/
-void SceneManager::PrepareScene()
+int SceneManager::FindMaterialIndex(const std::string& tag)
 {
-	// Only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
+	int materialIndex = -1;
 
-	// Load all mesh types used in the scene
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadPrismMesh();
-
-	// Load textures for the scene
-	// These textures are used to create detailed appearances on 3D objects
-	CreateGLTexture("textures/plantBox.jpg", "plantBox");     // Texture for plant pot
-	CreateGLTexture("textures/plantStem.jpg", "plantStem");   // Texture for plant stem
-	CreateGLTexture("textures/plantLeaf.png", "plantLeaf");   // Texture for plant leaves
-	CreateGLTexture("textures/Wood/Wood069_1K-JPG_Color.jpg", "woodDesk");     // Texture for desk surface
-	CreateGLTexture("textures/Wallpaper/Wallpaper001B_1K-JPG_Color.jpg", "wallpaper");  // Texture for walls
-	CreateGLTexture("textures/Tiles/Tiles081_1K-JPG_Color.jpg", "floorTiles");  // Texture for floor
-	CreateGLTexture("textures/Clay/RoofingTiles015C_1K-JPG_Color.jpg", "clay");  // Texture for ceramic objects
+	std::unordered_map<std::string, int>::const_iterator it = m_materialHandles.find(tag);
+	if (it != m_materialHandles.end())
+	{
+		materialIndex = it->second;
+	}
+#ifdef _DEBUG
+	else
+	{
+		std::cout << "Material tag was never defined:" << tag << std::endl;
+	}
+#endif
 
-	// Bind all loaded textures to OpenGL texture memory slots
-	BindGLTextures();
+	return(materialIndex);
+}
 
-	// Define materials for objects to control lighting interaction
-	// Using helper function from anonymous namespace - no header changes needed
-	DefineObjectMaterials(this, m_objectMaterials);
+/***********************************************************
+ *  InternMaterialTags()
+ *
+ *  This method is used for interning the tags of all the
+ *  defined materials into integer material handles.
+ ***********************************************************/
+void SceneManager::InternMaterialTags()
+{
+	m_materialHandles.clear();
+#ifdef _DEBUG
+	m_materialNames.clear();
+#endif
 
-	// Configure lighting for the scene
-	// Using helper function from anonymous namespace - no header changes needed
-	SetupSceneLights(m_pShaderManager);
+	for (int index = 0; index < (int)m_objectMaterials.size(); index++)
+	{
+		m_materialHandles[m_objectMaterials[index].tag] = index;
+#ifdef _DEBUG
+		m_materialNames.push_back(m_objectMaterials[index].tag);
+#endif
+	}
 }
 
 /***********************************************************
- *  RenderScene()
+ *  GetMaterialName()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for getting the readable tag of a
+ *  material handle for logging. The names are only kept in
+ *  debug builds.
+ ***********************************************************/
+const char* SceneManager::GetMaterialName(int materialHandle) const
+{
+#ifdef _DEBUG
+	if ((materialHandle >= 0) && (materialHandle < (int)m_materialNames.size()))
+	{
+		return(m_materialNames[materialHandle].c_str());
+	}
+#else
+	(void)materialHandle;
+#endif
+	return("<material>");
+}
+
+/***********************************************************
+ *  GetTextureName()
  *
- *  TEXTURING IMPLEMENTATION:
- *  - Desk uses tiled wood texture (complex technique - Rubric #2)
- *  - Plant object uses 3 different textures on multiple shapes:
- *    * plantBox texture on box (pot)
- *    * plantStem texture on cylinder (stem)
- *    * plantLeaf texture on prisms (leaves)
- *    This demonstrates cohesive multi-texture object (Rubric #3)
+ *  This method is used for getting the readable tag of a
+ *  texture handle for logging. The names are only kept in
+ *  debug builds.
  ***********************************************************/
-void SceneManager::RenderScene()
+const char* SceneManager::GetTextureName(int textureHandle) const
 {
-	// Declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// FLOOR - Using plane for the floor with tile texture
-	scaleXYZ = glm::vec3(50.0f, 1.0f, 50.0f);
+#ifdef _DEBUG
+	if ((textureHandle >= 0) && (textureHandle < (int)m_textureNames.size()))
+	{
+		return(m_textureNames[textureHandle].c_str());
+	}
+#else
+	(void)textureHandle;
+#endif
+	return("<texture>");
+}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  SetModelMatrix()
+ *
+ *  This method is used for setting the model matrix of the
+ *  next draw command into the shader.
+ ***********************************************************/
+void SceneManager::SetModelMatrix(
+	const glm::mat4& model)
+{
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetMat4Value(m_uniforms.model, model);
+	}
+}
 
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
 
-	SetShaderMaterial("ceramic");
-	SetShaderTexture("floorTiles");
-	SetTextureUVScale(15.0f, 15.0f);
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetIntValue(m_uniforms.useTexture, false);
+		m_pUniformCache->SetVec4Value(m_uniforms.objectColor, currentColor);
+	}
+}
 
-	m_basicMeshes->DrawPlaneMesh();
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in handle into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	int textureHandle)
+{
+	if ((NULL != m_pUniformCache) &&
+		(textureHandle >= 0) && (textureHandle < m_loadedTextures))
+	{
+		const TEXTURE_INFO& texture = m_textureIDs[textureHandle];
 
-	/****************************************************************/
-	// DESK TOP SURFACE - Main working surface
-	scaleXYZ = glm::vec3(16.0f, 0.4f, 8.0f);
+		m_pUniformCache->SetIntValue(m_uniforms.useTexture, true);
+		m_pUniformCache->SetIntValue(m_uniforms.textureLayer, texture.layer);
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		// layers of the texture array only need the layer index,
+		// other textures are sampled from their own slot
+		if (texture.layer < 0)
+		{
+			m_pUniformCache->SetSampler2DValue(m_uniforms.objectTexture, texture.unit);
+		}
+	}
+}
 
-	positionXYZ = glm::vec3(0.0f, 3.0f, 0.0f);
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetVec2Value(m_uniforms.UVscale, glm::vec2(u, v));
+	}
+}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the material values
+ *  in the shader material buffer.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	int materialHandle)
+{
+	// the material values already live in the material buffer,
+	// so only the index of the material is passed to the shader
+	if ((NULL != m_pUniformCache) &&
+		(materialHandle >= 0) && (materialHandle < (int)m_objectMaterials.size()))
+	{
+		m_pUniformCache->SetIntValue(m_uniforms.materialIndex, materialHandle);
+	}
+}
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("woodDesk");
-	SetTextureUVScale(3.0f, 2.0f);
+/***********************************************************
+ *  DrawInstanceGroup()
+ *
+ *  This method is used for drawing a group of instanced
+ *  objects with one draw call. The transformations, colors,
+ *  materials and UV scales come from the instance values,
+ *  so only the shared texture is set into the shader.
+ ***********************************************************/
+void SceneManager::DrawInstanceGroup(
+	int groupHandle,
+	int textureHandle,
+	int level)
+{
+	if (NULL == m_pUniformCache)
+	{
+		return;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	// the texture layer is part of the instance values
+	if ((textureHandle >= 0) && (textureHandle < m_loadedTextures) &&
+		(m_textureIDs[textureHandle].layer < 0))
+	{
+		m_pUniformCache->SetSampler2DValue(m_uniforms.objectTexture, m_textureIDs[textureHandle].unit);
+	}
 
-	/****************************************************************/
-	// DESK LEG - Front Left
-	scaleXYZ = glm::vec3(0.6f, 3.0f, 0.6f);
+	m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, true);
+	m_instancedMeshes->DrawInstanceGroup(groupHandle, level);
+	m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, false);
+}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one basic shape mesh
+ *  with the values that are currently set in the shader.
+ *  The curved shapes can be drawn at a coarser tessellation
+ *  level.
+ ***********************************************************/
+void SceneManager::DrawMesh(SceneMeshes::MESH_TYPE mesh, int level)
+{
+	m_instancedMeshes->DrawMesh(mesh, level);
+}
 
-	positionXYZ = glm::vec3(-7.0f, 1.5f, 3.5f);
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  This method is used for adding an object to the retained
+ *  scene. Objects that share a batch number, a mesh and a
+ *  texture are drawn together with one instanced draw. An
+ *  unknown material handle is replaced by the first material.
+ ***********************************************************/
+int SceneManager::AddSceneObject(
+	SceneMeshes::MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	int materialHandle,
+	int textureHandle,
+	glm::vec4 color,
+	glm::vec2 UVscale,
+	int batch)
+{
+	// the handle is copied into the instance values, where it
+	// must select an entry of the material buffer
+	if ((materialHandle < 0) || (materialHandle >= (int)m_objectMaterials.size()) ||
+		(materialHandle >= g_MaxMaterials))
+	{
+		std::cout << "Scene object added with an unknown material handle:" << materialHandle << std::endl;
+		materialHandle = 0;
+	}
+
+	m_sceneObjects.mesh.push_back(mesh);
+	m_sceneObjects.material.push_back(materialHandle);
+	m_sceneObjects.texture.push_back(textureHandle);
+	m_sceneObjects.color.push_back(color);
+	m_sceneObjects.UVscale.push_back(UVscale);
+	m_sceneObjects.scale.push_back(scaleXYZ);
+	m_sceneObjects.rotation.push_back(glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees));
+	m_sceneObjects.position.push_back(positionXYZ);
+	m_sceneObjects.batch.push_back(batch);
+	m_sceneObjects.world.push_back(glm::mat4(1.0f));
+	m_sceneObjects.worldDirty.push_back(1);
+	m_sceneObjects.boundsMin.push_back(positionXYZ);
+	m_sceneObjects.boundsMax.push_back(positionXYZ);
+	m_sceneObjects.occluder.push_back(0);
+
+	m_bSceneDirty = true;
+
+	return(GetObjectCount() - 1);
+}
 
-	SetTransformations(
+/***********************************************************
+ *  AddTexturedObject()
+ *
+ *  This method is used for adding a textured object to the
+ *  retained scene. The tags are interned into handles here,
+ *  so rendering never has to search for them.
+ ***********************************************************/
+int SceneManager::AddTexturedObject(
+	SceneMeshes::MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	const std::string& materialTag,
+	const std::string& textureTag,
+	float u, float v,
+	int batch)
+{
+	return(AddSceneObject(
+		mesh,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderMaterial("wood");
-	SetShaderTexture("woodDesk");
-	SetTextureUVScale(1.0f, 2.0f);
-
-	m_basicMeshes->DrawBoxMesh();
-
-	/****************************************************************/
-	// DESK LEG - Front Right
-	scaleXYZ = glm::vec3(0.6f, 3.0f, 0.6f);
-
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(7.0f, 1.5f, 3.5f);
+		positionXYZ,
+		FindMaterialIndex(materialTag),
+		FindTextureSlot(textureTag),
+		glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+		glm::vec2(u, v),
+		batch));
+}
 
-	SetTransformations(
+/***********************************************************
+ *  AddColoredObject()
+ *
+ *  This method is used for adding a flat colored object to
+ *  the retained scene.
+ ***********************************************************/
+int SceneManager::AddColoredObject(
+	SceneMeshes::MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	const std::string& materialTag,
+	glm::vec4 color,
+	int batch)
+{
+	return(AddSceneObject(
+		mesh,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderMaterial("wood");
-	SetShaderTexture("woodDesk");
-	SetTextureUVScale(1.0f, 2.0f);
-
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		FindMaterialIndex(materialTag),
+		-1,
+		color,
+		glm::vec2(1.0f, 1.0f),
+		batch));
+}
 
-	/****************************************************************/
-	// DESK LEG - Back Left
-	scaleXYZ = glm::vec3(0.6f, 3.0f, 0.6f);
+/***********************************************************
+ *  SetObjectTransform()
+ *
+ *  This method is used for changing the transformation of a
+ *  retained scene object. The draw packets are compiled
+ *  again before the next frame is rendered.
+ ***********************************************************/
+void SceneManager::SetObjectTransform(
+	int objectIndex,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	if ((objectIndex < 0) || (objectIndex >= GetObjectCount()))
+	{
+		return;
+	}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	m_sceneObjects.scale[objectIndex] = scaleXYZ;
+	m_sceneObjects.rotation[objectIndex] = glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees);
+	m_sceneObjects.position[objectIndex] = positionXYZ;
+	m_sceneObjects.worldDirty[objectIndex] = 1;
 
-	positionXYZ = glm::vec3(-7.0f, 1.5f, -3.5f);
+	m_bSceneDirty = true;
+}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  SetObjectOccluder()
+ *
+ *  This method is used for marking a retained scene object
+ *  as an occluder. Only box objects can be occluders, since
+ *  the occlusion culler rasterizes the box of the object.
+ ***********************************************************/
+void SceneManager::SetObjectOccluder(int objectIndex, bool bOccluder)
+{
+	if ((objectIndex < 0) || (objectIndex >= GetObjectCount()))
+	{
+		return;
+	}
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("woodDesk");
-	SetTextureUVScale(1.0f, 2.0f);
+	if ((bOccluder) && (m_sceneObjects.mesh[objectIndex] != SceneMeshes::MESH_BOX))
+	{
+		std::cout << "Scene object " << objectIndex << " is not a box and cannot be an occluder" << std::endl;
+		return;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	m_sceneObjects.occluder[objectIndex] = bOccluder ? 1 : 0;
+	m_bSceneDirty = true;
+}
 
-	/****************************************************************/
-	// DESK LEG - Back Right
-	scaleXYZ = glm::vec3(0.6f, 3.0f, 0.6f);
+/***********************************************************
+ *  UpdateWorldMatrices()
+ *
+ *  This method is used for building the cached model matrix
+ *  and world-space bounding box of every scene object whose
+ *  transformation changed since the last update. The number
+ *  of rebuilt matrices is returned.
+ ***********************************************************/
+int SceneManager::UpdateWorldMatrices()
+{
+	int updatedCount = 0;
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	for (int i = 0; i < GetObjectCount(); i++)
+	{
+		if (m_sceneObjects.worldDirty[i] == 0)
+		{
+			continue;
+		}
 
-	positionXYZ = glm::vec3(7.0f, 1.5f, -3.5f);
+		m_sceneObjects.world[i] = BuildModelMatrix(
+			m_sceneObjects.scale[i],
+			m_sceneObjects.rotation[i].x,
+			m_sceneObjects.rotation[i].y,
+			m_sceneObjects.rotation[i].z,
+			m_sceneObjects.position[i]);
+		m_sceneObjects.worldDirty[i] = 0;
+
+		glm::vec3 localMin;
+		glm::vec3 localMax;
+		SceneMeshes::GetMeshBounds(m_sceneObjects.mesh[i], localMin, localMax);
+		FrustumCuller::TransformBounds(m_sceneObjects.world[i], localMin, localMax,
+			m_sceneObjects.boundsMin[i], m_sceneObjects.boundsMax[i]);
+		updatedCount++;
+
+		// objects already in the hierarchy only refit their boxes
+		if (i < m_objectBVH.GetPrimitiveCount())
+		{
+			m_movedObjects.push_back(i);
+		}
+	}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	return(updatedCount);
+}
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("woodDesk");
-	SetTextureUVScale(1.0f, 2.0f);
+/***********************************************************
+ *  BenchmarkModelMatrices()
+ *
+ *  This method is used for timing the fused model matrix
+ *  builder against the chain of matrix multiplies that it
+ *  replaced, and for checking that both give the same
+ *  matrices. The results are written to the console.
+ ***********************************************************/
+void SceneManager::BenchmarkModelMatrices(int transformCount)
+{
+	std::vector<glm::vec3> scales(transformCount);
+	std::vector<glm::vec3> rotations(transformCount);
+	std::vector<glm::vec3> positions(transformCount);
+	std::vector<glm::mat4> multiplied(transformCount);
+	std::vector<glm::mat4> fused(transformCount);
+
+	// repeatable pseudo-random transformations
+	unsigned int seed = 12345;
+	for (int i = 0; i < transformCount; i++)
+	{
+		float values[9];
+		for (int j = 0; j < 9; j++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			values[j] = (float)(seed >> 8) / (float)(1 << 24);
+		}
+		scales[i] = glm::vec3(values[0], values[1], values[2]) * 4.0f + 0.1f;
+		rotations[i] = glm::vec3(values[3], values[4], values[5]) * 360.0f - 180.0f;
+		positions[i] = glm::vec3(values[6], values[7], values[8]) * 20.0f - 10.0f;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < transformCount; i++)
+	{
+		multiplied[i] = MultiplyModelMatrix(scales[i], rotations[i].x, rotations[i].y, rotations[i].z, positions[i]);
+	}
+	std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+	for (int i = 0; i < transformCount; i++)
+	{
+		fused[i] = BuildModelMatrix(scales[i], rotations[i].x, rotations[i].y, rotations[i].z, positions[i]);
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 
-	/****************************************************************/
+	float maxError = 0.0f;
+	for (int i = 0; i < transformCount; i++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			glm::vec4 difference = glm::abs(multiplied[i][column] - fused[i][column]);
+			maxError = glm::max(maxError, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+		}
+	}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// BACK WALL - Using wallpaper texture
+	double multipliedMs = std::chrono::duration<double, std::milli>(middle - start).count();
+	double fusedMs = std::chrono::duration<double, std::milli>(end - middle).count();
 
-	scaleXYZ = glm::vec3(50.0f, 20.0f, 0.3f);
+	std::cout << "Model matrices for " << transformCount << " transforms - multiplied:" << multipliedMs
+		<< "ms, fused:" << fusedMs << "ms, speedup:" << (multipliedMs / fusedMs)
+		<< "x, max difference:" << maxError << std::endl;
+}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  CompileScene()
+ *
+ *  This method is used for compiling the retained scene
+ *  objects into a flat array of draw packets. Only the model
+ *  matrices of the objects that were moved are built again,
+ *  and each batch of repeated objects becomes one instance
+ *  group with a single packet.
+ ***********************************************************/
+void SceneManager::CompileScene()
+{
+	// packet index and instance values of every batch
+	std::vector<int> batchPackets;
+	std::vector<std::vector<SceneMeshes::INSTANCE_DATA> > batchInstances;
 
-	positionXYZ = glm::vec3(0.0f, 10.0f, -15.0f);
+	m_drawPackets.clear();
+	m_packetInstances.clear();
+	m_objectPackets.resize(GetObjectCount());
+	UpdateWorldMatrices();
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	for (int i = 0; i < GetObjectCount(); i++)
+	{
+		DRAW_PACKET packet;
+		int batch = m_sceneObjects.batch[i];
+
+		packet.model = m_sceneObjects.world[i];
+		packet.color = m_sceneObjects.color[i];
+		packet.UVscale = m_sceneObjects.UVscale[i];
+		packet.mesh = m_sceneObjects.mesh[i];
+		packet.material = m_sceneObjects.material[i];
+		packet.texture = m_sceneObjects.texture[i];
+		packet.instanceGroup = -1;
+		packet.firstInstance = 0;
+		packet.center = glm::vec3(packet.model[3]);
+		packet.boundsMin = m_sceneObjects.boundsMin[i];
+		packet.boundsMax = m_sceneObjects.boundsMax[i];
+		packet.objectCount = 1;
+		packet.bTransparent = (packet.color.a < 1.0f) ||
+			((packet.texture >= 0) && m_textureIDs[packet.texture].bHasAlpha);
+
+		if (batch >= (int)batchPackets.size())
+		{
+			batchPackets.resize(batch + 1, -1);
+			batchInstances.resize(batch + 1);
+		}
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("wallpaper");
-	SetTextureUVScale(10.0f, 8.0f);
+		// the first object of a batch holds the packet for the whole
+		// batch - objects that cannot share it are drawn on their own,
+		// and the batch is drawn in the pass of its first object
+		if ((batch >= 0) && (batchPackets[batch] >= 0))
+		{
+			const DRAW_PACKET& batchPacket = m_drawPackets[batchPackets[batch]];
+			if ((batchPacket.mesh != packet.mesh) || (batchPacket.texture != packet.texture) ||
+				(batchPacket.bTransparent != packet.bTransparent))
+			{
+				std::cout << "Scene object " << i << " does not match the mesh, texture and transparency of batch " << batch << std::endl;
+				batch = -1;
+			}
+		}
+		else if ((batch >= 0) && (m_instancedMeshes->LoadMesh(packet.mesh) == false))
+		{
+			batch = -1;
+		}
 
-	m_basicMeshes->DrawBoxMesh();
+		if (batch < 0)
+		{
+			m_objectPackets[i] = (int)m_drawPackets.size();
+			m_drawPackets.push_back(packet);
+			continue;
+		}
 
-	/****************************************************************/
+		if (batchPackets[batch] < 0)
+		{
+			batchPackets[batch] = (int)m_drawPackets.size();
+			m_drawPackets.push_back(packet);
+		}
+		else
+		{
+			// the whole batch is culled or drawn together, so its
+			// box holds the boxes of all its objects
+			DRAW_PACKET& batchPacket = m_drawPackets[batchPackets[batch]];
+			batchPacket.boundsMin = glm::min(batchPacket.boundsMin, packet.boundsMin);
+			batchPacket.boundsMax = glm::max(batchPacket.boundsMax, packet.boundsMax);
+			batchPacket.objectCount++;
+		}
+		m_objectPackets[i] = batchPackets[batch];
+
+		SceneMeshes::INSTANCE_DATA instance;
+		instance.model = packet.model;
+		instance.color = packet.color;
+		instance.materialIndex = packet.material;
+		instance.useTexture = (packet.texture >= 0) ? 1 : 0;
+		instance.textureLayer = (packet.texture >= 0) ? m_textureIDs[packet.texture].layer : -1;
+		instance.UVscale = packet.UVscale;
+		batchInstances[batch].push_back(instance);
+	}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// LEFT SIDE WALL - Creating a corner room effect
+	// create the instance group of every batch - all the groups
+	// share one instance buffer
+	m_instancedMeshes->ClearInstanceGroups();
+	for (size_t batch = 0; batch < batchPackets.size(); batch++)
+	{
+		if (batchPackets[batch] < 0)
+		{
+			continue;
+		}
 
-	scaleXYZ = glm::vec3(0.3f, 20.0f, 30.0f);
+		DRAW_PACKET& packet = m_drawPackets[batchPackets[batch]];
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		// sort the whole batch by the center of its instances
+		glm::vec3 center(0.0f, 0.0f, 0.0f);
+		for (size_t i = 0; i < batchInstances[batch].size(); i++)
+		{
+			center += glm::vec3(batchInstances[batch][i].model[3]);
+		}
+		packet.center = center / (float)batchInstances[batch].size();
 
-	positionXYZ = glm::vec3(-25.0f, 10.0f, 0.0f);
+		packet.instanceGroup = m_instancedMeshes->CreateInstanceGroup(packet.mesh, batchInstances[batch]);
+	}
+	m_instancedMeshes->UploadInstanceGroups();
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// lay out the instance values of every packet one after the
+	// other for the indirect draw commands - a batch keeps the
+	// order of its instance group
+	if (m_bUseIndirect)
+	{
+		for (size_t i = 0; i < m_drawPackets.size(); i++)
+		{
+			DRAW_PACKET& packet = m_drawPackets[i];
+
+			packet.firstInstance = (int)m_packetInstances.size();
+			if (packet.instanceGroup < 0)
+			{
+				SceneMeshes::INSTANCE_DATA instance;
+				instance.model = packet.model;
+				instance.color = packet.color;
+				instance.materialIndex = packet.material;
+				instance.useTexture = (packet.texture >= 0) ? 1 : 0;
+				instance.textureLayer = (packet.texture >= 0) ? m_textureIDs[packet.texture].layer : -1;
+				instance.UVscale = packet.UVscale;
+				m_packetInstances.push_back(instance);
+			}
+		}
+		for (size_t batch = 0; batch < batchPackets.size(); batch++)
+		{
+			if (batchPackets[batch] >= 0)
+			{
+				DRAW_PACKET& packet = m_drawPackets[batchPackets[batch]];
+				packet.firstInstance = (int)m_packetInstances.size();
+				m_packetInstances.insert(m_packetInstances.end(),
+					batchInstances[batch].begin(), batchInstances[batch].end());
+			}
+		}
+		m_instancedMeshes->SetIndirectInstances(m_packetInstances);
+	}
+	BuildGPUPackets();
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("wallpaper");
-	SetTextureUVScale(8.0f, 8.0f);
+	m_bSceneDirty = false;
 
-	m_basicMeshes->DrawBoxMesh();
+	// every packet counts as visible until the first culling
+	m_packetBounds.Resize(m_drawPackets.size());
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		m_packetBounds.SetBox(i, m_drawPackets[i].boundsMin, m_drawPackets[i].boundsMax);
+	}
+	m_packetVisible.assign(m_drawPackets.size(), 1);
+	m_packetLevels.resize(m_drawPackets.size(), 0);
 
-	/****************************************************************/
+	// build the object hierarchy again when objects were added,
+	// otherwise only refit the boxes of the objects that moved
+	if (m_objectBVH.GetPrimitiveCount() != GetObjectCount())
+	{
+		m_objectBVH.Build(m_sceneObjects.boundsMin, m_sceneObjects.boundsMax);
+	}
+	else
+	{
+		for (size_t i = 0; i < m_movedObjects.size(); i++)
+		{
+			int object = m_movedObjects[i];
+			m_objectBVH.RefitPrimitive(object, m_sceneObjects.boundsMin[object], m_sceneObjects.boundsMax[object]);
+		}
+	}
+	m_movedObjects.clear();
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// RIGHT SIDE WALL - Completing the room
+	// remember the occluders and the packets that draw them,
+	// which are never tested against themselves
+	m_occluderObjects.clear();
+	m_packetOccluders.assign(m_drawPackets.size(), 0);
+	for (int i = 0; i < GetObjectCount(); i++)
+	{
+		if (m_sceneObjects.occluder[i] != 0)
+		{
+			m_occluderObjects.push_back(i);
+			m_packetOccluders[m_objectPackets[i]] = 1;
+		}
+	}
 
-	scaleXYZ = glm::vec3(0.3f, 20.0f, 30.0f);
+	// report how many state changes the packet order causes before
+	// sorting - the order of the compiled packets never changes
+	std::vector<uint64_t> compiledOrder(m_drawPackets.size());
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		compiledOrder[i] = i;
+	}
+	m_unsortedStateChanges = CountStateChanges(compiledOrder);
+	SortDrawPackets();
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	std::cout << "Compiled " << GetObjectCount() << " scene objects into " << m_drawPackets.size()
+		<< " draw packets, state changes unsorted:" << m_unsortedStateChanges
+		<< " sorted:" << m_sortedStateChanges << std::endl;
+}
 
-	positionXYZ = glm::vec3(25.0f, 10.0f, 0.0f);
+/***********************************************************
+ *  SetCameraView()
+ *
+ *  This method is used for passing the camera view of the
+ *  next frame to render, which the draw packets are sorted
+ *  by.
+ ***********************************************************/
+void SceneManager::SetCameraView(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& position)
+{
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_cameraPosition = position;
+}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  CullDrawPackets()
+ *
+ *  This method is used for finding the draw packets inside
+ *  of the camera view frustum, and for counting the objects
+ *  that are inside and outside of the view. Small scenes
+ *  test every packet box, and larger scenes walk the object
+ *  hierarchy so that whole groups of objects outside of the
+ *  view are skipped with one test. With GPU culling on, only
+ *  the packets left to the CPU are tested here.
+ ***********************************************************/
+void SceneManager::CullDrawPackets()
+{
+	m_frustumCuller.SetViewProjection(m_projectionMatrix * m_viewMatrix);
 
-	SetShaderMaterial("wood");
-	SetShaderTexture("wallpaper");
-	SetTextureUVScale(8.0f, 8.0f);
+	if (m_bUseGPUCulling)
+	{
+		// the culling shader draws the other packets, which are
+		// not counted here
+		m_frustumCuller.CullBoxes(m_cpuPacketBounds, m_cpuPacketVisible);
+		m_packetVisible.assign(m_drawPackets.size(), 0);
+		m_visibleObjects = 0;
+		m_culledObjects = 0;
+		for (size_t i = 0; i < m_cpuPackets.size(); i++)
+		{
+			m_packetVisible[m_cpuPackets[i]] = m_cpuPacketVisible[i];
+			if (m_cpuPacketVisible[i] != 0)
+			{
+				m_visibleObjects += m_drawPackets[m_cpuPackets[i]].objectCount;
+			}
+			else
+			{
+				m_culledObjects += m_drawPackets[m_cpuPackets[i]].objectCount;
+			}
+		}
+		return;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	if (GetObjectCount() >= g_MinHierarchyCullObjects)
+	{
+		// a packet is drawn when any of its objects is visible
+		m_objectBVH.QueryFrustum(m_frustumCuller, m_visibleObjectList);
+		m_packetVisible.assign(m_drawPackets.size(), 0);
+		for (size_t i = 0; i < m_visibleObjectList.size(); i++)
+		{
+			m_packetVisible[m_objectPackets[m_visibleObjectList[i]]] = 1;
+		}
+	}
+	else
+	{
+		m_frustumCuller.CullBoxes(m_packetBounds, m_packetVisible);
+	}
 
-	/****************************************************************/
+	m_visibleObjects = 0;
+	m_culledObjects = 0;
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		if (m_packetVisible[i] != 0)
+		{
+			m_visibleObjects += m_drawPackets[i].objectCount;
+		}
+		else
+		{
+			m_culledObjects += m_drawPackets[i].objectCount;
+		}
+	}
+}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// PICTURE FRAME ON BACK WALL - Adding decorative element
+/***********************************************************
+ *  RenderOccluders()
+ *
+ *  This method is used for rasterizing the occluder objects
+ *  whose boxes are inside of the view frustum into the depth
+ *  buffer of the occlusion culler. The frustum planes must
+ *  be set for the frame first.
+ ***********************************************************/
+bool SceneManager::RenderOccluders()
+{
+	if (m_occluderObjects.empty())
+	{
+		return(false);
+	}
 
-	// Picture frame - outer border
-	scaleXYZ = glm::vec3(5.0f, 3.5f, 0.2f);
+	// an occluder outside of the view covers nothing in it, which
+	// leaves only the occluders of the nearby rooms in big scenes
+	m_pOcclusionCuller->BeginFrame(m_projectionMatrix * m_viewMatrix);
+	for (size_t i = 0; i < m_occluderObjects.size(); i++)
+	{
+		int object = m_occluderObjects[i];
+		if (m_frustumCuller.TestBox(m_sceneObjects.boundsMin[object], m_sceneObjects.boundsMax[object]))
+		{
+			m_pOcclusionCuller->AddBoxOccluder(m_sceneObjects.world[object]);
+		}
+	}
+	m_pOcclusionCuller->RenderOccluders();
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	return(true);
+}
 
-	positionXYZ = glm::vec3(-10.0f, 12.0f, -14.7f);
+/***********************************************************
+ *  OcclusionCullDrawPackets()
+ *
+ *  This method is used for rasterizing the occluder objects
+ *  into the depth buffer of the occlusion culler, and for
+ *  hiding the packets left after frustum culling whose boxes
+ *  are completely behind them. Every hidden packet is one
+ *  draw call that is never issued.
+ ***********************************************************/
+void SceneManager::OcclusionCullDrawPackets()
+{
+	m_occludedDraws = 0;
+	m_occludedObjects = 0;
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	if (RenderOccluders() == false)
+	{
+		return;
+	}
 
-	SetShaderMaterial("wood");
-	SetShaderColor(0.2f, 0.15f, 0.1f, 1.0f);
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		if ((m_packetVisible[i] == 0) || (m_packetOccluders[i] != 0))
+		{
+			continue;
+		}
 
-	m_basicMeshes->DrawBoxMesh();
+		const DRAW_PACKET& packet = m_drawPackets[i];
+		if (m_pOcclusionCuller->TestBox(packet.boundsMin, packet.boundsMax) == false)
+		{
+			m_packetVisible[i] = 0;
+			m_occludedDraws++;
+			m_occludedObjects += packet.objectCount;
+		}
+	}
+	m_visibleObjects -= m_occludedObjects;
+}
 
-	/****************************************************************/
+/***********************************************************
+ *  SelectPacketLevels()
+ *
+ *  This method is used for picking the tessellation level of
+ *  every visible packet with a curved shape, from its size
+ *  projected to the viewport. The middle extent of the box
+ *  is used as the size, which is the width of the round part
+ *  for long thin shapes like pens as well as for flat ones.
+ *  The indices drawn at the picked levels are counted next
+ *  to the indices that full detail would need.
+ ***********************************************************/
+void SceneManager::SelectPacketLevels()
+{
+	// the projection scales a size at a distance of 1 from the
+	// camera into half the viewport height
+	float projectionScale = m_projectionMatrix[1][1];
+	bool bPerspective = (m_projectionMatrix[3][3] == 0.0f);
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// PICTURE FRAME - Inner picture area (background)
+	m_levelIndices = 0;
+	m_fullDetailIndices = 0;
 
-	scaleXYZ = glm::vec3(4.4f, 2.9f, 0.15f);
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		if (m_packetVisible[i] != 0)
+		{
+			SelectPacketLevel(i, projectionScale, bPerspective, m_levelIndices, m_fullDetailIndices);
+		}
+	}
+}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  SelectPacketLevel()
+ *
+ *  This method is used for picking the tessellation level of
+ *  one visible packet, when its shape has more than one, and
+ *  adding the indices drawn at the picked level and at full
+ *  detail to the passed in counts. Only the level of the
+ *  packet itself is written.
+ ***********************************************************/
+void SceneManager::SelectPacketLevel(
+	size_t packetIndex,
+	float projectionScale,
+	bool bPerspective,
+	int& levelIndices,
+	int& fullDetailIndices)
+{
+	const DRAW_PACKET& packet = m_drawPackets[packetIndex];
 
-	positionXYZ = glm::vec3(-10.0f, 12.0f, -14.55f);
+	if (m_instancedMeshes->GetLevelCount(packet.mesh) < 2)
+	{
+		return;
+	}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	glm::vec3 extent = packet.boundsMax - packet.boundsMin;
+	float middleExtent = glm::max(glm::min(extent.x, extent.y), glm::min(glm::max(extent.x, extent.y), extent.z));
+	float radius = middleExtent * 0.5f;
+	float screenSize = radius * projectionScale;
+	if (bPerspective)
+	{
+		screenSize /= glm::max(glm::length(packet.center - m_cameraPosition), radius);
+	}
 
-	SetShaderMaterial("ceramic");
-	SetShaderColor(0.95f, 0.92f, 0.88f, 1.0f);  // Light beige background
+	m_packetLevels[packetIndex] = SceneMeshes::SelectLevel(screenSize, m_packetLevels[packetIndex]);
+	levelIndices += m_instancedMeshes->GetIndexCount(packet.mesh, m_packetLevels[packetIndex]) * packet.objectCount;
+	fullDetailIndices += m_instancedMeshes->GetIndexCount(packet.mesh, 0) * packet.objectCount;
+}
 
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  RaycastObjects()
+ *
+ *  This method is used for finding the closest scene object
+ *  whose world-space box is hit by a ray, using the object
+ *  hierarchy. The object index is returned, or -1 when no
+ *  box is hit within the passed in distance.
+ ***********************************************************/
+int SceneManager::RaycastObjects(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	float& hitDistance) const
+{
+	return(m_objectBVH.QueryRay(origin, direction, maxDistance, hitDistance));
+}
 
-	/****************************************************************/
-	// ARTWORK - Mountain silhouette (bottom)
-	scaleXYZ = glm::vec3(3.8f, 0.8f, 0.12f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-10.0f, 11.0f, -14.5f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("ceramic");
-	SetShaderColor(0.25f, 0.35f, 0.45f, 1.0f);  // Dark blue mountains
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  FindObjectsInRadius()
+ *
+ *  This method is used for collecting the scene objects
+ *  whose world-space boxes touch a sphere, using the object
+ *  hierarchy. The number of found objects is returned.
+ ***********************************************************/
+int SceneManager::FindObjectsInRadius(
+	const glm::vec3& center,
+	float radius,
+	std::vector<int>& objects) const
+{
+	return(m_objectBVH.QueryRadius(center, radius, objects));
+}
 
-	// ARTWORK - Sun/Moon circle
-	scaleXYZ = glm::vec3(0.6f, 0.6f, 0.6f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-9.0f, 12.8f, -14.5f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("ceramic");
-	SetShaderColor(0.95f, 0.75f, 0.35f, 1.0f);  // Golden sun
-	m_basicMeshes->DrawSphereMesh();
+/***********************************************************
+ *  SortDrawPackets()
+ *
+ *  This method is used for building a 64-bit sort key for
+ *  every draw packet and radix sorting the keys. Opaque
+ *  packets are drawn first, roughly front to back so that
+ *  early depth rejection works, and then grouped by material,
+ *  texture and mesh so that the fewest states change between
+ *  draws. Transparent packets are drawn last, back to front.
+ ***********************************************************/
+void SceneManager::SortDrawPackets()
+{
+	m_sortKeys.clear();
 
-	// ARTWORK - Decorative accent (left)
-	scaleXYZ = glm::vec3(0.3f, 1.2f, 0.11f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 15.0f;
-	positionXYZ = glm::vec3(-12.0f, 12.0f, -14.48f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("ceramic");
-	SetShaderColor(0.45f, 0.55f, 0.35f, 1.0f);  // Green accent
-	m_basicMeshes->DrawBoxMesh();
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		// packets outside of the view are not submitted at all
+		if (m_packetVisible[i] != 0)
+		{
+			m_sortKeys.push_back(MakeSortKey(i));
+		}
+	}
 
-	/****************************************************************/
+	RadixSortKeys(m_sortKeys, m_sortScratch);
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// CUP OF PENS on left side of desk
+	m_sortedStateChanges = CountStateChanges(m_sortKeys);
+}
 
-	scaleXYZ = glm::vec3(0.4f, 0.7f, 0.4f);
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  This method is used for building the 64-bit sort key of
+ *  one draw packet for the camera of the frame. The level of
+ *  the packet must be picked first, since the key carries
+ *  it to the submission.
+ ***********************************************************/
+uint64_t SceneManager::MakeSortKey(size_t packetIndex) const
+{
+	const DRAW_PACKET& packet = m_drawPackets[packetIndex];
+	float depth = glm::length(packet.center - m_cameraPosition) / g_SortMaxDepth;
+	uint64_t key = 0;
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	depth = glm::clamp(depth, 0.0f, 0.999999f);
 
-	positionXYZ = glm::vec3(-5.5f, 3.2f, 2.0f);
+	if (packet.bTransparent == false)
+	{
+		uint64_t coarseDepth = (uint64_t)(depth * (1 << g_SortCoarseDepthBits));
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		key |= coarseDepth << g_SortCoarseDepthShift;
+		key |= (uint64_t)(packet.material & 0x3FF) << g_SortMaterialShift;
+		key |= (uint64_t)((packet.texture + 1) & 0xFFF) << g_SortTextureShift;
+		key |= (uint64_t)(packet.mesh & 0x3F) << g_SortMeshShift;
+	}
+	else
+	{
+		uint64_t fineDepth = (uint64_t)(depth * (1 << g_SortFineDepthBits));
+		uint64_t maxDepth = (1ull << g_SortFineDepthBits) - 1;
 
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.3f, 0.3f, 0.35f, 1.0f);  // Dark grey pen holder to distinguish from wall
+		key |= 1ull << g_SortPassShift;
+		key |= (maxDepth - fineDepth) << g_SortFineDepthShift;
+	}
+	key |= (uint64_t)(m_packetLevels[packetIndex] & g_SortLevelMask) << g_SortLevelShift;
+	key |= (uint64_t)packetIndex & g_SortIndexMask;
 
-	m_basicMeshes->DrawCylinderMesh();
+	return(key);
+}
 
-	/****************************************************************/
+/***********************************************************
+ *  GenerateDrawPackets()
+ *
+ *  This method is used for culling, picking the levels of and
+ *  keying the draw packets of big scenes. The object
+ *  hierarchy is walked here first, so whole rooms outside of
+ *  the view are skipped with one test as in CullDrawPackets(),
+ *  and only the packets of the objects that it finds are
+ *  shared out to the packet threads. The occluders are
+ *  rasterized before that, since every chunk tests its
+ *  packets against them. Each thread writes its keys and
+ *  counts into its own results, which are merged and sorted
+ *  here when all the chunks are done. The keys hold the
+ *  packet index, so the sorted order does not depend on
+ *  which thread took which chunk.
+ ***********************************************************/
+void SceneManager::GenerateDrawPackets()
+{
+	int frustumObjects = 0;
 
-	// Pen 1 - Light blue
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-5.3f, 3.9f, 2.1f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.408f, 0.851f, 0.988f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 2 - Red
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.4f, 3.9f, 1.8f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.953f, 0.274f, 0.274f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 3 - Grey
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.55f, 3.9f, 2.05f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.612f, 0.569f, 0.564f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 4 - Green
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.7f, 3.9f, 2.2f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.235f, 0.909f, 0.266f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 5 - Green
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.2f, 3.9f, 2.2f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.235f, 0.909f, 0.266f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 6 - Yellow
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.2f, 3.9f, 1.95f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.987f, 0.987f, 0.165f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 7 - Dark blue
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.6f, 3.9f, 1.85f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.247f, 0.145f, 1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pen 8 - Yellow
-	scaleXYZ = glm::vec3(0.05f, 0.6f, 0.05f);
-	positionXYZ = glm::vec3(-5.7f, 3.9f, 1.9f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.987f, 0.987f, 0.165f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
+	m_frustumCuller.SetViewProjection(m_projectionMatrix * m_viewMatrix);
+	m_bOccludersRendered = RenderOccluders();
 
-	/****************************************************************/
+	// a packet is visible when any of its objects is, and it is
+	// listed only the first time one of them is found
+	m_objectBVH.QueryFrustum(m_frustumCuller, m_visibleObjectList);
+	m_packetVisible.assign(m_drawPackets.size(), 0);
+	m_visiblePacketList.clear();
+	for (size_t i = 0; i < m_visibleObjectList.size(); i++)
+	{
+		int packet = m_objectPackets[m_visibleObjectList[i]];
+		if (m_packetVisible[packet] == 0)
+		{
+			m_packetVisible[packet] = 1;
+			m_visiblePacketList.push_back(packet);
+			frustumObjects += m_drawPackets[packet].objectCount;
+		}
+	}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// COMPUTER MONITOR STAND BASE
+	for (size_t i = 0; i < m_packetResults.size(); i++)
+	{
+		PACKET_THREAD_RESULTS& results = m_packetResults[i];
+		results.sortKeys.clear();
+		results.visibleObjects = 0;
+		results.occludedDraws = 0;
+		results.occludedObjects = 0;
+		results.levelIndices = 0;
+		results.fullDetailIndices = 0;
+	}
+	m_nextPacketChunk = 0;
 
-	scaleXYZ = glm::vec3(1.5f, 0.15f, 1.0f);
+	// waking the workers costs more than a few chunks take
+	if (m_visiblePacketList.size() < g_MinParallelPackets)
+	{
+		GeneratePacketChunks(m_packetResults[0]);
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_packetMutex);
+			m_busyPacketWorkers = (int)m_packetWorkers.size();
+			m_packetFrameNumber++;
+		}
+		m_packetFrameReady.notify_all();
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		GeneratePacketChunks(m_packetResults[0]);
 
-	positionXYZ = glm::vec3(0.0f, 3.2f, -1.5f);
+		{
+			std::unique_lock<std::mutex> lock(m_packetMutex);
+			while (m_busyPacketWorkers > 0)
+			{
+				m_packetFrameDone.wait(lock);
+			}
+		}
+	}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	ProfileZone zone("SortPackets");
 
-	SetShaderMaterial("metal");
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);
+	m_sortKeys.clear();
+	m_visibleObjects = 0;
+	m_culledObjects = GetObjectCount() - frustumObjects;
+	m_occludedDraws = 0;
+	m_occludedObjects = 0;
+	m_levelIndices = 0;
+	m_fullDetailIndices = 0;
+	for (size_t i = 0; i < m_packetResults.size(); i++)
+	{
+		const PACKET_THREAD_RESULTS& results = m_packetResults[i];
+		m_sortKeys.insert(m_sortKeys.end(), results.sortKeys.begin(), results.sortKeys.end());
+		m_visibleObjects += results.visibleObjects;
+		m_occludedDraws += results.occludedDraws;
+		m_occludedObjects += results.occludedObjects;
+		m_levelIndices += results.levelIndices;
+		m_fullDetailIndices += results.fullDetailIndices;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	RadixSortKeys(m_sortKeys, m_sortScratch);
 
-	/****************************************************************/
-	// COMPUTER MONITOR STAND NECK
+	m_sortedStateChanges = CountStateChanges(m_sortKeys);
+}
 
-	scaleXYZ = glm::vec3(0.2f, 1.5f, 0.2f);
+/***********************************************************
+ *  GeneratePacketFrames()
+ *
+ *  This method is used by every packet worker thread for
+ *  helping to generate the packets of each new frame until
+ *  the scene manager is destroyed.
+ ***********************************************************/
+void SceneManager::GeneratePacketFrames(int thread)
+{
+	int lastFrame = 0;
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_packetMutex);
+			while ((m_packetFrameNumber == lastFrame) && (m_bStoppingPacketWorkers == false))
+			{
+				m_packetFrameReady.wait(lock);
+			}
+			if (m_bStoppingPacketWorkers)
+			{
+				return;
+			}
+			lastFrame = m_packetFrameNumber;
+		}
 
-	positionXYZ = glm::vec3(0.0f, 3.3f, -1.5f);
+		GeneratePacketChunks(m_packetResults[thread]);
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		{
+			std::lock_guard<std::mutex> lock(m_packetMutex);
+			m_busyPacketWorkers--;
+		}
+		m_packetFrameDone.notify_one();
+	}
+}
 
-	SetShaderMaterial("metal");
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);
+/***********************************************************
+ *  GeneratePacketChunks()
+ *
+ *  This method is used for taking chunks of visible packets
+ *  that no other thread has taken, and generating them.
+ ***********************************************************/
+void SceneManager::GeneratePacketChunks(PACKET_THREAD_RESULTS& results)
+{
+	int chunkCount = (int)((m_visiblePacketList.size() + g_PacketChunkSize - 1) / g_PacketChunkSize);
+	int chunk = m_nextPacketChunk++;
 
-	m_basicMeshes->DrawCylinderMesh();
+	while (chunk < chunkCount)
+	{
+		GeneratePacketChunk(chunk, results);
+		chunk = m_nextPacketChunk++;
+	}
+}
 
-	/****************************************************************/
-	// COMPUTER MONITOR SCREEN
+/***********************************************************
+ *  GeneratePacketChunk()
+ *
+ *  This method is used for testing one chunk of the packets
+ *  found by the hierarchy against the rasterized occluders,
+ *  picking the levels of the ones left, and adding their
+ *  sort keys to the results of the thread. Nothing here calls
+ *  into OpenGL, and only the flags and levels of the packets
+ *  in the chunk are written.
+ ***********************************************************/
+void SceneManager::GeneratePacketChunk(int chunk, PACKET_THREAD_RESULTS& results)
+{
+	size_t firstPacket = (size_t)chunk * g_PacketChunkSize;
+	size_t endPacket = firstPacket + g_PacketChunkSize;
+	float projectionScale = m_projectionMatrix[1][1];
+	bool bPerspective = (m_projectionMatrix[3][3] == 0.0f);
 
-	scaleXYZ = glm::vec3(5.0f, 3.0f, 0.3f);
+	if (endPacket > m_visiblePacketList.size())
+	{
+		endPacket = m_visiblePacketList.size();
+	}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	for (size_t i = firstPacket; i < endPacket; i++)
+	{
+		int packetIndex = m_visiblePacketList[i];
+		const DRAW_PACKET& packet = m_drawPackets[packetIndex];
 
-	positionXYZ = glm::vec3(0.0f, 5.0f, -1.5f);
+		if (m_bOccludersRendered && (m_packetOccluders[packetIndex] == 0) &&
+			(m_pOcclusionCuller->TestBox(packet.boundsMin, packet.boundsMax) == false))
+		{
+			m_packetVisible[packetIndex] = 0;
+			results.occludedDraws++;
+			results.occludedObjects += packet.objectCount;
+			continue;
+		}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		results.visibleObjects += packet.objectCount;
+		SelectPacketLevel(packetIndex, projectionScale, bPerspective, results.levelIndices, results.fullDetailIndices);
+		results.sortKeys.push_back(MakeSortKey(packetIndex));
+	}
+}
 
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.1f, 0.1f, 0.12f, 1.0f);
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting how many times the
+ *  material, the texture or the mesh changes when the draw
+ *  packets are submitted in the passed in key order.
+ ***********************************************************/
+int SceneManager::CountStateChanges(const std::vector<uint64_t>& keys) const
+{
+	int stateChanges = 0;
+	const DRAW_PACKET* pPrevious = NULL;
 
-	m_basicMeshes->DrawBoxMesh();
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		const DRAW_PACKET* pPacket = &m_drawPackets[keys[i] & g_SortIndexMask];
 
-	/****************************************************************/
-	// COMPUTER MONITOR SCREEN - Active Display Area
+		if ((NULL == pPrevious) || (pPrevious->material != pPacket->material))
+		{
+			stateChanges++;
+		}
+		if ((NULL == pPrevious) || (pPrevious->texture != pPacket->texture))
+		{
+			stateChanges++;
+		}
+		if ((NULL == pPrevious) || (pPrevious->mesh != pPacket->mesh) ||
+			(pPrevious->instanceGroup != pPacket->instanceGroup))
+		{
+			stateChanges++;
+		}
+		pPrevious = pPacket;
+	}
 
-	scaleXYZ = glm::vec3(4.6f, 2.6f, 0.25f);
+	return(stateChanges);
+}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  SubmitDrawPacket()
+ *
+ *  This method is used for setting the values of one draw
+ *  packet into the shader and drawing it at the passed in
+ *  tessellation level.
+ ***********************************************************/
+void SceneManager::SubmitDrawPacket(const DRAW_PACKET& packet, int level)
+{
+	// a batch of repeated objects is drawn with one instanced draw
+	if (packet.instanceGroup >= 0)
+	{
+		DrawInstanceGroup(packet.instanceGroup, packet.texture, level);
+		return;
+	}
 
-	positionXYZ = glm::vec3(0.0f, 5.0f, -1.4f);
+	SetModelMatrix(packet.model);
+	SetShaderMaterial(packet.material);
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	if (packet.texture >= 0)
+	{
+		SetShaderTexture(packet.texture);
+		SetTextureUVScale(packet.UVscale.x, packet.UVscale.y);
+	}
+	else
+	{
+		SetShaderColor(packet.color.r, packet.color.g, packet.color.b, packet.color.a);
+	}
 
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.3f, 0.5f, 0.7f, 1.0f);
+	DrawMesh(packet.mesh, level);
+}
 
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  CanDrawIndirect()
+ *
+ *  This method is used for checking that a draw packet can be
+ *  drawn by an indirect draw command. The commands share one
+ *  set of uniforms, so a packet with a texture outside of the
+ *  texture array must still bind it with its own draw.
+ ***********************************************************/
+bool SceneManager::CanDrawIndirect(const DRAW_PACKET& packet) const
+{
+	if (packet.texture < 0)
+	{
+		return(true);
+	}
 
-	/****************************************************************/
+	return(m_textureIDs[packet.texture].layer >= 0);
+}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// KEYBOARD - Base
+/***********************************************************
+ *  FlushDrawCommands()
+ *
+ *  This method is used for drawing the queued indirect draw
+ *  commands with one multi-draw call, and for emptying the
+ *  queue.
+ ***********************************************************/
+void SceneManager::FlushDrawCommands()
+{
+	if (m_drawCommands.empty() || (NULL == m_pUniformCache))
+	{
+		m_drawCommands.clear();
+		return;
+	}
 
-	scaleXYZ = glm::vec3(3.5f, 0.15f, 1.5f);
+	m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, true);
+	m_instancedMeshes->DrawIndirect(m_drawCommands);
+	m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, false);
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	m_indirectDrawCalls++;
+	m_indirectCommands += (int)m_drawCommands.size();
+	m_drawCommands.clear();
+}
 
-	positionXYZ = glm::vec3(0.0f, 3.2f, 2.0f);
+/***********************************************************
+ *  BuildGPUPackets()
+ *
+ *  This method is used for uploading the culling values of
+ *  the opaque packets that are drawn from the instance values
+ *  to the culling shader. The transparent packets must be
+ *  sorted and the others need their own texture, so they are
+ *  still culled and drawn on the CPU.
+ ***********************************************************/
+void SceneManager::BuildGPUPackets()
+{
+	std::vector<GPUCuller::CULL_PACKET> cullPackets;
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	m_gpuPackets.clear();
+	m_cpuPackets.clear();
 
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.15f, 0.15f, 0.15f, 1.0f);  // Dark grey keyboard
+	if (!m_bUseGPUCulling)
+	{
+		return;
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	for (size_t i = 0; i < m_drawPackets.size(); i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[i];
 
-	/****************************************************************/
+		if (packet.bTransparent || !CanDrawIndirect(packet))
+		{
+			m_cpuPackets.push_back((int)i);
+			continue;
+		}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// MOUSE
+		GPUCuller::CULL_PACKET cullPacket;
+		cullPacket.boundsMin = glm::vec4(packet.boundsMin, 0.0f);
+		cullPacket.boundsMax = glm::vec4(packet.boundsMax, 0.0f);
+		cullPacket.center = glm::vec4(packet.center, 0.0f);
+		for (int level = 0; level < SceneMeshes::LOD_LEVELS; level++)
+		{
+			SceneMeshes::DRAW_COMMAND command = m_instancedMeshes->MakeDrawCommand(
+				packet.mesh, level, (GLuint)packet.firstInstance, (GLuint)packet.objectCount);
+
+			cullPacket.levelCounts[level] = command.count;
+			cullPacket.levelFirstIndices[level] = command.firstIndex;
+			cullPacket.baseVertex = command.baseVertex;
+			cullPacket.baseInstance = command.baseInstance;
+			cullPacket.instanceCount = command.instanceCount;
+		}
+		cullPacket.levelCount = m_instancedMeshes->GetLevelCount(packet.mesh);
 
-	scaleXYZ = glm::vec3(0.6f, 0.3f, 0.8f);
+		m_gpuPackets.push_back((int)i);
+		cullPackets.push_back(cullPacket);
+	}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -20.0f;
-	ZrotationDegrees = 0.0f;
+	m_pGPUCuller->SetPackets(cullPackets);
 
-	positionXYZ = glm::vec3(4.5f, 3.2f, 1.8f);
+	m_cpuPacketBounds.Resize(m_cpuPackets.size());
+	for (size_t i = 0; i < m_cpuPackets.size(); i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[m_cpuPackets[i]];
+		m_cpuPacketBounds.SetBox(i, packet.boundsMin, packet.boundsMax);
+	}
+	m_cpuPacketVisible.assign(m_cpuPackets.size(), 1);
+}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  SetGPUCulling()
+ *
+ *  This method is used for switching between culling the
+ *  opaque packets with the culling shader and culling all
+ *  the packets on the CPU. The culling shader is loaded the
+ *  first time it is switched on.
+ ***********************************************************/
+bool SceneManager::SetGPUCulling(bool bEnable)
+{
+	if (bEnable && (NULL == m_pGPUCuller))
+	{
+		if (!m_bUseIndirect || !GPUCuller::IsSupported())
+		{
+			std::cout << "GPU culling needs OpenGL 4.3, the packets are culled on the CPU" << std::endl;
+			return(false);
+		}
 
-	SetShaderMaterial("plastic");
-	SetShaderColor(0.2f, 0.2f, 0.25f, 1.0f);  // Dark grey mouse
+		m_pGPUCuller = new GPUCuller();
+		if (m_pGPUCuller->LoadShader(g_CullingShaderFile) == false)
+		{
+			delete m_pGPUCuller;
+			m_pGPUCuller = NULL;
+			return(false);
+		}
+	}
 
-	m_basicMeshes->DrawBoxMesh();
+	m_bUseGPUCulling = bEnable;
+	m_bSceneDirty = true;
 
-	/****************************************************************/
+	return(true);
+}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// SCENTSY POT - right side tapered cylinder
+/***********************************************************
+ *  CompareGPUCulling()
+ *
+ *  This method is used for reading back the number of draw
+ *  commands that the culling shader wrote in the last frame,
+ *  and for reporting it next to the number of the same
+ *  packets that pass the CPU frustum test.
+ ***********************************************************/
+void SceneManager::CompareGPUCulling()
+{
+	if (!m_bUseGPUCulling)
+	{
+		return;
+	}
 
-	scaleXYZ = glm::vec3(0.6f, 0.8f, 0.6f);
+	int cpuDraws = 0;
+	for (size_t i = 0; i < m_gpuPackets.size(); i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[m_gpuPackets[i]];
+		if (m_frustumCuller.TestBox(packet.boundsMin, packet.boundsMax))
+		{
+			cpuDraws++;
+		}
+	}
+	int gpuDraws = (int)m_pGPUCuller->ReadCommandCount();
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 45.0f;
-	ZrotationDegrees = 0.0f;
+	std::cout << "Packets culled on the GPU:" << m_gpuPackets.size()
+		<< " drawn:" << gpuDraws << ", drawn by the CPU path:" << cpuDraws;
+	if (gpuDraws != cpuDraws)
+	{
+		std::cout << " - MISMATCH";
+	}
+	std::cout << std::endl;
+}
 
-	positionXYZ = glm::vec3(-6.0f, 3.2f, -2.5f);
+/**************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
+/*** preparing and rendering their own 3D replicated scenes.***/
+/*** Please refer to the code in the OpenGL sample project  ***/
+/*** for assistance.                                        ***/
+/**************************************************************/
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
 
-	SetShaderMaterial("ceramic");
-	SetShaderTexture("clay");
-	SetTextureUVScale(1.0f, 1.0f);
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for defining all the objects in the
+ *  retained 3D scene one time. The transformations, materials
+ *  and textures are compiled into draw packets afterwards.
+ *
+ *  TEXTURING IMPLEMENTATION:
+ *  - Desk uses tiled wood texture (complex technique - Rubric #2)
+ *  - Plant object uses 3 different textures on multiple shapes:
+ *    * plantBox texture on box (pot)
+ *    * plantStem texture on cylinder (stem)
+ *    * plantLeaf texture on prisms (leaves)
+ *    This demonstrates cohesive multi-texture object (Rubric #3)
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
+{
+	/****************************************************************/
+	// FLOOR - Using plane for the floor with tile texture
+	AddTexturedObject(SceneMeshes::MESH_PLANE,
+		glm::vec3(50.0f, 1.0f, 50.0f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 0.0f, 0.0f),
+		"ceramic", "floorTiles", 15.0f, 15.0f);
 
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	/****************************************************************/
+	// DESK TOP SURFACE - Main working surface, which hides the
+	// objects under the desk when looking down on it
+	int deskTop = AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(16.0f, 0.4f, 8.0f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 3.0f, 0.0f),
+		"wood", "woodDesk", 3.0f, 2.0f);
+	SetObjectOccluder(deskTop, true);
 
 	/****************************************************************/
+	// DESK LEGS - Front Left, Front Right, Back Left, Back Right
+	// drawn together with one instanced draw
+	AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 3.0f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(-7.0f, 1.5f, 3.5f),
+		"wood", "woodDesk", 1.0f, 2.0f, g_DeskLegBatch);
+	AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 3.0f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(7.0f, 1.5f, 3.5f),
+		"wood", "woodDesk", 1.0f, 2.0f, g_DeskLegBatch);
+	AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 3.0f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(-7.0f, 1.5f, -3.5f),
+		"wood", "woodDesk", 1.0f, 2.0f, g_DeskLegBatch);
+	AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 3.0f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(7.0f, 1.5f, -3.5f),
+		"wood", "woodDesk", 1.0f, 2.0f, g_DeskLegBatch);
 
 	/////////////////////////////////////////////////////////////////
 	/////////////////////////////////////////////////////////////////
-	// SCENTSY POT WAX - torus on top
+	// BACK WALL - Using wallpaper texture
+	int backWall = AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(50.0f, 20.0f, 0.3f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 10.0f, -15.0f),
+		"wood", "wallpaper", 10.0f, 8.0f);
+	SetObjectOccluder(backWall, true);
+
+	// LEFT SIDE WALL - Creating a corner room effect
+	int leftWall = AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.3f, 20.0f, 30.0f), 0.0f, 0.0f, 0.0f, glm::vec3(-25.0f, 10.0f, 0.0f),
+		"wood", "wallpaper", 8.0f, 8.0f);
+	SetObjectOccluder(leftWall, true);
 
-	scaleXYZ = glm::vec3(0.35f, 0.45f, 0.35f);
+	// RIGHT SIDE WALL - Completing the room
+	int rightWall = AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.3f, 20.0f, 30.0f), 0.0f, 0.0f, 0.0f, glm::vec3(25.0f, 10.0f, 0.0f),
+		"wood", "wallpaper", 8.0f, 8.0f);
+	SetObjectOccluder(rightWall, true);
 
-	XrotationDegrees = 100.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+	/////////////////////////////////////////////////////////////////
+	/////////////////////////////////////////////////////////////////
+	// PICTURE FRAME ON BACK WALL - Adding decorative element
 
-	positionXYZ = glm::vec3(-6.0f, 4.0f, -2.5f);
+	// Picture frame - outer border
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(5.0f, 3.5f, 0.2f), 0.0f, 0.0f, 0.0f, glm::vec3(-10.0f, 12.0f, -14.7f),
+		"wood", glm::vec4(0.2f, 0.15f, 0.1f, 1.0f));
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// PICTURE FRAME - Inner picture area (background)
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(4.4f, 2.9f, 0.15f), 0.0f, 0.0f, 0.0f, glm::vec3(-10.0f, 12.0f, -14.55f),
+		"ceramic", glm::vec4(0.95f, 0.92f, 0.88f, 1.0f));  // Light beige background
 
-	SetShaderMaterial("ceramic");
-	SetShaderColor(0.753f, 0.216f, 0.765f, 1.0f);
+	// ARTWORK - Mountain silhouette (bottom)
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(3.8f, 0.8f, 0.12f), 0.0f, 0.0f, 0.0f, glm::vec3(-10.0f, 11.0f, -14.5f),
+		"ceramic", glm::vec4(0.25f, 0.35f, 0.45f, 1.0f));  // Dark blue mountains
 
-	m_basicMeshes->DrawTorusMesh();
+	// ARTWORK - Sun/Moon circle
+	AddColoredObject(SceneMeshes::MESH_SPHERE,
+		glm::vec3(0.6f, 0.6f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(-9.0f, 12.8f, -14.5f),
+		"ceramic", glm::vec4(0.95f, 0.75f, 0.35f, 1.0f));  // Golden sun
 
-	/****************************************************************/
+	// ARTWORK - Decorative accent (left)
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.3f, 1.2f, 0.11f), 0.0f, 0.0f, 15.0f, glm::vec3(-12.0f, 12.0f, -14.48f),
+		"ceramic", glm::vec4(0.45f, 0.55f, 0.35f, 1.0f));  // Green accent
 
 	/////////////////////////////////////////////////////////////////
 	/////////////////////////////////////////////////////////////////
-	// PLANT POT
-
-	scaleXYZ = glm::vec3(0.6f, 0.6f, 0.6f);
+	// CUP OF PENS on left side of desk
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.4f, 0.7f, 0.4f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.5f, 3.2f, 2.0f),
+		"plastic", glm::vec4(0.3f, 0.3f, 0.35f, 1.0f));  // Dark grey pen holder to distinguish from wall
+
+	// PENS - drawn together with one instanced draw
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.3f, 3.9f, 2.1f),
+		"plastic", glm::vec4(0.408f, 0.851f, 0.988f, 1.0f), g_PenBatch);  // Light blue
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.4f, 3.9f, 1.8f),
+		"plastic", glm::vec4(0.953f, 0.274f, 0.274f, 1.0f), g_PenBatch);  // Red
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.55f, 3.9f, 2.05f),
+		"plastic", glm::vec4(0.612f, 0.569f, 0.564f, 1.0f), g_PenBatch);  // Grey
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.7f, 3.9f, 2.2f),
+		"plastic", glm::vec4(0.235f, 0.909f, 0.266f, 1.0f), g_PenBatch);  // Green
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.2f, 3.9f, 2.2f),
+		"plastic", glm::vec4(0.235f, 0.909f, 0.266f, 1.0f), g_PenBatch);  // Green
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.2f, 3.9f, 1.95f),
+		"plastic", glm::vec4(0.987f, 0.987f, 0.165f, 1.0f), g_PenBatch);  // Yellow
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.6f, 3.9f, 1.85f),
+		"plastic", glm::vec4(0.247f, 0.145f, 1.0f, 1.0f), g_PenBatch);  // Dark blue
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.05f, 0.6f, 0.05f), 0.0f, 0.0f, 0.0f, glm::vec3(-5.7f, 3.9f, 1.9f),
+		"plastic", glm::vec4(0.987f, 0.987f, 0.165f, 1.0f), g_PenBatch);  // Yellow
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	/////////////////////////////////////////////////////////////////
+	/////////////////////////////////////////////////////////////////
+	// COMPUTER MONITOR STAND BASE
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(1.5f, 0.15f, 1.0f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 3.2f, -1.5f),
+		"metal", glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
 
-	positionXYZ = glm::vec3(6.0f, 3.2f, -2.5f);
+	// COMPUTER MONITOR STAND NECK
+	AddColoredObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.2f, 1.5f, 0.2f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 3.3f, -1.5f),
+		"metal", glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// COMPUTER MONITOR SCREEN
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(5.0f, 3.0f, 0.3f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 5.0f, -1.5f),
+		"plastic", glm::vec4(0.1f, 0.1f, 0.12f, 1.0f));
 
-	SetShaderMaterial("ceramic");
-	SetShaderTexture("plantBox");
-	SetTextureUVScale(1.0f, 1.0f);
+	// COMPUTER MONITOR SCREEN - Active Display Area
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(4.6f, 2.6f, 0.25f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 5.0f, -1.4f),
+		"plastic", glm::vec4(0.3f, 0.5f, 0.7f, 1.0f));
 
-	m_basicMeshes->DrawBoxMesh();
+	/////////////////////////////////////////////////////////////////
+	/////////////////////////////////////////////////////////////////
+	// KEYBOARD - Base
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(3.5f, 0.15f, 1.5f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 3.2f, 2.0f),
+		"plastic", glm::vec4(0.15f, 0.15f, 0.15f, 1.0f));  // Dark grey keyboard
 
-	/****************************************************************/
+	// MOUSE
+	AddColoredObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 0.3f, 0.8f), 0.0f, -20.0f, 0.0f, glm::vec3(4.5f, 3.2f, 1.8f),
+		"plastic", glm::vec4(0.2f, 0.2f, 0.25f, 1.0f));  // Dark grey mouse
 
 	/////////////////////////////////////////////////////////////////
 	/////////////////////////////////////////////////////////////////
-	// PLANT STEM
-
-	scaleXYZ = glm::vec3(0.06f, 1.5f, 0.06f);
+	// SCENTSY POT - right side tapered cylinder
+	AddTexturedObject(SceneMeshes::MESH_TAPERED_CYLINDER,
+		glm::vec3(0.6f, 0.8f, 0.6f), 0.0f, 45.0f, 0.0f, glm::vec3(-6.0f, 3.2f, -2.5f),
+		"ceramic", "clay", 1.0f, 1.0f);
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	// SCENTSY POT WAX - torus on top
+	AddColoredObject(SceneMeshes::MESH_TORUS,
+		glm::vec3(0.35f, 0.45f, 0.35f), 100.0f, 0.0f, 90.0f, glm::vec3(-6.0f, 4.0f, -2.5f),
+		"ceramic", glm::vec4(0.753f, 0.216f, 0.765f, 1.0f));
 
-	positionXYZ = glm::vec3(6.0f, 3.4f, -2.5f);
+	/////////////////////////////////////////////////////////////////
+	/////////////////////////////////////////////////////////////////
+	// PLANT POT
+	AddTexturedObject(SceneMeshes::MESH_BOX,
+		glm::vec3(0.6f, 0.6f, 0.6f), 0.0f, 0.0f, 0.0f, glm::vec3(6.0f, 3.2f, -2.5f),
+		"ceramic", "plantBox", 1.0f, 1.0f);
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// PLANT STEM
+	AddTexturedObject(SceneMeshes::MESH_CYLINDER,
+		glm::vec3(0.06f, 1.5f, 0.06f), 0.0f, 0.0f, 0.0f, glm::vec3(6.0f, 3.4f, -2.5f),
+		"plant", "plantStem", 1.0f, 1.0f);
+
+	// PLANT LEAVES - Bottom, Middle, Top
+	// drawn together with one instanced draw
+	AddTexturedObject(SceneMeshes::MESH_PRISM,
+		glm::vec3(0.4f, 0.0f, 0.3f), 90.0f, 0.0f, 0.0f, glm::vec3(6.0f, 4.02f, -2.5f),
+		"plant", "plantLeaf", 1.0f, 1.0f, g_LeafBatch);
+	AddTexturedObject(SceneMeshes::MESH_PRISM,
+		glm::vec3(0.4f, 0.0f, 0.3f), 90.0f, 0.0f, 0.0f, glm::vec3(6.0f, 4.32f, -2.5f),
+		"plant", "plantLeaf", 1.0f, 1.0f, g_LeafBatch);
+	AddTexturedObject(SceneMeshes::MESH_PRISM,
+		glm::vec3(0.4f, 0.0f, 0.3f), 90.0f, 0.0f, 0.0f, glm::vec3(6.0f, 4.62f, -2.5f),
+		"plant", "plantLeaf", 1.0f, 1.0f, g_LeafBatch);
+}
 
-	SetShaderMaterial("plant");
-	SetShaderTexture("plantStem");
-	SetTextureUVScale(1.0f, 1.0f);
+/***********************************************************
+ *  SetStressGrid()
+ *
+ *  This method is used for setting the grid of rooms that
+ *  PrepareScene() fills the scene with. A grid of one room
+ *  keeps the desk room on its own.
+ ***********************************************************/
+void SceneManager::SetStressGrid(int columns, int rows, unsigned int seed)
+{
+	m_stressColumns = glm::max(columns, 1);
+	m_stressRows = glm::max(rows, 1);
+	m_stressSeed = seed;
+}
 
-	m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  GenerateStressRooms()
+ *
+ *  This method is used for tiling the objects of the desk
+ *  room into a grid of rooms, for measuring the culling and
+ *  batching with many objects. Each copy faces one of the
+ *  two ways that fit the grid, has its desk moved to a
+ *  random spot, and gets random materials and colors and
+ *  swapped opaque textures. The desk room stays in the
+ *  middle of the front row, and the same seed always gives
+ *  the same rooms.
+ ***********************************************************/
+void SceneManager::GenerateStressRooms()
+{
+	int templateCount = GetObjectCount();
+	int materialCount = (int)m_objectMaterials.size();
+	unsigned int seed = m_stressSeed;
+
+	// the packet index of every object must fit in the sort keys,
+	// so the rows are cut to stay below the most objects
+	int maxRooms = (int)(g_SortIndexMask + 1) / templateCount;
+	m_stressColumns = glm::min(m_stressColumns, maxRooms);
+	if (m_stressColumns * m_stressRows > maxRooms)
+	{
+		m_stressRows = maxRooms / m_stressColumns;
+		std::cout << "The stress scene is cut to " << m_stressRows << " rows to stay below "
+			<< (g_SortIndexMask + 1) << " objects" << std::endl;
+	}
 
-	/****************************************************************/
+	std::vector<int> texturePool;
+	for (int i = 0; i < g_StressTextureCount; i++)
+	{
+		int textureSlot = FindTextureSlot(g_StressTextureTags[i]);
+		if (textureSlot >= 0)
+		{
+			texturePool.push_back(textureSlot);
+		}
+	}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// PLANT LEAF - Bottom
+	size_t objectCount = (size_t)templateCount * m_stressColumns * m_stressRows;
+	m_sceneObjects.mesh.reserve(objectCount);
+	m_sceneObjects.material.reserve(objectCount);
+	m_sceneObjects.texture.reserve(objectCount);
+	m_sceneObjects.color.reserve(objectCount);
+	m_sceneObjects.UVscale.reserve(objectCount);
+	m_sceneObjects.scale.reserve(objectCount);
+	m_sceneObjects.rotation.reserve(objectCount);
+	m_sceneObjects.position.reserve(objectCount);
+	m_sceneObjects.batch.reserve(objectCount);
+	m_sceneObjects.world.reserve(objectCount);
+	m_sceneObjects.worldDirty.reserve(objectCount);
+	m_sceneObjects.boundsMin.reserve(objectCount);
+	m_sceneObjects.boundsMax.reserve(objectCount);
+	m_sceneObjects.occluder.reserve(objectCount);
+
+	int deskRoomColumn = m_stressColumns / 2;
+	int roomIndex = 0;
+	std::vector<int> roomTextures(m_textureIDs.size());
+
+	for (int row = 0; row < m_stressRows; row++)
+	{
+		for (int column = 0; column < m_stressColumns; column++)
+		{
+			if ((row == 0) && (column == deskRoomColumn))
+			{
+				continue;
+			}
+			roomIndex++;
+
+			glm::vec3 roomOffset(
+				(column - deskRoomColumn) * g_StressRoomPitchX,
+				0.0f,
+				-row * g_StressRoomPitchZ);
+			// the random numbers are taken one at a time, since the
+			// order that arguments are evaluated in is not defined
+			bool bTurned = (NextRandom(seed) < 0.5f);
+			float deskShiftX = (NextRandom(seed) * 2.0f - 1.0f) * g_StressDeskShiftX;
+			float deskShiftZ = (NextRandom(seed) * 2.0f - 1.0f) * g_StressDeskShiftZ;
+			glm::vec3 deskShift(deskShiftX, 0.0f, deskShiftZ);
+
+			// every object with the same texture gets the same swapped
+			// texture, so that the batches keep one texture
+			for (size_t i = 0; i < roomTextures.size(); i++)
+			{
+				roomTextures[i] = (int)i;
+			}
+			for (size_t i = 0; i < texturePool.size(); i++)
+			{
+				roomTextures[texturePool[i]] = texturePool[(size_t)(NextRandom(seed) * texturePool.size()) % texturePool.size()];
+			}
+
+			for (int i = 0; i < templateCount; i++)
+			{
+				glm::vec3 scale = m_sceneObjects.scale[i];
+				glm::vec3 rotation = m_sceneObjects.rotation[i];
+				glm::vec3 position = m_sceneObjects.position[i];
+				glm::vec4 color = m_sceneObjects.color[i];
+				int texture = m_sceneObjects.texture[i];
+				int batch = m_sceneObjects.batch[i];
+
+				float size = glm::max(scale.x, glm::max(scale.y, scale.z));
+				if ((fabsf(position.x) <= g_StressDeskAreaX) && (fabsf(position.z) <= g_StressDeskAreaZ) &&
+					(size < g_StressStructureSize))
+				{
+					position += deskShift;
+				}
+
+				// turning the room half way around the Y axis flips the
+				// X rotation, since the rotations are applied X first
+				if (bTurned)
+				{
+					position = glm::vec3(-position.x, position.y, -position.z);
+					rotation = glm::vec3(-rotation.x, rotation.y + 180.0f, rotation.z);
+				}
+
+				float shade = 0.7f + NextRandom(seed) * 0.6f;
+				color = glm::vec4(glm::clamp(glm::vec3(color) * shade, glm::vec3(0.0f), glm::vec3(1.0f)), color.a);
+				int material = (int)(NextRandom(seed) * materialCount) % materialCount;
+
+				int object = AddSceneObject(
+					m_sceneObjects.mesh[i],
+					scale,
+					rotation.x,
+					rotation.y,
+					rotation.z,
+					position + roomOffset,
+					material,
+					(texture >= 0) ? roomTextures[texture] : -1,
+					color,
+					m_sceneObjects.UVscale[i],
+					(batch >= 0) ? g_StressFirstBatch + roomIndex * g_StressBatchesPerRoom + batch : -1);
+				if (m_sceneObjects.occluder[i] != 0)
+				{
+					SetObjectOccluder(object, true);
+				}
+			}
+		}
+	}
 
-	scaleXYZ = glm::vec3(0.4f, 0.0f, 0.3f);
+	std::cout << "Generated " << roomIndex << " stress scene rooms with seed " << m_stressSeed
+		<< ", " << GetObjectCount() << " scene objects" << std::endl;
+}
 
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene
+ *  rendering
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	// Only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	// in the rendered 3D scene
 
-	positionXYZ = glm::vec3(6.0f, 4.02f, -2.5f);
+	// Resolve the uniforms that are set for every draw so that
+	// RenderScene() never has to look them up by name
+	ResolveShaderUniforms();
+
+	// Load all mesh types used in the scene into the shared
+	// geometry buffers - the curved shapes are generated at several
+	// tessellation levels, so that small objects are drawn with
+	// fewer vertices
+	m_instancedMeshes->LoadPlaneMesh();
+	m_instancedMeshes->LoadBoxMesh();
+	m_instancedMeshes->LoadPrismMesh();
+	m_instancedMeshes->LoadTorusMesh();
+	m_instancedMeshes->LoadTaperedCylinderMesh();
+	m_instancedMeshes->LoadSphereMesh();
+	m_instancedMeshes->LoadConeMesh();
+	m_instancedMeshes->LoadCylinderMesh();
+
+	// Draw the visible scene with multi-draw calls where the
+	// OpenGL context supports them
+	m_bUseIndirect = SceneMeshes::IsIndirectSupported();
+
+	// Load textures for the scene - the images are decoded on worker
+	// threads and uploaded by RenderScene() as they become ready
+	// These textures are used to create detailed appearances on 3D objects
+	CreateGLTexture("textures/plantBox.jpg", "plantBox");     // Texture for plant pot
+	CreateGLTexture("textures/plantStem.jpg", "plantStem");   // Texture for plant stem
+	CreateGLTexture("textures/plantLeaf.png", "plantLeaf");   // Texture for plant leaves
+	CreateGLTexture("textures/Wood/Wood069_1K-JPG_Color.jpg", "woodDesk");     // Texture for desk surface
+	CreateGLTexture("textures/Wallpaper/Wallpaper001B_1K-JPG_Color.jpg", "wallpaper");  // Texture for walls
+	CreateGLTexture("textures/Tiles/Tiles081_1K-JPG_Color.jpg", "floorTiles");  // Texture for floor
+	CreateGLTexture("textures/Clay/RoofingTiles015C_1K-JPG_Color.jpg", "clay");  // Texture for ceramic objects
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// Bind all loaded textures to OpenGL texture memory slots
+	BindGLTextures();
 
-	SetShaderMaterial("plant");
-	SetShaderTexture("plantLeaf");
-	SetTextureUVScale(1.0f, 1.0f);
+	// Define materials for objects to control lighting interaction
+	// and upload all of them into the material buffer one time
+	DefineObjectMaterials(m_objectMaterials);
+	InternMaterialTags();
+	CreateMaterialBuffer();
+
+	// Configure lighting for the scene and upload the light
+	// sources into the light buffer one time
+	DefineSceneLights(m_lightSources);
+	CreateLightBuffer();
+
+	// Define the retained scene objects one time and compile
+	// them into the draw packets that RenderScene() walks
+	DefineSceneObjects();
+	if (m_stressColumns * m_stressRows > 1)
+	{
+		GenerateStressRooms();
+	}
+	CompileScene();
+}
 
-	m_basicMeshes->DrawPrismMesh();
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by walking
+ *  the draw packets compiled from the retained scene objects,
+ *  in the order of their sort keys. The packets are only
+ *  compiled again when an object has changed since the last
+ *  frame.
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	UpdateScene();
 
-	/****************************************************************/
+	// start the culling shader first, so that the GPU culls its
+	// packets while the CPU culls and sorts the rest
+	if (m_bUseGPUCulling)
+	{
+		ProfileZone zone("DispatchGPUCulling");
+		m_frustumCuller.SetViewProjection(m_projectionMatrix * m_viewMatrix);
+		m_pGPUCuller->Dispatch(
+			m_frustumCuller.GetPlanes(),
+			m_cameraPosition,
+			m_projectionMatrix[1][1],
+			(m_projectionMatrix[3][3] == 0.0f));
+		// the culling shader replaced the shader program in use
+		glUseProgram(m_pUniformCache->GetProgramID());
+	}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// PLANT LEAF - Middle
+	CullAndSortPackets();
 
-	scaleXYZ = glm::vec3(0.4f, 0.0f, 0.3f);
+	SubmitSortedPackets(m_sortKeys);
+}
 
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  UpdateScene()
+ *
+ *  This method is used for swapping in the textures whose
+ *  images finished loading, and for compiling the draw
+ *  packets again when the scene objects or their textures
+ *  changed. True is returned when the packets were compiled,
+ *  which renumbers them.
+ ***********************************************************/
+bool SceneManager::UpdateScene()
+{
+	// swap in the textures whose images finished loading
+	{
+		ProfileZone zone("UpdateTextures");
+		UpdateGLTextures(false);
+	}
 
-	positionXYZ = glm::vec3(6.0f, 4.32f, -2.5f);
+	if (m_bSceneDirty == false)
+	{
+		return(false);
+	}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	ProfileZone zone("CompileScene");
+	CompileScene();
 
-	SetShaderMaterial("plant");
-	SetShaderTexture("plantLeaf");
-	SetTextureUVScale(1.0f, 1.0f);
+	return(true);
+}
 
-	m_basicMeshes->DrawPrismMesh();
+/***********************************************************
+ *  CullAndSortPackets()
+ *
+ *  This method is used for skipping the packets outside of
+ *  the view or hidden behind the occluders, and sorting the
+ *  rest - the camera moves, so the depth part of the keys
+ *  changes. Big scenes walk the object hierarchy and share
+ *  the packets that it finds out to the packet threads in
+ *  chunks. Nothing here calls into OpenGL.
+ ***********************************************************/
+void SceneManager::CullAndSortPackets()
+{
+	if ((m_packetWorkers.empty() == false) && (m_bUseGPUCulling == false) &&
+		(m_drawPackets.size() >= g_MinParallelPackets))
+	{
+		ProfileZone zone("GeneratePackets");
+		GenerateDrawPackets();
+		return;
+	}
 
-	/****************************************************************/
+	{
+		ProfileZone zone("CullPackets");
+		CullDrawPackets();
+		OcclusionCullDrawPackets();
+	}
+	{
+		ProfileZone zone("SortPackets");
+		SelectPacketLevels();
+		SortDrawPackets();
+	}
+}
 
-	/////////////////////////////////////////////////////////////////
-	/////////////////////////////////////////////////////////////////
-	// PLANT LEAF - Top
+/***********************************************************
+ *  SubmitSortedPackets()
+ *
+ *  This method is used for drawing the packets of a list of
+ *  sort keys in order, at the levels kept in the keys.
+ ***********************************************************/
+void SceneManager::SubmitSortedPackets(const std::vector<uint64_t>& sortKeys)
+{
+	// the packets that can be drawn from the instance values are
+	// queued as indirect draw commands, and the queue is drawn
+	// before any other packet so that the sorted order is kept
+	m_indirectDrawCalls = 0;
+	m_indirectCommands = 0;
+
+	// the packets culled on the GPU are all opaque, so they are
+	// drawn with one call before the sorted packets
+	if (m_bUseGPUCulling)
+	{
+		ProfileZone zone("DrawGPUCulled");
+		m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, true);
+		m_instancedMeshes->DrawIndirectBuffer(
+			m_pGPUCuller->GetCommandBuffer(),
+			m_pGPUCuller->GetCounterBuffer(),
+			m_pGPUCuller->GetPacketCount());
+		m_pUniformCache->SetBoolValue(m_uniforms.useInstancing, false);
+		m_indirectDrawCalls++;
+	}
 
-	scaleXYZ = glm::vec3(0.4f, 0.0f, 0.3f);
+	// one zone for the whole pass - a zone per draw would cost
+	// two timestamp queries for every packet
+	ProfileZone zone("SubmitPackets");
+	for (size_t i = 0; i < sortKeys.size(); i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[sortKeys[i] & g_SortIndexMask];
+		int level = (int)((sortKeys[i] >> g_SortLevelShift) & g_SortLevelMask);
 
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		if (m_bUseIndirect && CanDrawIndirect(packet))
+		{
+			m_drawCommands.push_back(m_instancedMeshes->MakeDrawCommand(
+				packet.mesh,
+				level,
+				(GLuint)packet.firstInstance,
+				(GLuint)packet.objectCount));
+			continue;
+		}
 
-	positionXYZ = glm::vec3(6.0f, 4.62f, -2.5f);
+		FlushDrawCommands();
+		SubmitDrawPacket(packet, level);
+	}
+	FlushDrawCommands();
+}
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  PrepareFrame()
+ *
+ *  This method is used for culling and sorting the packets
+ *  for the camera of a snapshot, and keeping the sorted keys
+ *  and the counts in it. Nothing here calls into OpenGL, so
+ *  an update thread can prepare the next frame while the
+ *  rendering thread submits another snapshot. UpdateScene()
+ *  must not run at the same time, since a compile changes
+ *  the packets that are read here.
+ ***********************************************************/
+void SceneManager::PrepareFrame(FRAME_SNAPSHOT& snapshot)
+{
+	SetCameraView(snapshot.view, snapshot.projection, snapshot.cameraPosition);
 
-	SetShaderMaterial("plant");
-	SetShaderTexture("plantLeaf");
-	SetTextureUVScale(1.0f, 1.0f);
+	CullAndSortPackets();
 
-	m_basicMeshes->DrawPrismMesh();
+	snapshot.sortKeys.assign(m_sortKeys.begin(), m_sortKeys.end());
+	GetFrameCounts(snapshot.counts);
+}
 
-	/****************************************************************/
+/***********************************************************
+ *  SubmitFrame()
+ *
+ *  This method is used for drawing the packets of a snapshot
+ *  prepared by PrepareFrame(), since the last compile.
+ ***********************************************************/
+void SceneManager::SubmitFrame(const FRAME_SNAPSHOT& snapshot)
+{
+	SubmitSortedPackets(snapshot.sortKeys);
+}
 
+/***********************************************************
+ *  GetFrameCounts()
+ *
+ *  This method is used for getting the object, draw and
+ *  index counts of the last culled and sorted frame.
+ ***********************************************************/
+void SceneManager::GetFrameCounts(FRAME_COUNTS& counts) const
+{
+	counts.visibleObjects = m_visibleObjects;
+	counts.culledObjects = m_culledObjects;
+	counts.occludedDraws = m_occludedDraws;
+	counts.occludedObjects = m_occludedObjects;
+	counts.levelIndices = m_levelIndices;
+	counts.fullDetailIndices = m_fullDetailIndices;
+	counts.sortedStateChanges = m_sortedStateChanges;
 }
@@ -10,9 +10,20 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "SceneMeshes.h"
+#include "UniformCache.h"
+#include "TextureLoader.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include "OcclusionCuller.h"
+#include "GPUCuller.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 /***********************************************************
@@ -29,10 +40,15 @@ public:
 	// destructor
 	~SceneManager();
 
+	// a texture is either its own 2D texture bound on a texture
+	// unit, or a layer of the shared texture array - until its
+	// image is uploaded, it uses the placeholder texture
 	struct TEXTURE_INFO
 	{
-		std::string tag;
 		uint32_t ID;
+		bool bHasAlpha;
+		int unit;
+		int layer;
 	};
 
 	struct OBJECT_MATERIAL
@@ -45,38 +61,311 @@ public:
 		std::string tag;
 	};
 
+	struct LIGHT_SOURCE
+	{
+		glm::vec3 position;
+		glm::vec3 ambientColor;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float focalStrength;
+		float specularIntensity;
+	};
+
+	// std140 layout of one material in the material uniform block
+	struct MATERIAL_BLOCK_ENTRY
+	{
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+
+	// std140 layout of one light in the light uniform block
+	struct LIGHT_BLOCK_ENTRY
+	{
+		glm::vec4 position;
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+	};
+
+	// retained scene objects stored as a structure of arrays,
+	// all the arrays are indexed by the object index
+	struct SCENE_OBJECTS
+	{
+		std::vector<SceneMeshes::MESH_TYPE> mesh;
+		std::vector<int> material;
+		std::vector<int> texture;
+		std::vector<glm::vec4> color;
+		std::vector<glm::vec2> UVscale;
+		std::vector<glm::vec3> scale;
+		std::vector<glm::vec3> rotation;
+		std::vector<glm::vec3> position;
+		std::vector<int> batch;
+		// cached model matrix, rebuilt only while its dirty flag
+		// is set by a transformation change
+		std::vector<glm::mat4> world;
+		std::vector<unsigned char> worldDirty;
+		// world-space bounding box, updated with the model matrix
+		std::vector<glm::vec3> boundsMin;
+		std::vector<glm::vec3> boundsMax;
+		// true for the large boxes that hide other objects
+		std::vector<unsigned char> occluder;
+	};
+
+	// pre-baked values for one draw call - a texture handle of -1
+	// draws with the flat color, and an instance group handle of
+	// other than -1 draws the whole group at once. The instance
+	// values of the packet objects start at the first instance
+	// in the indirect instance values
+	struct DRAW_PACKET
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		glm::vec3 center;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int objectCount;
+		SceneMeshes::MESH_TYPE mesh;
+		int material;
+		int texture;
+		int instanceGroup;
+		int firstInstance;
+		bool bTransparent;
+	};
+
+	// object, draw and index counts of one culled and sorted
+	// frame
+	struct FRAME_COUNTS
+	{
+		int visibleObjects;
+		int culledObjects;
+		int occludedDraws;
+		int occludedObjects;
+		int levelIndices;
+		int fullDetailIndices;
+		int sortedStateChanges;
+	};
+
+	// camera view and sorted packet keys of one frame, which are
+	// prepared without OpenGL so that the next frame can be
+	// prepared on another thread while this one is submitted
+	struct FRAME_SNAPSHOT
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 cameraPosition;
+		std::vector<uint64_t> sortKeys;
+		FRAME_COUNTS counts;
+	};
+
+	struct SHADER_UNIFORMS
+	{
+		UniformCache::UNIFORM_HANDLE model;
+		UniformCache::UNIFORM_HANDLE objectColor;
+		UniformCache::UNIFORM_HANDLE objectTexture;
+		UniformCache::UNIFORM_HANDLE objectTextureArray;
+		UniformCache::UNIFORM_HANDLE textureLayer;
+		UniformCache::UNIFORM_HANDLE useTexture;
+		UniformCache::UNIFORM_HANDLE UVscale;
+		UniformCache::UNIFORM_HANDLE materialIndex;
+		UniformCache::UNIFORM_HANDLE useInstancing;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
+	// cached uniform locations for the active shader program
+	UniformCache* m_pUniformCache;
+	// pre-resolved handles for the uniforms set on every draw
+	SHADER_UNIFORMS m_uniforms;
+	// pointer to the shapes object, which holds every mesh in
+	// one shared vertex and index buffer
+	SceneMeshes* m_instancedMeshes;
+	// retained scene objects
+	SCENE_OBJECTS m_sceneObjects;
+	// draw packets compiled from the retained scene objects
+	std::vector<DRAW_PACKET> m_drawPackets;
+	// true when the scene objects changed since the last compile
+	bool m_bSceneDirty;
+	// sort keys of the draw packets in submission order - the
+	// packet index is kept in the lowest bits of every key
+	std::vector<uint64_t> m_sortKeys;
+	std::vector<uint64_t> m_sortScratch;
+	// state changes between the packets before and after sorting
+	int m_unsortedStateChanges;
+	int m_sortedStateChanges;
+	// world-space boxes of the draw packets and their visibility
+	// in the frame being rendered
+	FrustumCuller m_frustumCuller;
+	FrustumCuller::BOX_LIST m_packetBounds;
+	std::vector<unsigned char> m_packetVisible;
+	// hierarchy over the world-space boxes of the scene objects,
+	// the objects moved since it was last refit, and the packet
+	// that draws every object
+	SceneBVH m_objectBVH;
+	std::vector<int> m_movedObjects;
+	std::vector<int> m_objectPackets;
+	std::vector<int> m_visibleObjectList;
+	// packets of the objects found by the hierarchy, which the
+	// packet threads share out in chunks
+	std::vector<int> m_visiblePacketList;
+	// software depth rasterizer for the occluder objects, the
+	// occluder objects, and the packets that draw them
+	OcclusionCuller* m_pOcclusionCuller;
+	std::vector<int> m_occluderObjects;
+	std::vector<unsigned char> m_packetOccluders;
+	// draws and objects hidden behind the occluders in the last
+	// frame - the visible object count does not include them
+	int m_occludedDraws;
+	int m_occludedObjects;
+	// tessellation level of every packet, kept between frames
+	// and compiles so that the levels change with hysteresis
+	std::vector<int> m_packetLevels;
+	// indices drawn for the curved shapes in the last frame, and
+	// the indices that they would need at full detail
+	int m_levelIndices;
+	int m_fullDetailIndices;
+	// true when the visible packets are drawn with indirect
+	// draw commands, the instance values of every packet object
+	// that the commands read, and the commands not drawn yet
+	bool m_bUseIndirect;
+	std::vector<SceneMeshes::INSTANCE_DATA> m_packetInstances;
+	std::vector<SceneMeshes::DRAW_COMMAND> m_drawCommands;
+	// compute shader that culls the opaque packets drawn from
+	// the instance values, the packets that it culls, and the
+	// packets left to the CPU with their boxes and visibility
+	GPUCuller* m_pGPUCuller;
+	bool m_bUseGPUCulling;
+	std::vector<int> m_gpuPackets;
+	std::vector<int> m_cpuPackets;
+	FrustumCuller::BOX_LIST m_cpuPacketBounds;
+	std::vector<unsigned char> m_cpuPacketVisible;
+	// multi-draw calls and the draw commands in them in the last
+	// frame
+	int m_indirectDrawCalls;
+	int m_indirectCommands;
+	// sort keys and counts of one packet thread in the frame
+	// being rendered, merged by the rendering thread when all
+	// the chunks of packets are done - each one starts a cache
+	// line, so the threads never write to the same line
+	struct alignas(64) PACKET_THREAD_RESULTS
+	{
+		std::vector<uint64_t> sortKeys;
+		int visibleObjects;
+		int occludedDraws;
+		int occludedObjects;
+		int levelIndices;
+		int fullDetailIndices;
+	};
+	// threads that cull and key chunks of the draw packets next
+	// to the rendering thread - only the rendering thread calls
+	// into OpenGL
+	std::vector<std::thread> m_packetWorkers;
+	// results of the rendering thread and then of every worker
+	std::vector<PACKET_THREAD_RESULTS> m_packetResults;
+	// guards the frame number, the busy count and the stop flag
+	std::mutex m_packetMutex;
+	// signalled when a frame is ready or the workers must stop
+	std::condition_variable m_packetFrameReady;
+	// signalled when a worker has finished its part of a frame
+	std::condition_variable m_packetFrameDone;
+	// number of the frame that the workers are generating
+	int m_packetFrameNumber;
+	// number of workers still generating the frame
+	int m_busyPacketWorkers;
+	// next chunk of packets that no thread has taken yet
+	std::atomic<int> m_nextPacketChunk;
+	// true when the workers must stop
+	bool m_bStoppingPacketWorkers;
+	// true when the occluders of the frame were rasterized
+	bool m_bOccludersRendered;
+	// grid of rooms that the scene is tiled into, and the seed of
+	// their random changes
+	int m_stressColumns;
+	int m_stressRows;
+	unsigned int m_stressSeed;
+	// objects inside and outside of the view in the last frame
+	int m_visibleObjects;
+	int m_culledObjects;
+	// camera view of the frame being rendered
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::vec3 m_cameraPosition;
 	// total number of loaded textures
 	int m_loadedTextures;
 	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// number of texture units used by the 2D textures
+	int m_textureUnits;
+	// texture array holding all the same-size textures
+	GLuint m_textureArray;
+	// number of allocated and used texture array layers
+	int m_textureArrayCapacity;
+	int m_textureArrayLayers;
+	// format and mip level count that every layer must match
+	GLenum m_textureArrayFormat;
+	int m_textureArrayLevels;
+	// true when uncompressed layers were uploaded since the mipmaps
+	// of the texture array were last generated
+	bool m_bTextureArrayMipmaps;
+	// texture drawn while the image of a texture is loading
+	GLuint m_placeholderTexture;
+	// decodes the texture images on worker threads
+	TextureLoader* m_pTextureLoader;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// defined scene light sources
+	std::vector<LIGHT_SOURCE> m_lightSources;
+	// interned tag to handle maps, only searched while preparing
+	std::unordered_map<std::string, int> m_textureHandles;
+	std::unordered_map<std::string, int> m_materialHandles;
+#ifdef _DEBUG
+	// reverse handle to tag maps for logging
+	std::vector<std::string> m_textureNames;
+	std::vector<std::string> m_materialNames;
+#endif
+	// uniform buffer holding all the object materials
+	GLuint m_materialBuffer;
+	// uniform buffer holding all the scene light sources
+	GLuint m_lightBuffer;
+
+	// resolve the per-draw uniform handles from the shader program
+	void ResolveShaderUniforms();
+	// upload the object materials into the material uniform buffer
+	void CreateMaterialBuffer();
+	// upload the light sources into the light uniform buffer
+	void CreateLightBuffer();
 
-	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
+	// queue a texture image for loading into OpenGL texture data
+	bool CreateGLTexture(const char* filename, const std::string& tag);
+	// create the texture drawn while the images are loading
+	void CreatePlaceholderTexture();
+	// allocate the texture array for the same-size textures
+	void CreateGLTextureArray(const TextureLoader::DECODED_IMAGE& image);
+	// upload the decoded texture images that are ready - returns
+	// the number of textures that changed
+	int UpdateGLTextures(bool bWaitForAll);
+	// upload one decoded texture image into OpenGL texture data
+	bool UploadGLTexture(TextureLoader::DECODED_IMAGE& image);
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
-
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
-		glm::vec3 scaleXYZ,
-		float XrotationDegrees,
-		float YrotationDegrees,
-		float ZrotationDegrees,
-		glm::vec3 positionXYZ);
+	int FindTextureID(const std::string& tag);
+	int FindTextureSlot(const std::string& tag);
+	// find the index of a defined material by tag
+	int FindMaterialIndex(const std::string& tag);
+	// intern the defined material tags into material handles
+	void InternMaterialTags();
+	// get the readable tags of handles for logging
+	const char* GetMaterialName(int materialHandle) const;
+	const char* GetTextureName(int textureHandle) const;
+
+	// set the model matrix into the shader
+	void SetModelMatrix(
+		const glm::mat4& model);
 
 	// set the color values into the shader
 	void SetShaderColor(
@@ -87,7 +376,7 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		int textureHandle);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -95,13 +384,226 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		int materialHandle);
+
+	// draw a group of instanced objects with one draw call
+	void DrawInstanceGroup(
+		int groupHandle,
+		int textureHandle,
+		int level = 0);
+
+	// draw one basic shape mesh by type, at a tessellation level
+	// for the curved shapes
+	void DrawMesh(SceneMeshes::MESH_TYPE mesh, int level = 0);
+
+	// add an object to the retained scene and return its index
+	int AddSceneObject(
+		SceneMeshes::MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		int materialHandle,
+		int textureHandle,
+		glm::vec4 color,
+		glm::vec2 UVscale,
+		int batch);
+
+	// add a textured object to the retained scene
+	int AddTexturedObject(
+		SceneMeshes::MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		const std::string& materialTag,
+		const std::string& textureTag,
+		float u, float v,
+		int batch = -1);
+
+	// add a flat colored object to the retained scene
+	int AddColoredObject(
+		SceneMeshes::MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		const std::string& materialTag,
+		glm::vec4 color,
+		int batch = -1);
+
+	// mark a box object as an occluder for the software
+	// occlusion culling
+	void SetObjectOccluder(int objectIndex, bool bOccluder);
+
+	// compile the retained scene objects into draw packets
+	void CompileScene();
+	// rebuild the cached model matrices that are marked dirty
+	int UpdateWorldMatrices();
+
+	// test the draw packets against the camera view frustum
+	void CullDrawPackets();
+	// rasterize the occluders inside of the view frustum - returns
+	// false when the scene has none
+	bool RenderOccluders();
+	// test the packets left after frustum culling against the
+	// rasterized occluders
+	void OcclusionCullDrawPackets();
+	// pick the tessellation level of every visible packet from
+	// its projected size
+	void SelectPacketLevels();
+	// pick the level of one visible packet and add its indices
+	// to the passed in counts
+	void SelectPacketLevel(
+		size_t packetIndex,
+		float projectionScale,
+		bool bPerspective,
+		int& levelIndices,
+		int& fullDetailIndices);
+	// build the sort keys for the camera and sort the packets
+	void SortDrawPackets();
+	// build the sort key of one visible packet
+	uint64_t MakeSortKey(size_t packetIndex) const;
+
+	// cull the draw packets with the object hierarchy, then
+	// occlusion cull, pick the levels of and key the visible ones
+	// on the packet threads, and merge and sort the keys
+	void GenerateDrawPackets();
+	// take chunks of visible packets that no other thread has
+	// taken until none are left
+	void GeneratePacketChunks(PACKET_THREAD_RESULTS& results);
+	// occlusion cull, pick the levels of and key one chunk of
+	// visible packets
+	void GeneratePacketChunk(int chunk, PACKET_THREAD_RESULTS& results);
+	// wait for frames and help generating their packets until
+	// stopping
+	void GeneratePacketFrames(int thread);
+	// cull and sort the packets for the camera view, without
+	// calling into OpenGL
+	void CullAndSortPackets();
+	// draw the packets of the sort keys in order
+	void SubmitSortedPackets(const std::vector<uint64_t>& sortKeys);
+	// count the state changes when submitting in key order
+	int CountStateChanges(const std::vector<uint64_t>& keys) const;
+
+	// submit one draw packet
+	void SubmitDrawPacket(const DRAW_PACKET& packet, int level);
+	// true when a draw packet can be drawn by an indirect draw
+	// command, which takes its values from the instance values
+	bool CanDrawIndirect(const DRAW_PACKET& packet) const;
+	// draw the queued indirect draw commands with one call
+	void FlushDrawCommands();
+	// upload the packets that the culling shader draws, and
+	// collect the boxes of the packets left to the CPU
+	void BuildGPUPackets();
+
+	// define the objects in the retained scene
+	void DefineSceneObjects();
+	// tile the defined objects into the grid of stress rooms
+	void GenerateStressRooms();
 
 public:
 
+	// tile the desk room into a grid of randomized rooms when
+	// PrepareScene() is called next, for scaling tests - the
+	// same seed always gives the same scene
+	void SetStressGrid(int columns, int rows, unsigned int seed);
+
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
 	void RenderScene();
 
+	// upload the decoded textures and compile the scene again when
+	// it changed - returns true when it was compiled, which makes
+	// the frame snapshots prepared before it stale
+	bool UpdateScene();
+	// cull and sort the packets for the camera of a snapshot and
+	// keep the keys in it - this can run on an update thread while
+	// the rendering thread submits another snapshot, but not next
+	// to UpdateScene()
+	void PrepareFrame(FRAME_SNAPSHOT& snapshot);
+	// draw the packets of a prepared snapshot
+	void SubmitFrame(const FRAME_SNAPSHOT& snapshot);
+	// true when the frames can be prepared apart from drawing
+	// them, which the culling shader does not allow
+	bool CanPrepareFrames() const { return !m_bUseGPUCulling; }
+	// get the counts of the last culled and sorted frame
+	void GetFrameCounts(FRAME_COUNTS& counts) const;
+
+	// upload every texture image as soon as it is decoded and
+	// return when none are left loading, for rendering frames
+	// that must not show the placeholder texture
+	void WaitForTextures();
+	// true when the next frame would differ from the last one
+	// with the same camera view
+	bool HasSceneChanges();
+
+	// change the transformation of a retained scene object
+	void SetObjectTransform(
+		int objectIndex,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+
+	// time the fused model matrix builder against the chain of
+	// matrix multiplies for the passed in number of transforms
+	static void BenchmarkModelMatrices(int transformCount);
+
+	// get the number of objects in the retained scene
+	int GetObjectCount() const { return (int)m_sceneObjects.mesh.size(); }
+	// get the number of compiled draw packets
+	int GetDrawPacketCount() const { return (int)m_drawPackets.size(); }
+	// get the state changes in the last frame before and after sorting
+	int GetUnsortedStateChanges() const { return m_unsortedStateChanges; }
+	int GetSortedStateChanges() const { return m_sortedStateChanges; }
+	// get the objects inside and outside of the view in the last frame
+	int GetVisibleObjectCount() const { return m_visibleObjects; }
+	int GetCulledObjectCount() const { return m_culledObjects; }
+	// get the draws and objects hidden behind the occluders in
+	// the last frame
+	int GetOccludedDrawCount() const { return m_occludedDraws; }
+	int GetOccludedObjectCount() const { return m_occludedObjects; }
+	// get the indices drawn for the curved shapes in the last
+	// frame, and the indices that they would need at full detail
+	int GetLevelIndexCount() const { return m_levelIndices; }
+	int GetFullDetailIndexCount() const { return m_fullDetailIndices; }
+	// cull the opaque packets with a compute shader instead of
+	// on the CPU, after PrepareScene() - returns false when the
+	// OpenGL context cannot run the culling shader
+	bool SetGPUCulling(bool bEnable);
+	// check the commands written by the culling shader in the
+	// last frame against the CPU frustum test and report both -
+	// this waits for the GPU
+	void CompareGPUCulling();
+
+	// get the multi-draw calls and the indirect draw commands
+	// in them in the last frame
+	int GetIndirectDrawCallCount() const { return m_indirectDrawCalls; }
+	int GetIndirectCommandCount() const { return m_indirectCommands; }
+
+	// find the closest scene object whose box is hit by a ray -
+	// returns the object index, or -1 when nothing is hit
+	int RaycastObjects(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		float& hitDistance) const;
+	// find the scene objects whose boxes touch a sphere
+	int FindObjectsInRadius(
+		const glm::vec3& center,
+		float radius,
+		std::vector<int>& objects) const;
+
+	// set the camera view of the next frame to render
+	void SetCameraView(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& position);
+
 };
\ No newline at end of file
@@ -0,0 +1,1156 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenemeshes.cpp
+// ============
+// generate basic shape meshes that can be drawn with instancing
+//
+//	The generated shapes use the same unit dimensions and vertex layout
+//	(position, normal, texture coordinate) as the ShapeMeshes library,
+//	so an instanced object looks the same as one drawn through it. The
+//	curved shapes are generated at several tessellation levels, and all
+//	the shapes share one vertex buffer and one index buffer.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneMeshes.h"
+#include "GLStateCache.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cstddef>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// number of floats per vertex - position, normal, texture coordinate
+	const int g_FloatsPerVertex = 8;
+	// number of segments around the curved shapes at every
+	// tessellation level
+	const int g_LevelSegments[SceneMeshes::LOD_LEVELS] = { 48, 24, 12, 6 };
+	// projected sizes, as a fraction of the viewport height, where
+	// the curved shapes switch to the next coarser level
+	const float g_LevelSwitchSizes[SceneMeshes::LOD_LEVELS - 1] = { 0.2f, 0.06f, 0.02f };
+	// how far past a switch size an object must get before its
+	// level changes, so that it does not flicker at the switch
+	const float g_LevelHysteresis = 0.2f;
+	// top radius of the tapered cylinder and tube radius of the
+	// torus, for shapes with a radius of 1
+	const float g_TaperedTopRadius = 0.5f;
+	const float g_TorusTubeRadius = 0.2f;
+
+	// vertex attribute locations in the vertex shader
+	const GLuint g_PositionAttribute = 0;
+	const GLuint g_NormalAttribute = 1;
+	const GLuint g_TextureAttribute = 2;
+	const GLuint g_InstanceModelAttribute = 3;
+	const GLuint g_InstanceColorAttribute = 7;
+	const GLuint g_InstanceMaterialAttribute = 8;
+	const GLuint g_InstanceUVScaleAttribute = 9;
+
+	/***********************************************************
+	 *  AddVertex()
+	 *
+	 *  This helper function is used for appending one vertex to
+	 *  the generated vertex data and returning its index.
+	 ***********************************************************/
+	GLuint AddVertex(
+		std::vector<GLfloat>& vertices,
+		glm::vec3 position,
+		glm::vec3 normal,
+		glm::vec2 uv)
+	{
+		GLuint index = (GLuint)(vertices.size() / g_FloatsPerVertex);
+
+		vertices.push_back(position.x);
+		vertices.push_back(position.y);
+		vertices.push_back(position.z);
+		vertices.push_back(normal.x);
+		vertices.push_back(normal.y);
+		vertices.push_back(normal.z);
+		vertices.push_back(uv.x);
+		vertices.push_back(uv.y);
+
+		return(index);
+	}
+
+	/***********************************************************
+	 *  AddTriangle()
+	 *
+	 *  This helper function is used for appending one flat
+	 *  triangle, wound counter-clockwise around its normal.
+	 ***********************************************************/
+	void AddTriangle(
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		glm::vec3 p0, glm::vec3 p1, glm::vec3 p2,
+		glm::vec2 uv0, glm::vec2 uv1, glm::vec2 uv2,
+		glm::vec3 normal)
+	{
+		GLuint i0 = AddVertex(vertices, p0, normal, uv0);
+		GLuint i1 = AddVertex(vertices, p1, normal, uv1);
+		GLuint i2 = AddVertex(vertices, p2, normal, uv2);
+
+		// keep the front face on the side the normal points to
+		if (glm::dot(glm::cross(p1 - p0, p2 - p0), normal) >= 0.0f)
+		{
+			indices.push_back(i0);
+			indices.push_back(i1);
+			indices.push_back(i2);
+		}
+		else
+		{
+			indices.push_back(i0);
+			indices.push_back(i2);
+			indices.push_back(i1);
+		}
+	}
+
+	/***********************************************************
+	 *  AddQuad()
+	 *
+	 *  This helper function is used for appending one flat quad
+	 *  from four corners given in order around its edge.
+	 ***********************************************************/
+	void AddQuad(
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3,
+		glm::vec3 normal)
+	{
+		AddTriangle(vertices, indices, p0, p1, p2,
+			glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f), normal);
+		AddTriangle(vertices, indices, p0, p2, p3,
+			glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f), normal);
+	}
+
+	/***********************************************************
+	 *  GeneratePlane()
+	 *
+	 *  This helper function is used for generating a plane of
+	 *  2 by 2 units that is centered on the origin and faces up.
+	 ***********************************************************/
+	void GeneratePlane(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+	{
+		AddQuad(vertices, indices,
+			glm::vec3(-1.0f, 0.0f, 1.0f),
+			glm::vec3(1.0f, 0.0f, 1.0f),
+			glm::vec3(1.0f, 0.0f, -1.0f),
+			glm::vec3(-1.0f, 0.0f, -1.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	/***********************************************************
+	 *  GenerateBox()
+	 *
+	 *  This helper function is used for generating a unit box
+	 *  that is centered on the origin.
+	 ***********************************************************/
+	void GenerateBox(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+	{
+		// face normal followed by the two axes across the face
+		const glm::vec3 faces[6][3] =
+		{
+			{ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+			{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+			{ glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+			{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },
+			{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+			{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) }
+		};
+
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec3 center = faces[i][0] * 0.5f;
+			glm::vec3 u = faces[i][1] * 0.5f;
+			glm::vec3 v = faces[i][2] * 0.5f;
+
+			AddQuad(vertices, indices,
+				center - u - v,
+				center + u - v,
+				center + u + v,
+				center - u + v,
+				faces[i][0]);
+		}
+	}
+
+	/***********************************************************
+	 *  GenerateTaperedCylinder()
+	 *
+	 *  This helper function is used for generating a cylinder
+	 *  with a bottom radius of 1 that stands on the origin and
+	 *  has a height of 1. A smaller top radius tapers the side,
+	 *  and a top radius of 0 makes a cone without a top cap.
+	 ***********************************************************/
+	void GenerateTaperedCylinder(
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		int segments,
+		float topRadius)
+	{
+		const float step = glm::two_pi<float>() / segments;
+		// the side normals lean up by how much the side narrows
+		const float slope = 1.0f - topRadius;
+
+		// side of the cylinder
+		for (int i = 0; i < segments; i++)
+		{
+			float u0 = (float)i / segments;
+			float u1 = (float)(i + 1) / segments;
+			glm::vec3 r0(cos(i * step), 0.0f, sin(i * step));
+			glm::vec3 r1(cos((i + 1) * step), 0.0f, sin((i + 1) * step));
+			glm::vec3 n0 = glm::normalize(r0 + glm::vec3(0.0f, slope, 0.0f));
+			glm::vec3 n1 = glm::normalize(r1 + glm::vec3(0.0f, slope, 0.0f));
+
+			GLuint b0 = AddVertex(vertices, r0, n0, glm::vec2(u0, 0.0f));
+			GLuint b1 = AddVertex(vertices, r1, n1, glm::vec2(u1, 0.0f));
+			GLuint t0 = AddVertex(vertices, r0 * topRadius + glm::vec3(0.0f, 1.0f, 0.0f), n0, glm::vec2(u0, 1.0f));
+			GLuint t1 = AddVertex(vertices, r1 * topRadius + glm::vec3(0.0f, 1.0f, 0.0f), n1, glm::vec2(u1, 1.0f));
+
+			indices.push_back(b0);
+			indices.push_back(t1);
+			indices.push_back(b1);
+			if (topRadius > 0.0f)
+			{
+				indices.push_back(b0);
+				indices.push_back(t0);
+				indices.push_back(t1);
+			}
+		}
+
+		// top and bottom caps of the cylinder
+		for (int i = 0; i < segments; i++)
+		{
+			glm::vec2 r0(cos(i * step), sin(i * step));
+			glm::vec2 r1(cos((i + 1) * step), sin((i + 1) * step));
+			glm::vec2 uv0(0.5f + 0.5f * r0.x, 0.5f + 0.5f * r0.y);
+			glm::vec2 uv1(0.5f + 0.5f * r1.x, 0.5f + 0.5f * r1.y);
+
+			if (topRadius > 0.0f)
+			{
+				glm::vec2 t0 = r0 * topRadius;
+				glm::vec2 t1 = r1 * topRadius;
+				AddTriangle(vertices, indices,
+					glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(t0.x, 1.0f, t0.y), glm::vec3(t1.x, 1.0f, t1.y),
+					glm::vec2(0.5f, 0.5f), uv0, uv1,
+					glm::vec3(0.0f, 1.0f, 0.0f));
+			}
+			AddTriangle(vertices, indices,
+				glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(r0.x, 0.0f, r0.y), glm::vec3(r1.x, 0.0f, r1.y),
+				glm::vec2(0.5f, 0.5f), uv0, uv1,
+				glm::vec3(0.0f, -1.0f, 0.0f));
+		}
+	}
+
+	/***********************************************************
+	 *  GenerateSphere()
+	 *
+	 *  This helper function is used for generating a sphere
+	 *  with a radius of 1 that is centered on the origin, with
+	 *  half as many rings from pole to pole as segments around.
+	 ***********************************************************/
+	void GenerateSphere(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int segments)
+	{
+		const int rings = segments / 2;
+		GLuint first = (GLuint)(vertices.size() / g_FloatsPerVertex);
+
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			float theta = glm::pi<float>() * ring / rings;
+			for (int i = 0; i <= segments; i++)
+			{
+				float phi = glm::two_pi<float>() * i / segments;
+				glm::vec3 normal(cos(phi) * sin(theta), cos(theta), sin(phi) * sin(theta));
+
+				AddVertex(vertices, normal, normal, glm::vec2((float)i / segments, 1.0f - (float)ring / rings));
+			}
+		}
+
+		for (int ring = 0; ring < rings; ring++)
+		{
+			for (int i = 0; i < segments; i++)
+			{
+				GLuint top = first + ring * (segments + 1) + i;
+				GLuint bottom = top + segments + 1;
+
+				indices.push_back(top);
+				indices.push_back(top + 1);
+				indices.push_back(bottom);
+				indices.push_back(top + 1);
+				indices.push_back(bottom + 1);
+				indices.push_back(bottom);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  GenerateTorus()
+	 *
+	 *  This helper function is used for generating a torus
+	 *  with a radius of 1 around the Z axis, with half as many
+	 *  segments around the tube as around the ring.
+	 ***********************************************************/
+	void GenerateTorus(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int segments)
+	{
+		const int tubeSegments = (segments / 2 < 3) ? 3 : segments / 2;
+		GLuint first = (GLuint)(vertices.size() / g_FloatsPerVertex);
+
+		for (int i = 0; i <= segments; i++)
+		{
+			float u = glm::two_pi<float>() * i / segments;
+			for (int j = 0; j <= tubeSegments; j++)
+			{
+				float v = glm::two_pi<float>() * j / tubeSegments;
+				glm::vec3 normal(cos(v) * cos(u), cos(v) * sin(u), sin(v));
+				glm::vec3 center(cos(u), sin(u), 0.0f);
+
+				AddVertex(vertices, center + normal * g_TorusTubeRadius, normal,
+					glm::vec2((float)i / segments, (float)j / tubeSegments));
+			}
+		}
+
+		for (int i = 0; i < segments; i++)
+		{
+			for (int j = 0; j < tubeSegments; j++)
+			{
+				GLuint current = first + i * (tubeSegments + 1) + j;
+				GLuint next = current + tubeSegments + 1;
+
+				indices.push_back(current);
+				indices.push_back(next);
+				indices.push_back(next + 1);
+				indices.push_back(current);
+				indices.push_back(next + 1);
+				indices.push_back(current + 1);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  GeneratePrism()
+	 *
+	 *  This helper function is used for generating a unit
+	 *  triangular prism that is centered on the origin, with
+	 *  the triangle faces pointing along the Z axis.
+	 ***********************************************************/
+	void GeneratePrism(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+	{
+		glm::vec3 front[3] =
+		{
+			glm::vec3(-0.5f, -0.5f, 0.5f),
+			glm::vec3(0.5f, -0.5f, 0.5f),
+			glm::vec3(0.0f, 0.5f, 0.5f)
+		};
+		glm::vec3 depth(0.0f, 0.0f, -1.0f);
+
+		// triangle faces
+		AddTriangle(vertices, indices,
+			front[0], front[1], front[2],
+			glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f));
+		AddTriangle(vertices, indices,
+			front[0] + depth, front[1] + depth, front[2] + depth,
+			glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f),
+			glm::vec3(0.0f, 0.0f, -1.0f));
+
+		// rectangle faces
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec3 a = front[i];
+			glm::vec3 b = front[(i + 1) % 3];
+			glm::vec3 normal = glm::normalize(glm::cross(b - a, depth));
+
+			AddQuad(vertices, indices, a, b, b + depth, a + depth, normal);
+		}
+	}
+}
+
+/***********************************************************
+ *  SceneMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneMeshes::SceneMeshes()
+{
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		m_meshes[i].baseVertex = 0;
+		m_meshes[i].nLevels = 0;
+		m_meshes[i].bLoaded = false;
+	}
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_meshVAO = 0;
+	m_groupVAO = 0;
+	m_groupInstanceBuffer = 0;
+	m_groupBufferInstances = 0;
+	m_groupAttributeInstance = 0;
+	m_indirectVAO = 0;
+	m_indirectInstanceBuffer = 0;
+	m_commandBuffer = 0;
+}
+
+/***********************************************************
+ *  ~SceneMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneMeshes::~SceneMeshes()
+{
+	m_instanceGroups.clear();
+	m_groupInstances.clear();
+
+	if (0 != m_groupVAO)
+	{
+		glDeleteVertexArrays(1, &m_groupVAO);
+		glDeleteBuffers(1, &m_groupInstanceBuffer);
+		m_groupVAO = 0;
+	}
+
+	if (0 != m_indirectVAO)
+	{
+		glDeleteVertexArrays(1, &m_indirectVAO);
+		glDeleteBuffers(1, &m_indirectInstanceBuffer);
+		glDeleteBuffers(1, &m_commandBuffer);
+		m_indirectVAO = 0;
+	}
+
+	if (0 != m_meshVAO)
+	{
+		glDeleteVertexArrays(1, &m_meshVAO);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_meshVAO = 0;
+	}
+}
+
+/***********************************************************
+ *  SetupMeshAttributes()
+ *
+ *  This method is used for binding the shared geometry
+ *  buffers to the vertex array that is currently bound, and
+ *  for setting up the per-vertex shape attributes.
+ ***********************************************************/
+void SceneMeshes::SetupMeshAttributes()
+{
+	GLsizei vertexStride = g_FloatsPerVertex * sizeof(GLfloat);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glEnableVertexAttribArray(g_PositionAttribute);
+	glVertexAttribPointer(g_PositionAttribute, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+	glEnableVertexAttribArray(g_NormalAttribute);
+	glVertexAttribPointer(g_NormalAttribute, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(g_TextureAttribute);
+	glVertexAttribPointer(g_TextureAttribute, 2, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6 * sizeof(GLfloat)));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+}
+
+/***********************************************************
+ *  SetupInstanceAttributes()
+ *
+ *  This method is used for setting up the per-instance
+ *  attributes of the vertex array that is currently bound,
+ *  reading from the passed in instance buffer from its first
+ *  instance on. The model matrix takes four attribute
+ *  locations.
+ ***********************************************************/
+void SceneMeshes::SetupInstanceAttributes(GLuint instanceBuffer, GLint firstInstance)
+{
+	GLsizei instanceStride = sizeof(INSTANCE_DATA);
+	size_t instanceOffset = (size_t)firstInstance * sizeof(INSTANCE_DATA);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(g_InstanceModelAttribute + column);
+		glVertexAttribPointer(g_InstanceModelAttribute + column, 4, GL_FLOAT, GL_FALSE, instanceStride,
+			(void*)(instanceOffset + offsetof(INSTANCE_DATA, model) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(g_InstanceModelAttribute + column, 1);
+	}
+	glEnableVertexAttribArray(g_InstanceColorAttribute);
+	glVertexAttribPointer(g_InstanceColorAttribute, 4, GL_FLOAT, GL_FALSE, instanceStride,
+		(void*)(instanceOffset + offsetof(INSTANCE_DATA, color)));
+	glVertexAttribDivisor(g_InstanceColorAttribute, 1);
+	glEnableVertexAttribArray(g_InstanceMaterialAttribute);
+	glVertexAttribIPointer(g_InstanceMaterialAttribute, 3, GL_INT, instanceStride,
+		(void*)(instanceOffset + offsetof(INSTANCE_DATA, materialIndex)));
+	glVertexAttribDivisor(g_InstanceMaterialAttribute, 1);
+	glEnableVertexAttribArray(g_InstanceUVScaleAttribute);
+	glVertexAttribPointer(g_InstanceUVScaleAttribute, 2, GL_FLOAT, GL_FALSE, instanceStride,
+		(void*)(instanceOffset + offsetof(INSTANCE_DATA, UVscale)));
+	glVertexAttribDivisor(g_InstanceUVScaleAttribute, 1);
+}
+
+/***********************************************************
+ *  UploadMesh()
+ *
+ *  This method is used for adding the generated vertex and
+ *  index data of a shape mesh to the shared geometry buffers.
+ *  Each tessellation level starts at its own index, and the
+ *  indices count from the first vertex of the mesh. The
+ *  shared buffers are uploaded again as a whole, which only
+ *  happens while the meshes are loaded.
+ ***********************************************************/
+void SceneMeshes::UploadMesh(
+	MESH_TYPE mesh,
+	const std::vector<GLfloat>& vertices,
+	const std::vector<GLuint>& indices,
+	const std::vector<GLsizei>& levelStarts)
+{
+	MESH_RANGE& range = m_meshes[mesh];
+
+	if (range.bLoaded)
+	{
+		return;
+	}
+
+	GLsizei indexOffset = (GLsizei)m_indexData.size();
+	range.baseVertex = (GLint)(m_vertexData.size() / g_FloatsPerVertex);
+	m_vertexData.insert(m_vertexData.end(), vertices.begin(), vertices.end());
+	m_indexData.insert(m_indexData.end(), indices.begin(), indices.end());
+
+	if (0 == m_meshVAO)
+	{
+		glGenBuffers(1, &m_vertexBuffer);
+		glGenBuffers(1, &m_indexBuffer);
+		glGenVertexArrays(1, &m_meshVAO);
+		GLStateCache::BindVertexArray(m_meshVAO);
+		SetupMeshAttributes();
+	}
+	else
+	{
+		GLStateCache::BindVertexArray(m_meshVAO);
+	}
+
+	// the vertex arrays that read the buffers keep working, since
+	// the buffer names do not change
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertexData.size() * sizeof(GLfloat), m_vertexData.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexData.size() * sizeof(GLuint), m_indexData.data(), GL_STATIC_DRAW);
+
+	GLStateCache::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	range.nLevels = (int)levelStarts.size();
+	for (int level = 0; level < range.nLevels; level++)
+	{
+		GLsizei levelEnd = (level + 1 < range.nLevels) ? levelStarts[level + 1] : (GLsizei)indices.size();
+
+		range.levels[level].firstIndex = indexOffset + levelStarts[level];
+		range.levels[level].nIndices = levelEnd - levelStarts[level];
+	}
+	range.bLoaded = true;
+}
+
+/***********************************************************
+ *  LoadMesh()
+ *
+ *  This method is used for generating a shape mesh by type.
+ ***********************************************************/
+bool SceneMeshes::LoadMesh(MESH_TYPE mesh)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		LoadPlaneMesh();
+		break;
+	case MESH_BOX:
+		LoadBoxMesh();
+		break;
+	case MESH_SPHERE:
+	case MESH_CONE:
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+	case MESH_TORUS:
+		LoadCurvedMesh(mesh);
+		break;
+	case MESH_PRISM:
+		LoadPrismMesh();
+		break;
+	default:
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  LoadCurvedMesh()
+ *
+ *  This method is used for generating every tessellation
+ *  level of a curved shape mesh into the same buffers.
+ ***********************************************************/
+void SceneMeshes::LoadCurvedMesh(MESH_TYPE mesh)
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	std::vector<GLsizei> levelStarts;
+
+	if (m_meshes[mesh].bLoaded)
+	{
+		return;
+	}
+
+	for (int level = 0; level < LOD_LEVELS; level++)
+	{
+		levelStarts.push_back((GLsizei)indices.size());
+
+		switch (mesh)
+		{
+		case MESH_SPHERE:
+			GenerateSphere(vertices, indices, g_LevelSegments[level]);
+			break;
+		case MESH_CONE:
+			GenerateTaperedCylinder(vertices, indices, g_LevelSegments[level], 0.0f);
+			break;
+		case MESH_CYLINDER:
+			GenerateTaperedCylinder(vertices, indices, g_LevelSegments[level], 1.0f);
+			break;
+		case MESH_TAPERED_CYLINDER:
+			GenerateTaperedCylinder(vertices, indices, g_LevelSegments[level], g_TaperedTopRadius);
+			break;
+		case MESH_TORUS:
+			GenerateTorus(vertices, indices, g_LevelSegments[level]);
+			break;
+		default:
+			return;
+		}
+	}
+
+	UploadMesh(mesh, vertices, indices, levelStarts);
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  This method is used for generating the plane mesh.
+ ***********************************************************/
+void SceneMeshes::LoadPlaneMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	GeneratePlane(vertices, indices);
+	UploadMesh(MESH_PLANE, vertices, indices, std::vector<GLsizei>(1, 0));
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  This method is used for generating the box mesh.
+ ***********************************************************/
+void SceneMeshes::LoadBoxMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	GenerateBox(vertices, indices);
+	UploadMesh(MESH_BOX, vertices, indices, std::vector<GLsizei>(1, 0));
+}
+
+/***********************************************************
+ *  LoadSphereMesh()
+ *
+ *  This method is used for generating the sphere mesh.
+ ***********************************************************/
+void SceneMeshes::LoadSphereMesh()
+{
+	LoadCurvedMesh(MESH_SPHERE);
+}
+
+/***********************************************************
+ *  LoadConeMesh()
+ *
+ *  This method is used for generating the cone mesh.
+ ***********************************************************/
+void SceneMeshes::LoadConeMesh()
+{
+	LoadCurvedMesh(MESH_CONE);
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  This method is used for generating the cylinder mesh.
+ ***********************************************************/
+void SceneMeshes::LoadCylinderMesh()
+{
+	LoadCurvedMesh(MESH_CYLINDER);
+}
+
+/***********************************************************
+ *  LoadTaperedCylinderMesh()
+ *
+ *  This method is used for generating the tapered cylinder
+ *  mesh.
+ ***********************************************************/
+void SceneMeshes::LoadTaperedCylinderMesh()
+{
+	LoadCurvedMesh(MESH_TAPERED_CYLINDER);
+}
+
+/***********************************************************
+ *  LoadTorusMesh()
+ *
+ *  This method is used for generating the torus mesh.
+ ***********************************************************/
+void SceneMeshes::LoadTorusMesh()
+{
+	LoadCurvedMesh(MESH_TORUS);
+}
+
+/***********************************************************
+ *  LoadPrismMesh()
+ *
+ *  This method is used for generating the prism mesh.
+ ***********************************************************/
+void SceneMeshes::LoadPrismMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	GeneratePrism(vertices, indices);
+	UploadMesh(MESH_PRISM, vertices, indices, std::vector<GLsizei>(1, 0));
+}
+
+/***********************************************************
+ *  GetIndexCount()
+ *
+ *  This method is used for getting the number of indices
+ *  that are drawn for a tessellation level of a mesh. Levels
+ *  past the last one use the last one.
+ ***********************************************************/
+GLsizei SceneMeshes::GetIndexCount(MESH_TYPE mesh, int level) const
+{
+	const MESH_RANGE& range = m_meshes[mesh];
+
+	if (range.nLevels == 0)
+	{
+		return(0);
+	}
+	if (level >= range.nLevels)
+	{
+		level = range.nLevels - 1;
+	}
+
+	return(range.levels[level].nIndices);
+}
+
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for picking the tessellation level
+ *  for the projected size of an object. The level moves one
+ *  step at a time from the current one, and only when the
+ *  size is past the switch size by the hysteresis margin.
+ ***********************************************************/
+int SceneMeshes::SelectLevel(float screenSize, int currentLevel)
+{
+	int level = glm::clamp(currentLevel, 0, LOD_LEVELS - 1);
+
+	while ((level > 0) && (screenSize >= g_LevelSwitchSizes[level - 1] * (1.0f + g_LevelHysteresis)))
+	{
+		level--;
+	}
+	while ((level < LOD_LEVELS - 1) && (screenSize < g_LevelSwitchSizes[level] * (1.0f - g_LevelHysteresis)))
+	{
+		level++;
+	}
+
+	return(level);
+}
+
+/***********************************************************
+ *  GetLevelSwitchSize()
+ *
+ *  This method is used for getting the projected size below
+ *  which a tessellation level switches to the next one.
+ ***********************************************************/
+float SceneMeshes::GetLevelSwitchSize(int level)
+{
+	return(g_LevelSwitchSizes[glm::clamp(level, 0, LOD_LEVELS - 2)]);
+}
+
+/***********************************************************
+ *  GetLevelHysteresis()
+ *
+ *  This method is used for getting the margin around the
+ *  switch sizes, as a fraction of the size.
+ ***********************************************************/
+float SceneMeshes::GetLevelHysteresis()
+{
+	return(g_LevelHysteresis);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one loaded shape mesh
+ *  with the values that are currently set in the shader.
+ ***********************************************************/
+void SceneMeshes::DrawMesh(MESH_TYPE mesh, int level)
+{
+	const MESH_RANGE& range = m_meshes[mesh];
+
+	if (!range.bLoaded)
+	{
+		return;
+	}
+	if (level >= range.nLevels)
+	{
+		level = range.nLevels - 1;
+	}
+
+	GLStateCache::BindVertexArray(m_meshVAO);
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		range.levels[level].nIndices,
+		GL_UNSIGNED_INT,
+		(void*)(range.levels[level].firstIndex * sizeof(GLuint)),
+		range.baseVertex);
+	GLStateCache::CountDrawCall();
+}
+
+/***********************************************************
+ *  ClearInstanceGroups()
+ *
+ *  This method is used for removing all the instance groups.
+ *  The shared vertex array and instance buffer are kept, so
+ *  the groups that are created next reuse them.
+ ***********************************************************/
+void SceneMeshes::ClearInstanceGroups()
+{
+	m_instanceGroups.clear();
+	m_groupInstances.clear();
+}
+
+/***********************************************************
+ *  CreateInstanceGroup()
+ *
+ *  This method is used for creating a group of instances of
+ *  a loaded shape mesh. The instance values are added after
+ *  the values of the groups created before, and the group
+ *  keeps its range of them.
+ ***********************************************************/
+int SceneMeshes::CreateInstanceGroup(
+	MESH_TYPE mesh,
+	const std::vector<INSTANCE_DATA>& instances)
+{
+	const MESH_RANGE& range = m_meshes[mesh];
+	INSTANCE_GROUP group;
+
+	if (!range.bLoaded)
+	{
+		std::cout << "Instance group created for a mesh that is not loaded:" << mesh << std::endl;
+		return(-1);
+	}
+
+	group.mesh = mesh;
+	group.firstInstance = (GLint)m_groupInstances.size();
+	group.nInstances = (GLsizei)instances.size();
+	m_groupInstances.insert(m_groupInstances.end(), instances.begin(), instances.end());
+
+	m_instanceGroups.push_back(group);
+
+	return((int)m_instanceGroups.size() - 1);
+}
+
+/***********************************************************
+ *  UploadInstanceGroups()
+ *
+ *  This method is used for uploading the instance values of
+ *  all the created groups into the instance buffer that the
+ *  groups share. The buffer is only allocated again when it
+ *  is too small for the values.
+ ***********************************************************/
+void SceneMeshes::UploadInstanceGroups()
+{
+	if (m_groupInstances.empty())
+	{
+		return;
+	}
+
+	if (0 == m_groupVAO)
+	{
+		glGenBuffers(1, &m_groupInstanceBuffer);
+		glGenVertexArrays(1, &m_groupVAO);
+		GLStateCache::BindVertexArray(m_groupVAO);
+		SetupMeshAttributes();
+		SetupInstanceAttributes(m_groupInstanceBuffer);
+		GLStateCache::BindVertexArray(0);
+		m_groupAttributeInstance = 0;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_groupInstanceBuffer);
+	if ((GLsizei)m_groupInstances.size() <= m_groupBufferInstances)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_groupInstances.size() * sizeof(INSTANCE_DATA), m_groupInstances.data());
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, m_groupInstances.size() * sizeof(INSTANCE_DATA), m_groupInstances.data(), GL_DYNAMIC_DRAW);
+		m_groupBufferInstances = (GLsizei)m_groupInstances.size();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the values only live in the buffer from now on
+	m_groupInstances.clear();
+}
+
+/***********************************************************
+ *  DrawInstanceGroup()
+ *
+ *  This method is used for drawing all the instances in a
+ *  group with one instanced draw call, at one tessellation
+ *  level for the whole group. The base instance of the draw
+ *  picks the range of the group in the shared instance
+ *  buffer, and without base instance draws the instance
+ *  attributes are pointed at the range instead.
+ ***********************************************************/
+void SceneMeshes::DrawInstanceGroup(int groupHandle, int level)
+{
+	if ((groupHandle < 0) || (groupHandle >= (int)m_instanceGroups.size()) || (0 == m_groupVAO))
+	{
+		return;
+	}
+
+	const INSTANCE_GROUP& group = m_instanceGroups[groupHandle];
+	const MESH_RANGE& range = m_meshes[group.mesh];
+	if (level >= range.nLevels)
+	{
+		level = range.nLevels - 1;
+	}
+
+	// the vertex array is left bound, so drawing another group
+	// does not bind it again
+	GLStateCache::BindVertexArray(m_groupVAO);
+	if (IsBaseInstanceSupported())
+	{
+		if (m_groupAttributeInstance != 0)
+		{
+			SetupInstanceAttributes(m_groupInstanceBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			m_groupAttributeInstance = 0;
+		}
+		glDrawElementsInstancedBaseVertexBaseInstance(
+			GL_TRIANGLES,
+			range.levels[level].nIndices,
+			GL_UNSIGNED_INT,
+			(void*)(range.levels[level].firstIndex * sizeof(GLuint)),
+			group.nInstances,
+			range.baseVertex,
+			(GLuint)group.firstInstance);
+	}
+	else
+	{
+		if (m_groupAttributeInstance != group.firstInstance)
+		{
+			SetupInstanceAttributes(m_groupInstanceBuffer, group.firstInstance);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			m_groupAttributeInstance = group.firstInstance;
+		}
+		glDrawElementsInstancedBaseVertex(
+			GL_TRIANGLES,
+			range.levels[level].nIndices,
+			GL_UNSIGNED_INT,
+			(void*)(range.levels[level].firstIndex * sizeof(GLuint)),
+			group.nInstances,
+			range.baseVertex);
+	}
+	GLStateCache::CountDrawCall();
+}
+
+/***********************************************************
+ *  IsBaseInstanceSupported()
+ *
+ *  This method is used for checking that the OpenGL context
+ *  can offset the instance attributes of an instanced draw
+ *  call with a base instance, which needs OpenGL 4.2.
+ ***********************************************************/
+bool SceneMeshes::IsBaseInstanceSupported()
+{
+	return((GLEW_VERSION_4_2 == GL_TRUE) || (GLEW_ARB_base_instance == GL_TRUE));
+}
+
+/***********************************************************
+ *  IsIndirectSupported()
+ *
+ *  This method is used for checking that the OpenGL context
+ *  can draw from a buffer of indirect draw commands with a
+ *  first instance, which needs OpenGL 4.3.
+ ***********************************************************/
+bool SceneMeshes::IsIndirectSupported()
+{
+	return(GLEW_VERSION_4_3 == GL_TRUE);
+}
+
+/***********************************************************
+ *  SetIndirectInstances()
+ *
+ *  This method is used for replacing the instance values
+ *  that the indirect draw commands read from. Every command
+ *  picks its range of the values with its first instance.
+ ***********************************************************/
+void SceneMeshes::SetIndirectInstances(const std::vector<INSTANCE_DATA>& instances)
+{
+	if (0 == m_meshVAO)
+	{
+		std::cout << "Indirect instances set before any mesh is loaded" << std::endl;
+		return;
+	}
+
+	if (0 == m_indirectVAO)
+	{
+		glGenBuffers(1, &m_indirectInstanceBuffer);
+		glGenBuffers(1, &m_commandBuffer);
+		glGenVertexArrays(1, &m_indirectVAO);
+		GLStateCache::BindVertexArray(m_indirectVAO);
+		SetupMeshAttributes();
+		SetupInstanceAttributes(m_indirectInstanceBuffer);
+		GLStateCache::BindVertexArray(0);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_indirectInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(INSTANCE_DATA), instances.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  MakeDrawCommand()
+ *
+ *  This method is used for building the indirect draw command
+ *  that draws a range of the indirect instance values with a
+ *  tessellation level of a loaded shape mesh.
+ ***********************************************************/
+SceneMeshes::DRAW_COMMAND SceneMeshes::MakeDrawCommand(
+	MESH_TYPE mesh,
+	int level,
+	GLuint firstInstance,
+	GLuint instanceCount) const
+{
+	const MESH_RANGE& range = m_meshes[mesh];
+	DRAW_COMMAND command;
+
+	if (level >= range.nLevels)
+	{
+		level = range.nLevels - 1;
+	}
+
+	command.count = 0;
+	command.firstIndex = 0;
+	if (level >= 0)
+	{
+		command.count = (GLuint)range.levels[level].nIndices;
+		command.firstIndex = (GLuint)range.levels[level].firstIndex;
+	}
+	command.instanceCount = instanceCount;
+	command.baseVertex = range.baseVertex;
+	command.baseInstance = firstInstance;
+
+	return(command);
+}
+
+/***********************************************************
+ *  DrawIndirect()
+ *
+ *  This method is used for drawing a list of indirect draw
+ *  commands with one multi-draw call. The base instance of
+ *  each command offsets the instance attributes, so the
+ *  shaders do not need to read the draw number.
+ ***********************************************************/
+void SceneMeshes::DrawIndirect(const std::vector<DRAW_COMMAND>& commands)
+{
+	if (commands.empty() || (0 == m_indirectVAO))
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(m_indirectVAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DRAW_COMMAND), commands.data(), GL_STREAM_DRAW);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		GL_UNSIGNED_INT,
+		(void*)0,
+		(GLsizei)commands.size(),
+		0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	GLStateCache::CountDrawCall();
+}
+
+/***********************************************************
+ *  DrawIndirectBuffer()
+ *
+ *  This method is used for drawing indirect draw commands
+ *  that were written into a buffer on the GPU. The number of
+ *  commands is read from the counter buffer where OpenGL can
+ *  do that, otherwise all the commands are drawn and the
+ *  unused ones must have no instances.
+ ***********************************************************/
+void SceneMeshes::DrawIndirectBuffer(GLuint commandBuffer, GLuint counterBuffer, GLsizei maxCommands)
+{
+	if ((maxCommands == 0) || (0 == m_indirectVAO))
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(m_indirectVAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (0 != counterBuffer)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, counterBuffer);
+		if (GLEW_VERSION_4_6 == GL_TRUE)
+		{
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, 0, maxCommands, 0);
+		}
+		else
+		{
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, 0, maxCommands, 0);
+		}
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, maxCommands, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	GLStateCache::CountDrawCall();
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  This method is used for getting the local bounding box of
+ *  a shape mesh at its unit size.
+ ***********************************************************/
+void SceneMeshes::GetMeshBounds(MESH_TYPE mesh, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 0.0f, 1.0f);
+		break;
+	case MESH_BOX:
+	case MESH_PRISM:
+		boundsMin = glm::vec3(-0.5f, -0.5f, -0.5f);
+		boundsMax = glm::vec3(0.5f, 0.5f, 0.5f);
+		break;
+	case MESH_SPHERE:
+		boundsMin = glm::vec3(-1.0f, -1.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	case MESH_CONE:
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	case MESH_TORUS:
+		boundsMin = glm::vec3(-1.0f - g_TorusTubeRadius, -1.0f - g_TorusTubeRadius, -g_TorusTubeRadius);
+		boundsMax = glm::vec3(1.0f + g_TorusTubeRadius, 1.0f + g_TorusTubeRadius, g_TorusTubeRadius);
+		break;
+	default:
+		boundsMin = glm::vec3(-1.0f, -1.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	}
+}
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenemeshes.h
+// ============
+// generate basic shape meshes that can be drawn with instancing
+//
+//	The generated shapes use the same unit dimensions and vertex layout
+//	(position, normal, texture coordinate) as the ShapeMeshes library,
+//	so an instanced object looks the same as one drawn through it. The
+//	curved shapes are generated at several tessellation levels, and all
+//	the shapes share one vertex buffer and one index buffer.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  SceneMeshes
+ *
+ *  This class contains the code for generating basic shape
+ *  meshes and drawing groups of them with one instanced
+ *  draw call. Where OpenGL 4.3 is available, any number of
+ *  meshes and groups can be drawn with one multi-draw call
+ *  from a buffer of indirect draw commands.
+ ***********************************************************/
+class SceneMeshes
+{
+public:
+	// constructor
+	SceneMeshes();
+	// destructor
+	~SceneMeshes();
+
+	// all the basic shape types
+	enum MESH_TYPE
+	{
+		MESH_PLANE = 0,
+		MESH_BOX,
+		MESH_SPHERE,
+		MESH_CONE,
+		MESH_CYLINDER,
+		MESH_TAPERED_CYLINDER,
+		MESH_TORUS,
+		MESH_PRISM,
+		MESH_TYPE_COUNT
+	};
+
+	// number of tessellation levels of the curved shapes - level
+	// 0 has the most detail and every level halves the segments
+	static const int LOD_LEVELS = 4;
+
+	// per-instance values - the layout must match the instance
+	// attributes at locations 3 to 9 in the vertex shader
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		GLint materialIndex;
+		GLint useTexture;
+		GLint textureLayer;
+		glm::vec2 UVscale;
+	};
+
+	// one indirect draw command - the layout is set by OpenGL
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+private:
+	// indices of one tessellation level in the shared index buffer
+	struct MESH_LEVEL
+	{
+		GLsizei firstIndex;
+		GLsizei nIndices;
+	};
+
+	// place of a shape mesh in the shared geometry buffers - the
+	// indices of every level count from the first mesh vertex
+	struct MESH_RANGE
+	{
+		GLint baseVertex;
+		MESH_LEVEL levels[LOD_LEVELS];
+		int nLevels;
+		bool bLoaded;
+	};
+
+	// range of an instance group in the shared group instances
+	struct INSTANCE_GROUP
+	{
+		MESH_TYPE mesh;
+		GLint firstInstance;
+		GLsizei nInstances;
+	};
+
+	// generated shape meshes
+	MESH_RANGE m_meshes[MESH_TYPE_COUNT];
+	// vertices and indices of all the generated shape meshes,
+	// kept for uploading the shared buffers again when another
+	// mesh is generated
+	std::vector<GLfloat> m_vertexData;
+	std::vector<GLuint> m_indexData;
+	// shared geometry buffers, and the vertex array that reads
+	// only the shape attributes from them
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_meshVAO;
+	// created instance groups, and the instance values of all of
+	// them one after the other until they are uploaded
+	std::vector<INSTANCE_GROUP> m_instanceGroups;
+	std::vector<INSTANCE_DATA> m_groupInstances;
+	// vertex array and instance buffer shared by all the instance
+	// groups, the number of instances that the buffer can hold,
+	// and the first instance that the instance attributes point
+	// at when the context has no base instance draws
+	GLuint m_groupVAO;
+	GLuint m_groupInstanceBuffer;
+	GLsizei m_groupBufferInstances;
+	GLint m_groupAttributeInstance;
+	// vertex array, instance values and command buffer for the
+	// indirect draws
+	GLuint m_indirectVAO;
+	GLuint m_indirectInstanceBuffer;
+	GLuint m_commandBuffer;
+
+	// bind the shared geometry buffers to the vertex array that
+	// is bound and set up the shape attributes
+	void SetupMeshAttributes();
+	// set up the per-instance attributes of the bound vertex
+	// array to read from an instance buffer, starting at an
+	// instance of the buffer
+	void SetupInstanceAttributes(GLuint instanceBuffer, GLint firstInstance = 0);
+
+	// upload generated vertex and index data for a shape mesh,
+	// with the first index of every tessellation level
+	void UploadMesh(
+		MESH_TYPE mesh,
+		const std::vector<GLfloat>& vertices,
+		const std::vector<GLuint>& indices,
+		const std::vector<GLsizei>& levelStarts);
+	// generate every tessellation level of a curved shape mesh
+	void LoadCurvedMesh(MESH_TYPE mesh);
+
+public:
+	// generate a shape mesh by type - returns false for the
+	// shape types that cannot be generated
+	bool LoadMesh(MESH_TYPE mesh);
+
+	// generate the shape meshes
+	void LoadPlaneMesh();
+	void LoadBoxMesh();
+	void LoadSphereMesh();
+	void LoadConeMesh();
+	void LoadCylinderMesh();
+	void LoadTaperedCylinderMesh();
+	void LoadTorusMesh();
+	void LoadPrismMesh();
+
+	// get the number of tessellation levels of a loaded mesh,
+	// which is 0 for the meshes that are not loaded
+	int GetLevelCount(MESH_TYPE mesh) const { return m_meshes[mesh].nLevels; }
+	// get the number of indices drawn for a tessellation level
+	GLsizei GetIndexCount(MESH_TYPE mesh, int level) const;
+	// pick the tessellation level for the projected size of an
+	// object, as a fraction of the viewport height - the level
+	// only changes once the size is well past the switch size
+	static int SelectLevel(float screenSize, int currentLevel);
+	// get the size below which a level switches to the next
+	// coarser level, and the hysteresis margin around it
+	static float GetLevelSwitchSize(int level);
+	static float GetLevelHysteresis();
+
+	// draw one loaded shape mesh with the values that are set
+	// in the shader, at a tessellation level
+	void DrawMesh(MESH_TYPE mesh, int level);
+
+	// remove all the instance groups - the shared instance buffer
+	// is kept for the groups that are created next
+	void ClearInstanceGroups();
+	// create a group of instances of a loaded shape mesh - the
+	// returned handle is used for drawing the whole group once
+	// the groups are uploaded
+	int CreateInstanceGroup(
+		MESH_TYPE mesh,
+		const std::vector<INSTANCE_DATA>& instances);
+	// upload the instance values of all the created groups into
+	// the shared instance buffer
+	void UploadInstanceGroups();
+
+	// draw all the instances in a group with one draw call, at
+	// a tessellation level of the group mesh
+	void DrawInstanceGroup(int groupHandle, int level = 0);
+
+	// true when the OpenGL context can offset the instance
+	// attributes of a draw call with a base instance
+	static bool IsBaseInstanceSupported();
+	// true when the OpenGL context can draw indirect commands
+	static bool IsIndirectSupported();
+	// replace the instance values that the indirect draw
+	// commands read from
+	void SetIndirectInstances(const std::vector<INSTANCE_DATA>& instances);
+	// build the indirect draw command for a range of the
+	// indirect instance values, drawn with a mesh level
+	DRAW_COMMAND MakeDrawCommand(
+		MESH_TYPE mesh,
+		int level,
+		GLuint firstInstance,
+		GLuint instanceCount) const;
+	// draw a list of indirect draw commands with one call
+	void DrawIndirect(const std::vector<DRAW_COMMAND>& commands);
+	// draw the indirect draw commands that are already in a
+	// buffer, taking the number of commands from a counter
+	// buffer when it is not 0
+	void DrawIndirectBuffer(GLuint commandBuffer, GLuint counterBuffer, GLsizei maxCommands);
+
+	// get the local bounding box of a shape mesh, which is the
+	// same for the generated and the ShapeMeshes library shapes
+	static void GetMeshBounds(MESH_TYPE mesh, glm::vec3& boundsMin, glm::vec3& boundsMax);
+};
@@ -0,0 +1,634 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// cook texture images into block compressed cache files and map them back
+//
+//	The first time that an image is loaded, its decoded pixels are cooked
+//	into a full mip chain, compressed to BC1 (RGB) or BC3 (RGBA) blocks and
+//	written to a cache file named after the hash of the source file. Every
+//	later launch memory-maps the cache file and uploads the blocks as they
+//	are, without decoding the image or generating the mipmaps.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// folder of the cache files, created on the first cook
+	const char* g_CacheFolder = "textures/cache";
+	// bumped whenever the cooked data changes
+	const unsigned int g_CacheVersion = 1;
+	// most mip levels of a cached texture, enough for any size
+	// that an int holds
+	const unsigned int g_MaxCacheLevels = 32;
+	const char g_CacheMagic[4] = { 'T', 'X', 'C', '1' };
+
+	// start of every cache file, followed by one CACHE_LEVEL
+	// per mip level and then the block data
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long sourceHash;
+		int width;
+		int height;
+		int colorChannels;
+		unsigned int format;
+		unsigned int levelCount;
+		unsigned int padding;
+	};
+
+	struct CACHE_LEVEL
+	{
+		int width;
+		int height;
+		unsigned long long offset;
+		unsigned long long size;
+	};
+
+	/***********************************************************
+	 *  GetCachePath()
+	 *
+	 *  This helper function is used for getting the path of the
+	 *  cache file for the passed in source contents hash.
+	 ***********************************************************/
+	std::string GetCachePath(unsigned long long sourceHash)
+	{
+		char name[32];
+
+		snprintf(name, sizeof(name), "/%016llx.txc", sourceHash);
+
+		return(std::string(g_CacheFolder) + name);
+	}
+
+	/***********************************************************
+	 *  PackColor565()
+	 *
+	 *  This helper function is used for packing an 8-bit RGB
+	 *  color into the 5:6:5 bits of a block endpoint.
+	 ***********************************************************/
+	unsigned short PackColor565(const unsigned char* rgb)
+	{
+		return (unsigned short)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+	}
+
+	/***********************************************************
+	 *  UnpackColor565()
+	 *
+	 *  This helper function is used for expanding the 5:6:5
+	 *  bits of a block endpoint into an 8-bit RGB color.
+	 ***********************************************************/
+	void UnpackColor565(unsigned short color, int* rgb)
+	{
+		int r = (color >> 11) & 0x1F;
+		int g = (color >> 5) & 0x3F;
+		int b = color & 0x1F;
+
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	/***********************************************************
+	 *  CompressColorBlock()
+	 *
+	 *  This helper function is used for compressing the colors
+	 *  of a 4x4 RGBA block into 8 bytes of BC1 data. The block
+	 *  endpoints are the corners of the color bounding box,
+	 *  and every pixel takes the closest of the four colors.
+	 ***********************************************************/
+	void CompressColorBlock(const unsigned char block[16][4], unsigned char* pOutput)
+	{
+		unsigned char minColor[3] = { 255, 255, 255 };
+		unsigned char maxColor[3] = { 0, 0, 0 };
+
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (block[i][c] < minColor[c]) minColor[c] = block[i][c];
+				if (block[i][c] > maxColor[c]) maxColor[c] = block[i][c];
+			}
+		}
+
+		unsigned short color0 = PackColor565(maxColor);
+		unsigned short color1 = PackColor565(minColor);
+		unsigned int indices = 0;
+
+		// the first endpoint must be the larger one for the four
+		// color mode - equal endpoints leave every index at 0
+		if (color0 < color1)
+		{
+			unsigned short swapColor = color0;
+			color0 = color1;
+			color1 = swapColor;
+		}
+
+		if (color0 != color1)
+		{
+			int palette[4][3];
+
+			UnpackColor565(color0, palette[0]);
+			UnpackColor565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestDistance = 0x7FFFFFFF;
+
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i][0] - palette[p][0];
+					int dg = block[i][1] - palette[p][1];
+					int db = block[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = p;
+					}
+				}
+				indices |= (unsigned int)bestIndex << (i * 2);
+			}
+		}
+
+		pOutput[0] = (unsigned char)(color0 & 0xFF);
+		pOutput[1] = (unsigned char)(color0 >> 8);
+		pOutput[2] = (unsigned char)(color1 & 0xFF);
+		pOutput[3] = (unsigned char)(color1 >> 8);
+		pOutput[4] = (unsigned char)(indices & 0xFF);
+		pOutput[5] = (unsigned char)((indices >> 8) & 0xFF);
+		pOutput[6] = (unsigned char)((indices >> 16) & 0xFF);
+		pOutput[7] = (unsigned char)(indices >> 24);
+	}
+
+	/***********************************************************
+	 *  CompressAlphaBlock()
+	 *
+	 *  This helper function is used for compressing the alpha
+	 *  values of a 4x4 RGBA block into the 8 bytes of BC3 alpha
+	 *  data, with eight alpha values between the block minimum
+	 *  and maximum.
+	 ***********************************************************/
+	void CompressAlphaBlock(const unsigned char block[16][4], unsigned char* pOutput)
+	{
+		int minAlpha = 255;
+		int maxAlpha = 0;
+		unsigned long long indices = 0;
+
+		for (int i = 0; i < 16; i++)
+		{
+			if (block[i][3] < minAlpha) minAlpha = block[i][3];
+			if (block[i][3] > maxAlpha) maxAlpha = block[i][3];
+		}
+
+		if (maxAlpha > minAlpha)
+		{
+			int palette[8];
+
+			palette[0] = maxAlpha;
+			palette[1] = minAlpha;
+			for (int p = 2; p < 8; p++)
+			{
+				palette[p] = ((8 - p) * maxAlpha + (p - 1) * minAlpha) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestDistance = 256;
+
+				for (int p = 0; p < 8; p++)
+				{
+					int distance = block[i][3] - palette[p];
+					if (distance < 0) distance = -distance;
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = p;
+					}
+				}
+				indices |= (unsigned long long)bestIndex << (i * 3);
+			}
+		}
+
+		pOutput[0] = (unsigned char)maxAlpha;
+		pOutput[1] = (unsigned char)minAlpha;
+		for (int i = 0; i < 6; i++)
+		{
+			pOutput[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF);
+		}
+	}
+
+	/***********************************************************
+	 *  CompressLevel()
+	 *
+	 *  This helper function is used for compressing one RGBA
+	 *  mip level into BC1 or BC3 blocks. The edge pixels are
+	 *  repeated to fill the blocks of levels smaller than 4x4.
+	 ***********************************************************/
+	void CompressLevel(
+		const unsigned char* rgba,
+		int width,
+		int height,
+		bool bHasAlpha,
+		unsigned char* pOutput)
+	{
+		for (int blockY = 0; blockY < height; blockY += 4)
+		{
+			for (int blockX = 0; blockX < width; blockX += 4)
+			{
+				unsigned char block[16][4];
+
+				for (int y = 0; y < 4; y++)
+				{
+					int sourceY = (blockY + y < height) ? blockY + y : height - 1;
+					for (int x = 0; x < 4; x++)
+					{
+						int sourceX = (blockX + x < width) ? blockX + x : width - 1;
+						memcpy(block[y * 4 + x], rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				if (bHasAlpha)
+				{
+					CompressAlphaBlock(block, pOutput);
+					pOutput += 8;
+				}
+				CompressColorBlock(block, pOutput);
+				pOutput += 8;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  DownsampleLevel()
+	 *
+	 *  This helper function is used for building the next mip
+	 *  level with a 2x2 box filter. Odd edges reuse their last
+	 *  row or column.
+	 ***********************************************************/
+	void DownsampleLevel(
+		const std::vector<unsigned char>& source,
+		int width,
+		int height,
+		std::vector<unsigned char>& target,
+		int targetWidth,
+		int targetHeight)
+	{
+		target.resize((size_t)targetWidth * targetHeight * 4);
+
+		for (int y = 0; y < targetHeight; y++)
+		{
+			int y0 = y * 2;
+			int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+			for (int x = 0; x < targetWidth; x++)
+			{
+				int x0 = x * 2;
+				int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = source[((size_t)y0 * width + x0) * 4 + c] +
+						source[((size_t)y0 * width + x1) * 4 + c] +
+						source[((size_t)y1 * width + x0) * 4 + c] +
+						source[((size_t)y1 * width + x1) * 4 + c];
+					target[((size_t)y * targetWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  CreateCacheFolder()
+	 *
+	 *  This helper function is used for creating the folder of
+	 *  the cache files when it does not exist yet.
+	 ***********************************************************/
+	void CreateCacheFolder()
+	{
+#ifdef _WIN32
+		_mkdir(g_CacheFolder);
+#else
+		mkdir(g_CacheFolder, 0755);
+#endif
+	}
+}
+
+/***********************************************************
+ *  HashFile()
+ *
+ *  This method is used for hashing the contents of a source
+ *  image file with 64-bit FNV-1a, so that an edited image
+ *  never matches the cache file of its old contents.
+ ***********************************************************/
+bool TextureCache::HashFile(const std::string& filename, unsigned long long& hash)
+{
+	FILE* pFile = fopen(filename.c_str(), "rb");
+	unsigned char buffer[65536];
+	size_t readSize = 0;
+
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+
+	hash = 14695981039346656037ull;
+	while ((readSize = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+	{
+		for (size_t i = 0; i < readSize; i++)
+		{
+			hash ^= buffer[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	fclose(pFile);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for memory-mapping the cache file
+ *  that belongs to the current contents of an image file.
+ ***********************************************************/
+TextureCache::CACHED_TEXTURE* TextureCache::Open(const std::string& filename)
+{
+	unsigned long long sourceHash = 0;
+
+	if (HashFile(filename, sourceHash) == false)
+	{
+		return(NULL);
+	}
+
+	std::string cachePath = GetCachePath(sourceHash);
+	CACHED_TEXTURE* pTexture = new CACHED_TEXTURE();
+	pTexture->pMapping = NULL;
+	pTexture->mappingSize = 0;
+
+#ifdef _WIN32
+	pTexture->hFile = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	pTexture->hMapping = NULL;
+	if (pTexture->hFile != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(pTexture->hFile, &fileSize);
+		pTexture->mappingSize = (size_t)fileSize.QuadPart;
+		pTexture->hMapping = CreateFileMappingA(pTexture->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL != pTexture->hMapping)
+		{
+			pTexture->pMapping = MapViewOfFile(pTexture->hMapping, FILE_MAP_READ, 0, 0, 0);
+		}
+	}
+#else
+	int fileDescriptor = open(cachePath.c_str(), O_RDONLY);
+	if (fileDescriptor >= 0)
+	{
+		struct stat fileStatus;
+		if ((fstat(fileDescriptor, &fileStatus) == 0) && (fileStatus.st_size > 0))
+		{
+			pTexture->mappingSize = (size_t)fileStatus.st_size;
+			void* pMapping = mmap(NULL, pTexture->mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+			if (pMapping != MAP_FAILED)
+			{
+				pTexture->pMapping = pMapping;
+			}
+		}
+		// the mapping stays valid after the file is closed
+		close(fileDescriptor);
+	}
+#endif
+
+	const CACHE_HEADER* pHeader = (const CACHE_HEADER*)pTexture->pMapping;
+	if ((NULL == pHeader) || (pTexture->mappingSize < sizeof(CACHE_HEADER)) ||
+		(memcmp(pHeader->magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0) ||
+		(pHeader->version != g_CacheVersion) || (pHeader->sourceHash != sourceHash))
+	{
+		Release(pTexture);
+		return(NULL);
+	}
+
+	// the level table must lie inside of the file before it is
+	// read - otherwise the image is decoded and cooked again
+	if ((pHeader->levelCount == 0) || (pHeader->levelCount > g_MaxCacheLevels) ||
+		(pHeader->width <= 0) || (pHeader->height <= 0) ||
+		(sizeof(CACHE_HEADER) + pHeader->levelCount * sizeof(CACHE_LEVEL) > pTexture->mappingSize))
+	{
+		Release(pTexture);
+		return(NULL);
+	}
+
+	size_t dataOffset = sizeof(CACHE_HEADER) + pHeader->levelCount * sizeof(CACHE_LEVEL);
+	const CACHE_LEVEL* pLevels = (const CACHE_LEVEL*)(pHeader + 1);
+
+	pTexture->width = pHeader->width;
+	pTexture->height = pHeader->height;
+	pTexture->colorChannels = pHeader->colorChannels;
+	pTexture->format = pHeader->format;
+	pTexture->pData = (const unsigned char*)pTexture->pMapping + dataOffset;
+	pTexture->dataSize = pTexture->mappingSize - dataOffset;
+
+	for (unsigned int i = 0; i < pHeader->levelCount; i++)
+	{
+		MIP_LEVEL level;
+		level.width = pLevels[i].width;
+		level.height = pLevels[i].height;
+		level.offset = (size_t)pLevels[i].offset;
+		level.size = (size_t)pLevels[i].size;
+
+		// a truncated cache file is cooked again
+		if ((level.size > pTexture->dataSize) || (level.offset > pTexture->dataSize - level.size))
+		{
+			Release(pTexture);
+			return(NULL);
+		}
+		pTexture->levels.push_back(level);
+	}
+
+	return(pTexture);
+}
+
+/***********************************************************
+ *  Cook()
+ *
+ *  This method is used for building the full mip chain of
+ *  decoded pixels, compressing every level into blocks and
+ *  writing the result to the cache file of the image. The
+ *  pixels are expected to be flipped already, just like the
+ *  ones that are uploaded directly.
+ ***********************************************************/
+TextureCache::CACHED_TEXTURE* TextureCache::Cook(
+	const std::string& filename,
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int colorChannels)
+{
+	unsigned long long sourceHash = 0;
+	bool bHasAlpha = (colorChannels == 4);
+	int blockSize = bHasAlpha ? 16 : 8;
+
+	if ((HashFile(filename, sourceHash) == false) || ((colorChannels != 3) && (colorChannels != 4)))
+	{
+		return(NULL);
+	}
+
+	CACHED_TEXTURE* pTexture = new CACHED_TEXTURE();
+	pTexture->width = width;
+	pTexture->height = height;
+	pTexture->colorChannels = colorChannels;
+	pTexture->format = bHasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	pTexture->pMapping = NULL;
+	pTexture->mappingSize = 0;
+#ifdef _WIN32
+	pTexture->hFile = INVALID_HANDLE_VALUE;
+	pTexture->hMapping = NULL;
+#endif
+
+	// expand the base level to RGBA, so that every level is
+	// filtered and compressed the same way
+	std::vector<unsigned char> level((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		level[i * 4 + 0] = pixels[i * colorChannels + 0];
+		level[i * 4 + 1] = pixels[i * colorChannels + 1];
+		level[i * 4 + 2] = pixels[i * colorChannels + 2];
+		level[i * 4 + 3] = bHasAlpha ? pixels[i * colorChannels + 3] : 255;
+	}
+
+	int levelWidth = width;
+	int levelHeight = height;
+	std::vector<unsigned char> nextLevel;
+	while (true)
+	{
+		MIP_LEVEL mip;
+		mip.width = levelWidth;
+		mip.height = levelHeight;
+		mip.offset = pTexture->cookedData.size();
+		mip.size = (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+		pTexture->levels.push_back(mip);
+
+		pTexture->cookedData.resize(mip.offset + mip.size);
+		CompressLevel(&level[0], levelWidth, levelHeight, bHasAlpha, &pTexture->cookedData[mip.offset]);
+
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+
+		int nextWidth = (levelWidth > 1) ? levelWidth / 2 : 1;
+		int nextHeight = (levelHeight > 1) ? levelHeight / 2 : 1;
+		DownsampleLevel(level, levelWidth, levelHeight, nextLevel, nextWidth, nextHeight);
+		level.swap(nextLevel);
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+
+	pTexture->pData = &pTexture->cookedData[0];
+	pTexture->dataSize = pTexture->cookedData.size();
+
+	// write to a temporary file first, so that another thread or
+	// launch never maps a half written cache file
+	CACHE_HEADER header;
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.sourceHash = sourceHash;
+	header.width = width;
+	header.height = height;
+	header.colorChannels = colorChannels;
+	header.format = pTexture->format;
+	header.levelCount = (unsigned int)pTexture->levels.size();
+	header.padding = 0;
+
+	std::vector<CACHE_LEVEL> levels(pTexture->levels.size());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		levels[i].width = pTexture->levels[i].width;
+		levels[i].height = pTexture->levels[i].height;
+		levels[i].offset = pTexture->levels[i].offset;
+		levels[i].size = pTexture->levels[i].size;
+	}
+
+	CreateCacheFolder();
+	std::string cachePath = GetCachePath(sourceHash);
+	std::string tempPath = cachePath + ".tmp";
+	FILE* pFile = fopen(tempPath.c_str(), "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not write texture cache file:" << tempPath << std::endl;
+		return(pTexture);
+	}
+
+	bool bWritten =
+		(fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+		(fwrite(&levels[0], sizeof(CACHE_LEVEL), levels.size(), pFile) == levels.size()) &&
+		(fwrite(pTexture->pData, 1, pTexture->dataSize, pFile) == pTexture->dataSize);
+	fclose(pFile);
+
+	remove(cachePath.c_str());
+	if ((bWritten == false) || (rename(tempPath.c_str(), cachePath.c_str()) != 0))
+	{
+		std::cout << "Could not write texture cache file:" << cachePath << std::endl;
+		remove(tempPath.c_str());
+	}
+
+	return(pTexture);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for unmapping the cache file of a
+ *  cached texture and freeing it.
+ ***********************************************************/
+void TextureCache::Release(CACHED_TEXTURE* pTexture)
+{
+	if (NULL == pTexture)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	if (NULL != pTexture->pMapping)
+	{
+		UnmapViewOfFile(pTexture->pMapping);
+	}
+	if (NULL != pTexture->hMapping)
+	{
+		CloseHandle(pTexture->hMapping);
+	}
+	if ((NULL != pTexture->hFile) && (INVALID_HANDLE_VALUE != pTexture->hFile))
+	{
+		CloseHandle(pTexture->hFile);
+	}
+#else
+	if (NULL != pTexture->pMapping)
+	{
+		munmap(pTexture->pMapping, pTexture->mappingSize);
+	}
+#endif
+
+	delete pTexture;
+}
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// cook texture images into block compressed cache files and map them back
+//
+//	The first time that an image is loaded, its decoded pixels are cooked
+//	into a full mip chain, compressed to BC1 (RGB) or BC3 (RGBA) blocks and
+//	written to a cache file named after the hash of the source file. Every
+//	later launch memory-maps the cache file and uploads the blocks as they
+//	are, without decoding the image or generating the mipmaps.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the code for cooking, writing and
+ *  mapping the cached texture files. All the methods are
+ *  safe to call from the texture loader worker threads, as
+ *  none of them calls into OpenGL.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// one level of the mip chain inside the texture data
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		size_t offset;
+		size_t size;
+	};
+
+	// a compressed texture with its full mip chain - the data
+	// either points into a mapped cache file or into the cooked
+	// bytes that were just written to it
+	struct CACHED_TEXTURE
+	{
+		int width;
+		int height;
+		int colorChannels;
+		GLenum format;
+		std::vector<MIP_LEVEL> levels;
+		const unsigned char* pData;
+		size_t dataSize;
+
+		// mapped cache file, released by Release()
+		void* pMapping;
+		size_t mappingSize;
+#ifdef _WIN32
+		void* hFile;
+		void* hMapping;
+#endif
+		// cooked bytes when the texture was not mapped
+		std::vector<unsigned char> cookedData;
+	};
+
+	// map the cache file of an image file - returns NULL when the
+	// cache file is missing or belongs to other source contents
+	static CACHED_TEXTURE* Open(const std::string& filename);
+	// cook decoded pixels into a cached texture and write the
+	// cache file for the next launch
+	static CACHED_TEXTURE* Cook(
+		const std::string& filename,
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int colorChannels);
+	// unmap or free a cached texture
+	static void Release(CACHED_TEXTURE* pTexture);
+
+	// hash the contents of a source image file
+	static bool HashFile(const std::string& filename, unsigned long long& hash);
+};
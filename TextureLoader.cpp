@@ -0,0 +1,519 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// ============
+// decode texture images on worker threads and stream them to OpenGL
+//
+//	The images are decoded by a small pool of worker threads. The rendering
+//	thread keeps a few pixel buffer objects mapped, and a worker writes the
+//	decoded pixels straight into a free one, so the rendering thread only
+//	unmaps the buffer and points the texture upload at it.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// most worker threads used when the count is not passed in
+	const int g_MaxDefaultWorkers = 4;
+
+	// upload buffers kept mapped for the workers, and the size
+	// that they start with - one RGBA image of 1024 x 1024
+	const int g_UploadBufferCount = 4;
+	const size_t g_UploadBufferSize = 1024 * 1024 * 4;
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(int workerCount)
+{
+	m_pendingCount = 0;
+	m_bStopping = false;
+	m_largestUpload = 0;
+	m_boundUploadBuffer = -1;
+	m_copyBuffer = 0;
+	m_bUseCache = (GLEW_EXT_texture_compression_s3tc == GL_TRUE);
+
+	if (workerCount <= 0)
+	{
+		workerCount = (int)std::thread::hardware_concurrency();
+		if (workerCount > g_MaxDefaultWorkers)
+		{
+			workerCount = g_MaxDefaultWorkers;
+		}
+		if (workerCount < 1)
+		{
+			workerCount = 1;
+		}
+	}
+
+	// the flip setting is global in the image library, so it is
+	// set one time before any worker starts decoding
+	stbi_set_flip_vertically_on_load(true);
+
+	// the loader is created on the rendering thread, which maps
+	// the upload buffers before any worker needs one
+	m_uploadBuffers.resize(g_UploadBufferCount);
+	for (int i = 0; i < g_UploadBufferCount; i++)
+	{
+		glGenBuffers(1, &m_uploadBuffers[i].buffer);
+		m_uploadBuffers[i].pMapped = NULL;
+		m_uploadBuffers[i].capacity = g_UploadBufferSize;
+		MapUploadBuffer(i);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureLoader::DecodeImages, this));
+	}
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_jobs.clear();
+	}
+	m_jobReady.notify_all();
+	m_uploadBufferFree.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+
+	// free the images that were never fetched
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		FreeImage(m_images[i]);
+	}
+	m_images.clear();
+
+	// deleting a mapped buffer unmaps it
+	for (size_t i = 0; i < m_uploadBuffers.size(); i++)
+	{
+		glDeleteBuffers(1, &m_uploadBuffers[i].buffer);
+	}
+	m_uploadBuffers.clear();
+	if (0 != m_copyBuffer)
+	{
+		glDeleteBuffers(1, &m_copyBuffer);
+	}
+}
+
+/***********************************************************
+ *  RequestImage()
+ *
+ *  This method is used for queueing an image file to be
+ *  decoded by the next free worker thread.
+ ***********************************************************/
+void TextureLoader::RequestImage(int handle, const std::string& filename)
+{
+	DECODE_JOB job;
+	job.handle = handle;
+	job.filename = filename;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+		m_pendingCount++;
+	}
+	m_jobReady.notify_one();
+}
+
+/***********************************************************
+ *  FetchDecodedImage()
+ *
+ *  This method is used for taking the next decoded image
+ *  without waiting for one. The caller owns the pixels.
+ ***********************************************************/
+bool TextureLoader::FetchDecodedImage(DECODED_IMAGE& image)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_images.empty())
+	{
+		return(false);
+	}
+
+	image = m_images.front();
+	m_images.pop_front();
+	m_pendingCount--;
+
+	return(true);
+}
+
+/***********************************************************
+ *  WaitDecodedImage()
+ *
+ *  This method is used for taking the next decoded image,
+ *  waiting for a worker thread to finish one if needed.
+ ***********************************************************/
+bool TextureLoader::WaitDecodedImage(DECODED_IMAGE& image)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (m_images.empty())
+	{
+		if (m_pendingCount == 0)
+		{
+			return(false);
+		}
+		m_imageReady.wait(lock);
+	}
+
+	image = m_images.front();
+	m_images.pop_front();
+	m_pendingCount--;
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetPendingCount()
+ *
+ *  This method is used for getting the number of requested
+ *  images that were not fetched yet.
+ ***********************************************************/
+int TextureLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return(m_pendingCount);
+}
+
+/***********************************************************
+ *  GetReadyCount()
+ *
+ *  This method is used for getting the number of decoded
+ *  images that are waiting to be fetched.
+ ***********************************************************/
+int TextureLoader::GetReadyCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return((int)m_images.size());
+}
+
+/***********************************************************
+ *  BeginUpload()
+ *
+ *  This method is used for leaving the pixel buffer object
+ *  that holds an image bound as the unpack buffer. A worker
+ *  thread has already written the image into its upload
+ *  buffer, which is only unmapped here. An image that did
+ *  not fit into one is copied into the copy buffer instead,
+ *  whose storage is orphaned first so that the copy never
+ *  waits for an upload that the driver still reads from.
+ ***********************************************************/
+void TextureLoader::BeginUpload(DECODED_IMAGE& image)
+{
+	if (image.uploadBuffer >= 0)
+	{
+		m_boundUploadBuffer = image.uploadBuffer;
+		image.uploadBuffer = -1;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffers[m_boundUploadBuffer].buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// rows of RGB images are not always 4-byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		return;
+	}
+
+	GLsizeiptr size = (GLsizeiptr)image.width * image.height * image.colorChannels;
+	const void* pSource = image.pixels;
+
+	if (NULL != image.pCached)
+	{
+		size = (GLsizeiptr)image.pCached->dataSize;
+		pSource = image.pCached->pData;
+	}
+
+	if (0 == m_copyBuffer)
+	{
+		glGenBuffers(1, &m_copyBuffer);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_copyBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* pBuffer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (NULL != pBuffer)
+	{
+		memcpy(pBuffer, pSource, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, pSource);
+	}
+
+	// rows of RGB images are not always 4-byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
+/***********************************************************
+ *  EndUpload()
+ *
+ *  This method is used for mapping the upload buffer again
+ *  for the next image, and unbinding the unpack buffer after
+ *  the texture upload calls, so that later uploads read from
+ *  client memory again.
+ ***********************************************************/
+void TextureLoader::EndUpload()
+{
+	if (m_boundUploadBuffer >= 0)
+	{
+		MapUploadBuffer(m_boundUploadBuffer);
+		m_boundUploadBuffer = -1;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+/***********************************************************
+ *  FreeImage()
+ *
+ *  This method is used for freeing the decoded pixels or the
+ *  cached texture of an image. An upload buffer that the
+ *  image was never uploaded from is still mapped, so it is
+ *  only given back.
+ ***********************************************************/
+void TextureLoader::FreeImage(DECODED_IMAGE& image)
+{
+	if (image.uploadBuffer >= 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freeUploadBuffers.push_back(image.uploadBuffer);
+		}
+		m_uploadBufferFree.notify_all();
+		image.uploadBuffer = -1;
+	}
+
+	if (NULL != image.pixels)
+	{
+		stbi_image_free(image.pixels);
+		image.pixels = NULL;
+	}
+	if (NULL != image.pCached)
+	{
+		TextureCache::Release(image.pCached);
+		image.pCached = NULL;
+	}
+}
+
+/***********************************************************
+ *  DecodeImages()
+ *
+ *  This method is used by every worker thread for decoding
+ *  the queued image files, one at a time, until the loader
+ *  is stopped. With the texture cache, a cache file that
+ *  matches the image is mapped instead of decoding it, and
+ *  a decoded image is cooked into a new cache file.
+ ***********************************************************/
+void TextureLoader::DecodeImages()
+{
+	while (true)
+	{
+		DECODE_JOB job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ((m_jobs.empty()) && (m_bStopping == false))
+			{
+				m_jobReady.wait(lock);
+			}
+			if (m_bStopping)
+			{
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		DECODED_IMAGE image;
+		image.handle = job.handle;
+		image.filename = job.filename;
+		image.pixels = NULL;
+		image.pCached = NULL;
+		image.uploadBuffer = -1;
+		image.bFromCache = false;
+		image.width = 0;
+		image.height = 0;
+		image.colorChannels = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (m_bUseCache)
+		{
+			image.pCached = TextureCache::Open(job.filename);
+		}
+		if (NULL != image.pCached)
+		{
+			image.bFromCache = true;
+			image.width = image.pCached->width;
+			image.height = image.pCached->height;
+			image.colorChannels = image.pCached->colorChannels;
+		}
+		else
+		{
+			image.pixels = stbi_load(
+				job.filename.c_str(),
+				&image.width,
+				&image.height,
+				&image.colorChannels,
+				0);
+
+			if ((m_bUseCache) && (NULL != image.pixels))
+			{
+				image.pCached = TextureCache::Cook(
+					job.filename, image.pixels, image.width, image.height, image.colorChannels);
+				if (NULL != image.pCached)
+				{
+					stbi_image_free(image.pixels);
+					image.pixels = NULL;
+				}
+			}
+		}
+		// write the image into a mapped upload buffer, so that the
+		// rendering thread does not have to copy it
+		if ((NULL != image.pixels) || (NULL != image.pCached))
+		{
+			size_t size = (size_t)image.width * image.height * image.colorChannels;
+			const void* pSource = image.pixels;
+			if (NULL != image.pCached)
+			{
+				size = image.pCached->dataSize;
+				pSource = image.pCached->pData;
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				image.uploadBuffer = AcquireUploadBuffer(size, lock);
+			}
+			if (image.uploadBuffer >= 0)
+			{
+				memcpy(m_uploadBuffers[image.uploadBuffer].pMapped, pSource, size);
+				if (NULL != image.pixels)
+				{
+					stbi_image_free(image.pixels);
+					image.pixels = NULL;
+				}
+			}
+		}
+		image.decodeMs = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_images.push_back(image);
+		}
+		m_imageReady.notify_all();
+	}
+}
+
+/***********************************************************
+ *  AcquireUploadBuffer()
+ *
+ *  This method is used by the worker threads for taking a
+ *  free upload buffer that an image fits into. When only busy
+ *  buffers are large enough, the worker waits for one of them
+ *  to be mapped again - every busy buffer belongs to an image
+ *  that the rendering thread uploads or frees. The mutex must
+ *  be held.
+ ***********************************************************/
+int TextureLoader::AcquireUploadBuffer(size_t size, std::unique_lock<std::mutex>& lock)
+{
+	while (m_bStopping == false)
+	{
+		bool bFits = false;
+
+		for (size_t i = 0; i < m_freeUploadBuffers.size(); i++)
+		{
+			int index = m_freeUploadBuffers[i];
+			if (m_uploadBuffers[index].capacity >= size)
+			{
+				m_freeUploadBuffers.erase(m_freeUploadBuffers.begin() + i);
+				return(index);
+			}
+		}
+		for (size_t i = 0; i < m_uploadBuffers.size(); i++)
+		{
+			if (m_uploadBuffers[i].capacity >= size)
+			{
+				bFits = true;
+			}
+		}
+
+		// the buffers grow to the image the next time that they
+		// are mapped, and this one is copied by the rendering thread
+		if (bFits == false)
+		{
+			if (size > m_largestUpload)
+			{
+				m_largestUpload = size;
+			}
+			return(-1);
+		}
+		m_uploadBufferFree.wait(lock);
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  MapUploadBuffer()
+ *
+ *  This method is used by the rendering thread for giving an
+ *  upload buffer new storage and mapping it, so that a
+ *  worker thread can write the next image into it. The old
+ *  storage is orphaned, so the upload that still reads from
+ *  it is never waited for. The buffer is left bound.
+ ***********************************************************/
+void TextureLoader::MapUploadBuffer(int index)
+{
+	UPLOAD_BUFFER& upload = m_uploadBuffers[index];
+	size_t capacity = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		capacity = (upload.capacity > m_largestUpload) ? upload.capacity : m_largestUpload;
+		if (capacity < g_UploadBufferSize)
+		{
+			capacity = g_UploadBufferSize;
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)capacity, NULL, GL_STREAM_DRAW);
+	void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)capacity,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		upload.pMapped = pMapped;
+		upload.capacity = (NULL != pMapped) ? capacity : 0;
+		if (NULL != pMapped)
+		{
+			m_freeUploadBuffers.push_back(index);
+		}
+	}
+	m_uploadBufferFree.notify_all();
+}
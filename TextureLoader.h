@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// decode texture images on worker threads and stream them to OpenGL
+//
+//	The images are decoded by a small pool of worker threads. The rendering
+//	thread keeps a few pixel buffer objects mapped, and a worker writes the
+//	decoded pixels straight into a free one, so the rendering thread only
+//	unmaps the buffer and points the texture upload at it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "TextureCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class queues texture image files for decoding on a
+ *  pool of worker threads. Only the rendering thread calls
+ *  into OpenGL - it fetches the decoded images one at a time
+ *  and uploads each one between BeginUpload() and
+ *  EndUpload().
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor - a worker count of 0 uses one worker per
+	// hardware thread, up to four
+	TextureLoader(int workerCount = 0);
+	// destructor
+	~TextureLoader();
+
+	// an image decoded by a worker thread - the pixels are set
+	// when they did not fit into an upload buffer, the cached
+	// texture is set for a cached image, and neither is set and
+	// no upload buffer is held when the file could not be decoded
+	struct DECODED_IMAGE
+	{
+		int handle;
+		std::string filename;
+		unsigned char* pixels;
+		TextureCache::CACHED_TEXTURE* pCached;
+		// upload buffer holding the pixels or the compressed mip
+		// chain, or -1 when they stay in client memory
+		int uploadBuffer;
+		bool bFromCache;
+		int width;
+		int height;
+		int colorChannels;
+		double decodeMs;
+	};
+
+	// queue an image file for decoding under the passed in handle
+	void RequestImage(int handle, const std::string& filename);
+	// take the next decoded image without waiting - returns false
+	// when no image has finished decoding yet
+	bool FetchDecodedImage(DECODED_IMAGE& image);
+	// wait until the next decoded image is ready - returns false
+	// when no image is queued or decoding anymore
+	bool WaitDecodedImage(DECODED_IMAGE& image);
+	// number of images that were requested and not fetched yet
+	int GetPendingCount();
+	// number of decoded images waiting to be fetched
+	int GetReadyCount();
+
+	// bind the pixel buffer object holding the image, so that
+	// the following texture upload calls read from it with buffer
+	// offsets - the image keeps no upload buffer after this
+	void BeginUpload(DECODED_IMAGE& image);
+	// unbind the pixel buffer object after the upload calls, and
+	// map it again for the next image
+	void EndUpload();
+	// free the decoded pixels or cached texture of an image, and
+	// give back an upload buffer that it still holds
+	void FreeImage(DECODED_IMAGE& image);
+
+private:
+	// an image file waiting for a worker thread
+	struct DECODE_JOB
+	{
+		int handle;
+		std::string filename;
+	};
+
+	// decoding worker threads
+	std::vector<std::thread> m_workers;
+	// guards the job and result queues and the stop flag
+	std::mutex m_mutex;
+	// signalled when a job is queued or the workers must stop
+	std::condition_variable m_jobReady;
+	// signalled when a decoded image is queued
+	std::condition_variable m_imageReady;
+	// image files waiting for a worker thread
+	std::deque<DECODE_JOB> m_jobs;
+	// decoded images waiting for the rendering thread
+	std::deque<DECODED_IMAGE> m_images;
+	// number of requested images that were not fetched yet
+	int m_pendingCount;
+	// true when the workers must stop
+	bool m_bStopping;
+	// true when the images go through the compressed texture
+	// cache, which needs the S3TC block formats
+	bool m_bUseCache;
+
+	// a pixel buffer object that stays mapped while it waits for
+	// an image, so that a worker thread can write into it - the
+	// capacity is 0 when it could not be mapped
+	struct UPLOAD_BUFFER
+	{
+		GLuint buffer;
+		void* pMapped;
+		size_t capacity;
+	};
+	// upload buffers, whose mapping and capacity are guarded by
+	// the mutex
+	std::vector<UPLOAD_BUFFER> m_uploadBuffers;
+	// mapped upload buffers that no image holds
+	std::vector<int> m_freeUploadBuffers;
+	// signalled when an upload buffer is mapped again
+	std::condition_variable m_uploadBufferFree;
+	// size of the largest image that did not fit into an upload
+	// buffer, which the buffers grow to when they are mapped again
+	size_t m_largestUpload;
+	// upload buffer bound by BeginUpload(), used only by the
+	// rendering thread
+	int m_boundUploadBuffer;
+	// pixel buffer object that the images in client memory are
+	// copied into for the upload
+	GLuint m_copyBuffer;
+
+	// decode the queued image files until stopping
+	void DecodeImages();
+	// take a free upload buffer that an image of the passed in
+	// size fits into, waiting while one is only busy - returns -1
+	// when none is large enough or the loader is stopping
+	int AcquireUploadBuffer(size_t size, std::unique_lock<std::mutex>& lock);
+	// map an upload buffer for the next image and free it
+	void MapUploadBuffer(int index);
+};
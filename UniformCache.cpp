@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// cache the shader uniform locations for a linked shader program
+//
+//	Used by the scene and view managers so that the per-frame draw code
+//	never has to resolve a uniform by name.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+#include "GLStateCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// one location cache for every shader program that was used
+	std::unordered_map<GLuint, UniformCache*> g_ProgramCaches;
+}
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache(GLuint programID)
+{
+	m_programID = programID;
+	m_resolvedCount = 0;
+}
+
+/***********************************************************
+ *  IsCurrentValue()
+ *
+ *  This method is used for checking whether a location
+ *  already holds the passed in value. A changed value is
+ *  shadowed before returning, since the caller sends it.
+ ***********************************************************/
+bool UniformCache::IsCurrentValue(GLint location, const void* pValue, size_t size)
+{
+	if (location >= (GLint)m_shadowValues.size())
+	{
+		SHADOW_VALUE unknownValue = {};
+		m_shadowValues.resize(location + 1, unknownValue);
+	}
+
+	SHADOW_VALUE& shadow = m_shadowValues[location];
+	if ((shadow.bValid) && (memcmp(shadow.data, pValue, size) == 0))
+	{
+		GLStateCache::CountUniform(true);
+		return(true);
+	}
+
+	memcpy(shadow.data, pValue, size);
+	shadow.bValid = true;
+	GLStateCache::CountUniform(false);
+
+	return(false);
+}
+
+/***********************************************************
+ *  InvalidateValues()
+ *
+ *  This method is used for forgetting all the shadowed
+ *  values, so that the next value of every uniform is sent.
+ ***********************************************************/
+void UniformCache::InvalidateValues()
+{
+	for (size_t i = 0; i < m_shadowValues.size(); i++)
+	{
+		m_shadowValues[i].bValid = false;
+	}
+}
+
+/***********************************************************
+ *  ForProgram()
+ *
+ *  This method is used for getting the location cache that
+ *  belongs to the passed in shader program. The cache is
+ *  created the first time that the program is requested.
+ ***********************************************************/
+UniformCache* UniformCache::ForProgram(GLuint programID)
+{
+	std::unordered_map<GLuint, UniformCache*>::iterator it = g_ProgramCaches.find(programID);
+	if (it != g_ProgramCaches.end())
+	{
+		return(it->second);
+	}
+
+	UniformCache* cache = new UniformCache(programID);
+	g_ProgramCaches[programID] = cache;
+
+	return(cache);
+}
+
+/***********************************************************
+ *  ForCurrentProgram()
+ *
+ *  This method is used for getting the location cache that
+ *  belongs to the shader program currently in use.
+ ***********************************************************/
+UniformCache* UniformCache::ForCurrentProgram()
+{
+	GLint programID = 0;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	if (programID == 0)
+	{
+		std::cout << "No shader program is in use for the uniform cache" << std::endl;
+	}
+
+	return(ForProgram((GLuint)programID));
+}
+
+/***********************************************************
+ *  DestroyAll()
+ *
+ *  This method is used for freeing the location caches of
+ *  all the shader programs.
+ ***********************************************************/
+void UniformCache::DestroyAll()
+{
+	std::unordered_map<GLuint, UniformCache*>::iterator it;
+	for (it = g_ProgramCaches.begin(); it != g_ProgramCaches.end(); it++)
+	{
+		delete it->second;
+	}
+	g_ProgramCaches.clear();
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  This method is used for getting the location handle of
+ *  the uniform with the passed in name. Only the first call
+ *  for each name goes to OpenGL - names that the program
+ *  does not have are remembered with a location of -1.
+ ***********************************************************/
+UniformCache::UNIFORM_HANDLE UniformCache::Resolve(const std::string& name)
+{
+	UNIFORM_HANDLE handle;
+
+	std::unordered_map<std::string, GLint>::iterator it = m_locations.find(name);
+	if (it != m_locations.end())
+	{
+		handle.location = it->second;
+		return(handle);
+	}
+
+	handle.location = glGetUniformLocation(m_programID, name.c_str());
+	m_locations[name] = handle.location;
+	m_resolvedCount++;
+
+	if (handle.location < 0)
+	{
+		std::cout << "Uniform not found in shader program:" << name << std::endl;
+	}
+
+	return(handle);
+}
+
+/***********************************************************
+ *  SetBoolValue()
+ *
+ *  This method is used for setting a boolean uniform value.
+ ***********************************************************/
+void UniformCache::SetBoolValue(UNIFORM_HANDLE handle, bool value)
+{
+	int intValue = (int)value;
+
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, &intValue, sizeof(intValue)) == false))
+	{
+		glUniform1i(handle.location, intValue);
+	}
+}
+
+/***********************************************************
+ *  SetIntValue()
+ *
+ *  This method is used for setting an integer uniform value.
+ ***********************************************************/
+void UniformCache::SetIntValue(UNIFORM_HANDLE handle, int value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, &value, sizeof(value)) == false))
+	{
+		glUniform1i(handle.location, value);
+	}
+}
+
+/***********************************************************
+ *  SetFloatValue()
+ *
+ *  This method is used for setting a float uniform value.
+ ***********************************************************/
+void UniformCache::SetFloatValue(UNIFORM_HANDLE handle, float value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, &value, sizeof(value)) == false))
+	{
+		glUniform1f(handle.location, value);
+	}
+}
+
+/***********************************************************
+ *  SetVec2Value()
+ *
+ *  This method is used for setting a vec2 uniform value.
+ ***********************************************************/
+void UniformCache::SetVec2Value(UNIFORM_HANDLE handle, const glm::vec2& value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, glm::value_ptr(value), sizeof(value)) == false))
+	{
+		glUniform2fv(handle.location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetVec3Value()
+ *
+ *  This method is used for setting a vec3 uniform value.
+ ***********************************************************/
+void UniformCache::SetVec3Value(UNIFORM_HANDLE handle, const glm::vec3& value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, glm::value_ptr(value), sizeof(value)) == false))
+	{
+		glUniform3fv(handle.location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetVec4Value()
+ *
+ *  This method is used for setting a vec4 uniform value.
+ ***********************************************************/
+void UniformCache::SetVec4Value(UNIFORM_HANDLE handle, const glm::vec4& value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, glm::value_ptr(value), sizeof(value)) == false))
+	{
+		glUniform4fv(handle.location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetMat4Value()
+ *
+ *  This method is used for setting a mat4 uniform value.
+ ***********************************************************/
+void UniformCache::SetMat4Value(UNIFORM_HANDLE handle, const glm::mat4& value)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, glm::value_ptr(value), sizeof(value)) == false))
+	{
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetSampler2DValue()
+ *
+ *  This method is used for setting the texture slot of a
+ *  sampler2D uniform.
+ ***********************************************************/
+void UniformCache::SetSampler2DValue(UNIFORM_HANDLE handle, int slot)
+{
+	if ((handle.location >= 0) && (IsCurrentValue(handle.location, &slot, sizeof(slot)) == false))
+	{
+		glUniform1i(handle.location, slot);
+	}
+}
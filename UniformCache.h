@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// cache the shader uniform locations for a linked shader program
+//
+//	Used by the scene and view managers so that the per-frame draw code
+//	never has to resolve a uniform by name.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class resolves uniform names into locations once per
+ *  shader program and hands back handles that the callers can
+ *  hold on to. Uniforms that do not exist in the program are
+ *  cached as well, so a missing name is only looked up once.
+ *  The last value set for every location is shadowed, and a
+ *  value that is already current is not sent again.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// pre-resolved uniform location - a location of -1 means
+	// that the uniform does not exist in the shader program
+	struct UNIFORM_HANDLE
+	{
+		GLint location;
+	};
+
+	// get the location cache for the passed in shader program
+	static UniformCache* ForProgram(GLuint programID);
+	// get the location cache for the shader program in use
+	static UniformCache* ForCurrentProgram();
+	// free the location caches for all the shader programs
+	static void DestroyAll();
+
+	// resolve a uniform name into a location handle
+	UNIFORM_HANDLE Resolve(const std::string& name);
+
+	// the following methods set the uniform values for
+	// previously resolved location handles - setting the value
+	// that a uniform already has does not reach OpenGL
+	void SetBoolValue(UNIFORM_HANDLE handle, bool value);
+	void SetIntValue(UNIFORM_HANDLE handle, int value);
+	void SetFloatValue(UNIFORM_HANDLE handle, float value);
+	void SetVec2Value(UNIFORM_HANDLE handle, const glm::vec2& value);
+	void SetVec3Value(UNIFORM_HANDLE handle, const glm::vec3& value);
+	void SetVec4Value(UNIFORM_HANDLE handle, const glm::vec4& value);
+	void SetMat4Value(UNIFORM_HANDLE handle, const glm::mat4& value);
+	void SetSampler2DValue(UNIFORM_HANDLE handle, int slot);
+
+	// forget the shadowed values after the uniforms were set
+	// without going through this cache
+	void InvalidateValues();
+
+	// get the shader program that owns the cached locations
+	GLuint GetProgramID() const { return m_programID; }
+	// total number of names that were resolved through OpenGL
+	int GetResolvedCount() const { return m_resolvedCount; }
+
+private:
+	// constructor - use ForProgram() to get a cache
+	UniformCache(GLuint programID);
+
+	// shader program that owns the cached locations
+	GLuint m_programID;
+	// resolved uniform locations, including the missing ones
+	std::unordered_map<std::string, GLint> m_locations;
+	// total number of names that were resolved through OpenGL
+	int m_resolvedCount;
+
+	// last value set for a uniform location - sized for the
+	// largest uniform type, which is a mat4
+	struct SHADOW_VALUE
+	{
+		GLfloat data[16];
+		bool bValid;
+	};
+	// shadowed values indexed by the uniform location
+	std::vector<SHADOW_VALUE> m_shadowValues;
+
+	// compare a value against the shadowed value of a location
+	// and remember it - returns true when nothing changed
+	bool IsCurrentValue(GLint location, const void* pValue, size_t size);
+};
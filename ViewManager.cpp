@@ -47,6 +47,15 @@ namespace
 
 	// flag to track if this is the first mouse movement
 	bool gFirstMouse = true;
+
+	// flag to track if the window was resized or uncovered since
+	// the last frame, which needs the frame to be drawn again
+	bool gWindowChanged = false;
+
+	// size of the window framebuffer in pixels, which the aspect
+	// ratio of the projection is taken from
+	int gFramebufferWidth = WINDOW_WIDTH;
+	int gFramebufferHeight = WINDOW_HEIGHT;
 }
 
 /***********************************************************
@@ -60,6 +69,9 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_pUniformCache = NULL;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -78,6 +90,7 @@ ViewManager::~ViewManager()
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
+	m_pUniformCache = NULL;
 	if (NULL != g_pCamera)
 	{
 		delete g_pCamera;
@@ -117,6 +130,14 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// this callback is used to receive mouse scroll events for adjusting camera speed
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Callback);
 
+	// these callbacks are used to receive the window changes that
+	// need the frame to be drawn again
+	glfwSetWindowRefreshCallback(window, &ViewManager::Window_Refresh_Callback);
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Framebuffer_Size_Callback);
+	// the framebuffer can be larger than the window on high
+	// density displays, and no size callback comes for it
+	glfwGetFramebufferSize(window, &gFramebufferWidth, &gFramebufferHeight);
+
 	// enable blending for supporting tranparent rendering
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -126,13 +147,29 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	return(window);
 }
 
+/***********************************************************
+ *  UseOffscreenView()
+ *
+ *  This method is used for setting up the same rendering
+ *  state as the display window when the frames are drawn
+ *  offscreen. There are no input events without a window.
+ ***********************************************************/
+void ViewManager::UseOffscreenView()
+{
+	// enable blending for supporting tranparent rendering
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	m_pWindow = NULL;
+}
+
 /***********************************************************
  *  Mouse_Position_Callback()
  *
  *  This method is automatically called from GLFW whenever
  *  the mouse is moved within the active GLFW display window.
  ***********************************************************/
-void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
+void ViewManager::Mouse_Position_Callback(GLFWwindow* /*window*/, double xMousePos, double yMousePos)
 {
 	if (gFirstMouse)
 	{
@@ -160,7 +197,7 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
  *  the mouse scroll wheel is used. It adjusts the camera
  *  movement speed based on scroll input.
  ***********************************************************/
-void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset)
+void ViewManager::Mouse_Scroll_Callback(GLFWwindow* /*window*/, double /*xOffset*/, double yOffset)
 {
 	// process the scroll wheel movement to adjust camera speed
 	if (g_pCamera)
@@ -168,6 +205,51 @@ void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, doub
 		g_pCamera->ProcessMouseScroll(static_cast<float>(yOffset));
 	}
 }
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the contents of the display window were lost, such as
+ *  after it was uncovered or restored.
+ ***********************************************************/
+void ViewManager::Window_Refresh_Callback(GLFWwindow* /*window*/)
+{
+	gWindowChanged = true;
+}
+
+/***********************************************************
+ *  Framebuffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the display window is resized. The viewport is set to
+ *  the new size, and the projection of the next frame takes
+ *  its aspect ratio. A minimized window keeps the last size.
+ ***********************************************************/
+void ViewManager::Framebuffer_Size_Callback(GLFWwindow* /*window*/, int width, int height)
+{
+	if ((width > 0) && (height > 0))
+	{
+		gFramebufferWidth = width;
+		gFramebufferHeight = height;
+		glViewport(0, 0, width, height);
+	}
+	gWindowChanged = true;
+}
+
+/***********************************************************
+ *  TakeWindowChanged()
+ *
+ *  This method is used for finding out whether the display
+ *  window was resized or uncovered since the last call.
+ ***********************************************************/
+bool ViewManager::TakeWindowChanged()
+{
+	bool bChanged = gWindowChanged;
+	gWindowChanged = false;
+
+	return(bChanged);
+}
+
  /***********************************************************
   *  ProcessKeyboardEvents()
   *
@@ -256,24 +338,43 @@ void ViewManager::ProcessKeyboardEvents()
  *  rendering
  ***********************************************************/
 void ViewManager::PrepareSceneView()
+{
+	UpdateCameraView();
+	ApplyCameraView(m_viewMatrix, m_projectionMatrix, g_pCamera->Position);
+}
+
+/***********************************************************
+ *  UpdateCameraView()
+ *
+ *  This method is used for moving the camera with the input
+ *  of the display window, and for building the view and
+ *  projection matrices of the frame without setting them
+ *  into the shader.
+ ***********************************************************/
+void ViewManager::UpdateCameraView()
 {
 	glm::mat4 view;
 	glm::mat4 projection;
+	GLfloat aspectRatio = (GLfloat)gFramebufferWidth / (GLfloat)gFramebufferHeight;
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// process any keyboard events that may be waiting in the
-	// event queue
-	ProcessKeyboardEvents();
+	// the offscreen view has no window to take input from
+	if (NULL != m_pWindow)
+	{
+		// per-frame timing
+		float currentFrame = glfwGetTime();
+		gDeltaTime = currentFrame - gLastFrame;
+		gLastFrame = currentFrame;
+
+		// process any keyboard events that may be waiting in the
+		// event queue
+		ProcessKeyboardEvents();
+	}
 
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
 
 	// define the current projection matrix
-	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+	projection = glm::perspective(glm::radians(g_pCamera->Zoom), aspectRatio, 0.1f, 100.0f);
 
 
 
@@ -282,10 +383,11 @@ void ViewManager::PrepareSceneView()
 	{
 		// orthographic projection - creates a 2D view
 		// the view volume is defined by left, right, bottom, top, near, far planes
+		// and its width follows the aspect ratio of the window
 		float orthoScale = 10.0f;
 		projection = glm::ortho(
-			-((GLfloat)WINDOW_WIDTH / 100.0f) * orthoScale,  // left
-			((GLfloat)WINDOW_WIDTH / 100.0f) * orthoScale,   // right
+			-((GLfloat)WINDOW_HEIGHT / 100.0f) * orthoScale * aspectRatio,  // left
+			((GLfloat)WINDOW_HEIGHT / 100.0f) * orthoScale * aspectRatio,   // right
 			-((GLfloat)WINDOW_HEIGHT / 100.0f) * orthoScale, // bottom
 			((GLfloat)WINDOW_HEIGHT / 100.0f) * orthoScale,  // top
 			0.1f,   // near plane
@@ -297,21 +399,135 @@ void ViewManager::PrepareSceneView()
 		// perspective projection - creates a 3D view with depth
 		projection = glm::perspective(
 			glm::radians(g_pCamera->Zoom),                           // field of view
-			(GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT,          // aspect ratio
+			aspectRatio,                                              // aspect ratio
 			0.1f,                                                     // near plane
 			100.0f                                                    // far plane
 		);
 	}
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
+	// keep the matrices for the scene manager to sort and cull with
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+}
+
+/***********************************************************
+ *  ApplyCameraView()
+ *
+ *  This method is used for setting a camera view into the
+ *  shader, which can be a view prepared for an earlier frame.
+ ***********************************************************/
+void ViewManager::ApplyCameraView(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& position)
+{
+	// resolve the view uniforms the first time a frame is prepared,
+	// since the shader program is not loaded when the view manager
+	// is constructed
+	if ((NULL == m_pUniformCache) && (NULL != m_pShaderManager))
+	{
+		m_pUniformCache = UniformCache::ForCurrentProgram();
+		m_viewUniform = m_pUniformCache->Resolve(g_ViewName);
+		m_projectionUniform = m_pUniformCache->Resolve(g_ProjectionName);
+		m_viewPositionUniform = m_pUniformCache->Resolve("viewPosition");
+	}
+
+	// if the uniform cache object is valid
+	if (NULL != m_pUniformCache)
 	{
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
+		m_pUniformCache->SetMat4Value(m_viewUniform, view);
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		m_pUniformCache->SetMat4Value(m_projectionUniform, projection);
 		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		m_pUniformCache->SetVec3Value(m_viewPositionUniform, position);
 	}
 
 
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  This method is used for getting the position of the
+ *  camera in the 3D scene.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition() const
+{
+	if (NULL == g_pCamera)
+	{
+		return(glm::vec3(0.0f, 0.0f, 0.0f));
+	}
+
+	return(g_pCamera->Position);
+}
+
+/***********************************************************
+ *  GetCameraFront()
+ *
+ *  This method is used for getting the direction that the
+ *  camera looks along.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraFront() const
+{
+	if (NULL == g_pCamera)
+	{
+		return(glm::vec3(0.0f, 0.0f, -1.0f));
+	}
+
+	return(g_pCamera->Front);
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  This method is used for placing the camera at a position
+ *  in the 3D scene, looking along the passed in direction.
+ *  The yaw and pitch angles and the right and up vectors are
+ *  worked out from the direction the same way the mouse
+ *  movement does it, so that the next mouse or keyboard
+ *  input continues from the new pose.
+ ***********************************************************/
+void ViewManager::SetCameraPose(const glm::vec3& position, const glm::vec3& front)
+{
+	if (NULL == g_pCamera)
+	{
+		return;
+	}
+
+	glm::vec3 direction = glm::normalize(front);
+
+	g_pCamera->Position = position;
+	g_pCamera->Front = direction;
+	g_pCamera->Yaw = glm::degrees(glm::atan(direction.z, direction.x));
+	g_pCamera->Pitch = glm::degrees(glm::asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+
+	// looking straight up or down keeps the last right vector
+	glm::vec3 right = glm::cross(direction, g_pCamera->WorldUp);
+	if (glm::length(right) > 0.0001f)
+	{
+		g_pCamera->Right = glm::normalize(right);
+	}
+	g_pCamera->Up = glm::normalize(glm::cross(g_pCamera->Right, direction));
+}
+
+/***********************************************************
+ *  GetDisplayWidth()
+ *
+ *  This method is used for getting the width of the display
+ *  window in pixels.
+ ***********************************************************/
+int ViewManager::GetDisplayWidth()
+{
+	return(WINDOW_WIDTH);
+}
+
+/***********************************************************
+ *  GetDisplayHeight()
+ *
+ *  This method is used for getting the height of the display
+ *  window in pixels.
+ ***********************************************************/
+int ViewManager::GetDisplayHeight()
+{
+	return(WINDOW_HEIGHT);
+}
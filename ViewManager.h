@@ -10,6 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformCache.h"
 #include "camera.h"
 
 // GLFW library
@@ -30,11 +31,24 @@ public:
 	// mouse scroll callback for adjusting camera movement speed
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// window refresh and resize callbacks for drawing the frame again
+	static void Window_Refresh_Callback(GLFWwindow* window);
+	static void Framebuffer_Size_Callback(GLFWwindow* window, int width, int height);
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// cached uniform locations for the active shader program
+	UniformCache* m_pUniformCache;
+	// pre-resolved handles for the per-frame view uniforms
+	UniformCache::UNIFORM_HANDLE m_viewUniform;
+	UniformCache::UNIFORM_HANDLE m_projectionUniform;
+	UniformCache::UNIFORM_HANDLE m_viewPositionUniform;
+	// view and projection matrices of the last prepared frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
@@ -42,7 +56,35 @@ private:
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// set up the view for drawing without a display window,
+	// where the camera only moves through SetCameraPose()
+	void UseOffscreenView();
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+	// move the camera with the window input and build the view
+	// and projection, without setting them into the shader
+	void UpdateCameraView();
+	// set a camera view into the shader
+	void ApplyCameraView(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& position);
+
+	// true once after the display window was resized or uncovered
+	bool TakeWindowChanged();
+
+	// get the view and projection of the last prepared frame
+	const glm::mat4& GetViewMatrix() const { return m_viewMatrix; }
+	const glm::mat4& GetProjectionMatrix() const { return m_projectionMatrix; }
+	// get the position of the camera
+	glm::vec3 GetCameraPosition() const;
+	// get the direction that the camera looks along
+	glm::vec3 GetCameraFront() const;
+	// place the camera at a position, looking along a direction
+	void SetCameraPose(const glm::vec3& position, const glm::vec3& front);
+	// get the size of the display window, which the projection
+	// aspect ratio is set for
+	static int GetDisplayWidth();
+	static int GetDisplayHeight();
 };
\ No newline at end of file
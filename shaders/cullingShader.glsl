@@ -0,0 +1,132 @@
+#version 430 core
+
+// one thread for every draw packet
+layout (local_size_x = 64) in;
+
+// culling values of one draw packet - must match GPUCuller::CULL_PACKET
+struct CullPacket
+{
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 center;
+	uvec4 levelCounts;        // indices of every tessellation level
+	uvec4 levelFirstIndices;  // first index of every tessellation level
+	int baseVertex;
+	uint baseInstance;
+	uint instanceCount;
+	int levelCount;
+};
+
+// indirect draw command - must match SceneMeshes::DRAW_COMMAND
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer PacketBuffer
+{
+	CullPacket packets[];
+};
+
+layout (std430, binding = 1) writeonly buffer CommandBuffer
+{
+	DrawCommand commands[];
+};
+
+// tessellation level of every packet, kept between frames
+layout (std430, binding = 2) buffer LevelBuffer
+{
+	int packetLevels[];
+};
+
+// number of commands written
+layout (binding = 0) uniform atomic_uint commandCount;
+
+uniform uint packetCount;
+// xyz is the normal pointing into the frustum and w is the distance
+uniform vec4 frustumPlanes[6];
+uniform vec3 cameraPosition;
+uniform float projectionScale;
+uniform bool bPerspective;
+// the same level switching as SceneMeshes::SelectLevel()
+uniform float levelSwitchSizes[3];
+uniform float levelHysteresis;
+
+bool IsBoxVisible(vec3 boxMin, vec3 boxMax)
+{
+	vec3 center = (boxMin + boxMax) * 0.5f;
+	vec3 extent = (boxMax - boxMin) * 0.5f;
+
+	for (int i = 0; i < 6; i++)
+	{
+		float distance = dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w;
+		float radius = dot(abs(frustumPlanes[i].xyz), extent);
+
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int SelectLevel(CullPacket packet, int currentLevel)
+{
+	vec3 extent = packet.boundsMax.xyz - packet.boundsMin.xyz;
+	float middleExtent = max(min(extent.x, extent.y), min(max(extent.x, extent.y), extent.z));
+	float radius = middleExtent * 0.5f;
+	float screenSize = radius * projectionScale;
+	int level = clamp(currentLevel, 0, 3);
+
+	if (bPerspective)
+	{
+		screenSize /= max(length(packet.center.xyz - cameraPosition), radius);
+	}
+
+	while ((level > 0) && (screenSize >= levelSwitchSizes[level - 1] * (1.0f + levelHysteresis)))
+	{
+		level--;
+	}
+	while ((level < 3) && (screenSize < levelSwitchSizes[level] * (1.0f - levelHysteresis)))
+	{
+		level++;
+	}
+
+	return level;
+}
+
+void main()
+{
+	uint packetIndex = gl_GlobalInvocationID.x;
+
+	if (packetIndex >= packetCount)
+	{
+		return;
+	}
+
+	CullPacket packet = packets[packetIndex];
+
+	if (!IsBoxVisible(packet.boundsMin.xyz, packet.boundsMax.xyz))
+	{
+		return;
+	}
+
+	int level = 0;
+	if (packet.levelCount > 1)
+	{
+		level = min(SelectLevel(packet, packetLevels[packetIndex]), packet.levelCount - 1);
+		packetLevels[packetIndex] = level;
+	}
+
+	uint commandIndex = atomicCounterIncrement(commandCount);
+	commands[commandIndex].count = packet.levelCounts[level];
+	commands[commandIndex].instanceCount = packet.instanceCount;
+	commands[commandIndex].firstIndex = packet.levelFirstIndices[level];
+	commands[commandIndex].baseVertex = packet.baseVertex;
+	commands[commandIndex].baseInstance = packet.baseInstance;
+}
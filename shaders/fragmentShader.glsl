@@ -0,0 +1,103 @@
+#version 330 core
+
+// must match g_MaxMaterials and g_MaxLights in SceneManager.cpp
+#define MAX_MATERIALS 32
+#define MAX_LIGHTS 4
+
+// std140 layout - must match SceneManager::MATERIAL_BLOCK_ENTRY
+struct Material
+{
+	vec4 ambient;       // rgb = ambient color, a = ambient strength
+	vec4 diffuse;       // rgb = diffuse color
+	vec4 specular;      // rgb = specular color, a = shininess
+};
+
+// std140 layout - must match SceneManager::LIGHT_BLOCK_ENTRY
+struct LightSource
+{
+	vec4 position;      // xyz = position, w = focal strength
+	vec4 ambientColor;  // rgb = ambient color
+	vec4 diffuseColor;  // rgb = diffuse color
+	vec4 specularColor; // rgb = specular color, a = specular intensity
+};
+
+layout (std140) uniform MaterialBlock
+{
+	Material materials[MAX_MATERIALS];
+};
+
+layout (std140) uniform LightBlock
+{
+	LightSource lightSources[MAX_LIGHTS];
+	int lightCount;
+};
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+in vec4 fragmentObjectColor;
+in vec2 fragmentUVscale;
+flat in int fragmentMaterialIndex;
+flat in int fragmentUseTexture;
+flat in int fragmentTextureLayer;     // -1 = sample objectTexture
+
+out vec4 outFragmentColor;
+
+uniform bool bUseLighting = false;
+uniform sampler2D objectTexture;
+uniform sampler2DArray objectTextureArray;
+uniform vec3 viewPosition;
+
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 viewDirection)
+{
+	vec3 lightDirection = normalize(light.position.xyz - fragmentPosition);
+
+	// ambient and diffuse contribution
+	vec3 ambient = light.ambientColor.rgb * material.ambient.rgb * material.ambient.a;
+	float impact = max(dot(lightNormal, lightDirection), 0.0f);
+	vec3 diffuse = impact * light.diffuseColor.rgb * material.diffuse.rgb;
+
+	// specular contribution - the light focal strength is the
+	// exponent and the material shininess scales the highlight
+	vec3 reflectDirection = reflect(-lightDirection, lightNormal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0f), light.position.w);
+	vec3 specular = light.specularColor.a * material.specular.a * specularComponent * light.specularColor.rgb * material.specular.rgb;
+
+	return(ambient + diffuse + specular);
+}
+
+void main()
+{
+	vec4 baseColor = fragmentObjectColor;
+	if (fragmentUseTexture != 0)
+	{
+		vec2 textureCoordinate = fragmentTextureCoordinate * fragmentUVscale;
+		if (fragmentTextureLayer >= 0)
+		{
+			baseColor = texture(objectTextureArray, vec3(textureCoordinate, float(fragmentTextureLayer)));
+		}
+		else
+		{
+			baseColor = texture(objectTexture, textureCoordinate);
+		}
+	}
+
+	if (bUseLighting == true)
+	{
+		Material material = materials[clamp(fragmentMaterialIndex, 0, MAX_MATERIALS - 1)];
+		vec3 lightNormal = normalize(fragmentVertexNormal);
+		vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+		vec3 phongResult = vec3(0.0f);
+
+		for (int i = 0; i < lightCount; i++)
+		{
+			phongResult += CalcLightSource(lightSources[i], material, lightNormal, viewDirection);
+		}
+
+		outFragmentColor = vec4(phongResult * baseColor.rgb, baseColor.a);
+	}
+	else
+	{
+		outFragmentColor = baseColor;
+	}
+}
@@ -0,0 +1,64 @@
+#version 330 core
+
+// vertex attributes from the mesh buffers
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+// per-instance attributes - must match SceneMeshes::INSTANCE_DATA
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in ivec3 inInstanceMaterial;  // x = material index, y = use texture, z = texture layer
+layout (location = 9) in vec2 inInstanceUVscale;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+out vec4 fragmentObjectColor;
+out vec2 fragmentUVscale;
+flat out int fragmentMaterialIndex;
+flat out int fragmentUseTexture;
+flat out int fragmentTextureLayer;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// per-draw values used when instancing is off
+uniform bool bUseInstancing = false;
+uniform bool bUseTexture = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform int materialIndex = 0;
+uniform int textureLayer = -1;
+
+void main()
+{
+	mat4 objectModel = model;
+
+	if (bUseInstancing == true)
+	{
+		objectModel = inInstanceModel;
+		fragmentObjectColor = inInstanceColor;
+		fragmentMaterialIndex = inInstanceMaterial.x;
+		fragmentUseTexture = inInstanceMaterial.y;
+		fragmentTextureLayer = inInstanceMaterial.z;
+		fragmentUVscale = inInstanceUVscale;
+	}
+	else
+	{
+		fragmentObjectColor = objectColor;
+		fragmentMaterialIndex = materialIndex;
+		fragmentUseTexture = int(bUseTexture);
+		fragmentTextureLayer = textureLayer;
+		fragmentUVscale = UVscale;
+	}
+
+	vec4 worldPosition = objectModel * vec4(inVertexPosition, 1.0f);
+
+	gl_Position = projection * view * worldPosition;
+
+	fragmentPosition = vec3(worldPosition);
+	fragmentVertexNormal = mat3(transpose(inverse(objectModel))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+}